@@ -0,0 +1,124 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstring>
+#include "bloom.h"
+#include "exceptions/file_not_found_exception.h"
+
+namespace badgerdb {
+
+BloomFilter::BloomFilter(const std::int64_t expectedKeys)
+	: numKeys(0), capacity(expectedKeys > 0 ? expectedKeys : 1)
+{
+  const std::int64_t blockBits = BLOCK_WORDS * 64;
+  numBlocks = (std::uint32_t) ((capacity * BITS_PER_KEY + blockBits - 1) / blockBits);
+  bits.assign((size_t) numBlocks * BLOCK_WORDS, 0);
+}
+
+std::uint64_t BloomFilter::hash(const int key)
+{
+  // splitmix64 finalizer, consecutive keys land in unrelated blocks
+  std::uint64_t h = (std::uint64_t) (std::uint32_t) key + 0x9e3779b97f4a7c15ULL;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+void BloomFilter::insert(const int key)
+{
+  std::uint64_t h = hash(key);
+  std::uint64_t* block = &bits[(size_t) ((h >> 32) % numBlocks) * BLOCK_WORDS];
+
+  // Double hashing on the low half picks the bits inside the block
+  std::uint32_t h1 = (std::uint32_t) h;
+  std::uint32_t h2 = (h1 >> 16) | 1;
+  for (int i = 0; i < NUM_HASHES; i++)
+  {
+    std::uint32_t bit = (h1 + i * h2) % (BLOCK_WORDS * 64);
+    block[bit / 64] |= (std::uint64_t) 1 << (bit % 64);
+  }
+  numKeys++;
+}
+
+bool BloomFilter::mayContain(const int key) const
+{
+  std::uint64_t h = hash(key);
+  const std::uint64_t* block = &bits[(size_t) ((h >> 32) % numBlocks) * BLOCK_WORDS];
+
+  std::uint32_t h1 = (std::uint32_t) h;
+  std::uint32_t h2 = (h1 >> 16) | 1;
+  for (int i = 0; i < NUM_HASHES; i++)
+  {
+    std::uint32_t bit = (h1 + i * h2) % (BLOCK_WORDS * 64);
+    if (!(block[bit / 64] & ((std::uint64_t) 1 << (bit % 64))))
+      return false;
+  }
+  return true;
+}
+
+void BloomFilter::save(const std::string& filename) const
+{
+  try
+  {
+    File::remove(filename);
+  }
+  catch(FileNotFoundException e)
+  {
+  }
+
+  BlobFile file(filename, true);
+
+  // First page holds the header, the bits follow in consecutive pages
+  PageId pageNo;
+  Page page = file.allocatePage(pageNo);
+  BloomFileHeader* header = reinterpret_cast<BloomFileHeader*>(&page);
+  header->numBlocks = numBlocks;
+  header->numKeys = numKeys;
+  file.writePage(pageNo, page);
+
+  const char* data = reinterpret_cast<const char*>(&bits[0]);
+  size_t remaining = bits.size() * sizeof(std::uint64_t);
+  while (remaining > 0)
+  {
+    size_t length = remaining < Page::SIZE ? remaining : Page::SIZE;
+    page = file.allocatePage(pageNo);
+    memcpy(reinterpret_cast<char*>(&page), data, length);
+    file.writePage(pageNo, page);
+    data += length;
+    remaining -= length;
+  }
+}
+
+BloomFilter* BloomFilter::load(const std::string& filename)
+{
+  BlobFile file(filename, false);
+
+  PageId pageNo = file.getFirstPageNo();
+  Page page = file.readPage(pageNo);
+  const BloomFileHeader* header = reinterpret_cast<const BloomFileHeader*>(&page);
+
+  // Size for the stored key count, then overwrite the bits with the stored ones
+  BloomFilter* filter = new BloomFilter(1);
+  filter->numBlocks = header->numBlocks;
+  filter->numKeys = header->numKeys;
+  filter->capacity = (std::int64_t) header->numBlocks * BLOCK_WORDS * 64 / BITS_PER_KEY;
+  filter->bits.assign((size_t) filter->numBlocks * BLOCK_WORDS, 0);
+
+  char* data = reinterpret_cast<char*>(&filter->bits[0]);
+  size_t remaining = filter->bits.size() * sizeof(std::uint64_t);
+  while (remaining > 0)
+  {
+    size_t length = remaining < Page::SIZE ? remaining : Page::SIZE;
+    page = file.readPage(++pageNo);
+    memcpy(data, reinterpret_cast<const char*>(&page), length);
+    data += length;
+    remaining -= length;
+  }
+  return filter;
+}
+
+}
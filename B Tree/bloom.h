@@ -0,0 +1,143 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "file.h"
+
+namespace badgerdb {
+
+/**
+* @brief Layout of the first page of a Bloom filter file.
+*/
+struct BloomFileHeader {
+	/**
+	 * Number of 512-bit blocks in the filter
+	 */
+	std::uint32_t numBlocks;
+
+	/**
+	 * Number of keys added to the filter
+	 */
+	std::int64_t numKeys;
+};
+
+/**
+* @brief Blocked Bloom filter over INTEGER keys.
+*
+* Every key maps to a single 64-byte block and sets all of its bits inside that block, so a probe touches one
+* cache line. Used by BTreeIndex to answer lookups for keys that are not in the index without reading any page.
+*
+* @warning This class is not threadsafe.
+*/
+class BloomFilter
+{
+ public:
+	/**
+	 * Number of 64-bit words in a block. One block fills a cache line.
+	 */
+	static const int BLOCK_WORDS = 8;
+
+	/**
+	 * Number of bits set per key.
+	 */
+	static const int NUM_HASHES = 7;
+
+	/**
+	 * Number of filter bits budgeted per expected key. Together with NUM_HASHES gives about 1% false positives.
+	 */
+	static const int BITS_PER_KEY = 10;
+
+	/**
+	 * Constructor of BloomFilter class, sized for the expected number of keys.
+	 *
+	 * @param expectedKeys	Number of keys the filter should hold at its target false positive rate
+	 */
+	BloomFilter(const std::int64_t expectedKeys);
+
+	/**
+	 * Add a key to the filter.
+	 *
+	 * @param key	Key to add
+	 */
+	void insert(const int key);
+
+	/**
+	 * Check the filter for a key.
+	 *
+	 * @param key	Key to look for
+	 * @return		False if the key was definitely never added, true if it may have been
+	 */
+	bool mayContain(const int key) const;
+
+	/**
+	 * Returns true once more keys have been added than the filter was sized for and its false positive rate
+	 * has degraded enough that it should be rebuilt larger.
+	 */
+	bool isOverloaded() const
+	{
+		return numKeys > 2 * capacity;
+	}
+
+	/**
+	 * Returns the number of keys added to the filter.
+	 */
+	std::int64_t keyCount() const
+	{
+		return numKeys;
+	}
+
+	/**
+	 * Write the filter to a file, replacing the file if it exists.
+	 *
+	 * @param filename	Name of the filter file
+	 */
+	void save(const std::string& filename) const;
+
+	/**
+	 * Read a filter previously written by save().
+	 *
+	 * @param filename	Name of the filter file
+	 * @return			The filter, owned by the caller
+	 * @throws  FileNotFoundException	If the filter file does not exist
+	 */
+	static BloomFilter* load(const std::string& filename);
+
+ private:
+	/**
+	 * Number of blocks in the filter
+	 */
+	std::uint32_t numBlocks;
+
+	/**
+	 * Number of keys added to the filter
+	 */
+	std::int64_t numKeys;
+
+	/**
+	 * Number of keys the filter was sized for
+	 */
+	std::int64_t capacity;
+
+	/**
+	 * Filter bits, numBlocks * BLOCK_WORDS words
+	 */
+	std::vector<std::uint64_t> bits;
+
+	/**
+	 * Returns a well mixed 64-bit hash of the key.
+	 *
+	 * @param key	Key to hash
+	 */
+	static std::uint64_t hash(const int key);
+};
+
+}
@@ -5,6 +5,11 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <vector>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "btree.h"
 #include "filescan.h"
 #include "exceptions/bad_index_info_exception.h"
@@ -16,6 +21,8 @@
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/end_of_file_exception.h"
 #include "exceptions/file_exists_exception.h"
+#include "exceptions/file_open_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
 
 //#define DEBUG
 
@@ -34,73 +41,164 @@ namespace badgerdb{
  * @param bufMgrIn            Buffer Manager Instance
  * @param attrByteOffset      Offset of attribute, over which index is to be built, in the record
  * @param attrType            Datatype of attribute over which index is built
+ * @param useBloomFilter      Keep a Bloom filter over the keys next to the index file
+ * @param layout              Layout of the keys in non leaf nodes of a new index
  */
 BTreeIndex::BTreeIndex(const std::string &relationName,
         std::string &outIndexName,
         BufMgr *bufMgrIn,
         const int attrByteOffset,
-        const Datatype attrType){
+        const Datatype attrType,
+        const bool useBloomFilter,
+        const NodeLayout layout){
+    openIndex(relationName, outIndexName, bufMgrIn, bufMgrIn, attrByteOffset, attrType, useBloomFilter, layout);
+}
+
+/**
+ * BTreeIndex Constructor taking its buffer pools from a BufPoolSet.
+ * The index file uses the pool it is routed to, and the base relation is scanned through the pool the relation
+ * is routed to.
+ *
+ * @param relationName        Name of file.
+ * @param outIndexName        Return the name of index file.
+ * @param pools               Buffer pools to pick from
+ * @param attrByteOffset      Offset of attribute, over which index is to be built, in the record
+ * @param attrType            Datatype of attribute over which index is built
+ * @param useBloomFilter      Keep a Bloom filter over the keys next to the index file
+ * @param layout              Layout of the keys in non leaf nodes of a new index
+ */
+BTreeIndex::BTreeIndex(const std::string &relationName,
+        std::string &outIndexName,
+        BufPoolSet *pools,
+        const int attrByteOffset,
+        const Datatype attrType,
+        const bool useBloomFilter,
+        const NodeLayout layout){
+    openIndex(relationName, outIndexName, pools->poolFor(indexFileName(relationName, attrByteOffset)),
+              pools->poolFor(relationName), attrByteOffset, attrType, useBloomFilter, layout);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::indexFileName
+// -----------------------------------------------------------------------------
+/**
+ * Name of the index file over an attribute of a relation.
+ *
+ * @param relationName        Name of file.
+ * @param attrByteOffset      Offset of attribute in the record
+ * @return                    Name of the index file
+ */
+const std::string BTreeIndex::indexFileName(const std::string &relationName, const int attrByteOffset) {
+    std::ostringstream idxString;
+    idxString << relationName << '.' << attrByteOffset;
+    return idxString.str();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::openIndex
+// -----------------------------------------------------------------------------
+/**
+ * Open the index file, or create it from the base relation, for the constructors.
+ *
+ * @param relationName        Name of file.
+ * @param outIndexName        Return the name of index file.
+ * @param indexBufMgr         Buffer Manager Instance for the index file
+ * @param relationBufMgr      Buffer Manager Instance to scan the base relation through
+ * @param attrByteOffset      Offset of attribute, over which index is to be built, in the record
+ * @param attrType            Datatype of attribute over which index is built
+ * @param useBloomFilter      Keep a Bloom filter over the keys next to the index file
+ * @param layout              Layout of the keys in non leaf nodes of a new index
+ */
+const void BTreeIndex::openIndex(const std::string &relationName,
+        std::string &outIndexName,
+        BufMgr *indexBufMgr,
+        BufMgr *relationBufMgr,
+        const int attrByteOffset,
+        const Datatype attrType,
+        const bool useBloomFilter,
+        const NodeLayout layout){
 
     // Construct from the gobal
-    this->bufMgr = bufMgrIn;
+    this->bufMgr = indexBufMgr;
     this->attrByteOffset = attrByteOffset;
     this->attributeType = attrType;
 
     leafOccupancy = INTARRAYLEAFSIZE;
-    nodeOccupancy = INTARRAYNONLEAFSIZE;
+    innerLayout = layout;
     scanExecuting = false;
+    rightmostLeafPageNum = 0;
 
-    std::ostringstream idxString;
-    idxString << relationName << '.' << attrByteOffset;
-    std::string indexName = idxString.str(); // indexName is the name of the index file
+    std::string indexName = indexFileName(relationName, attrByteOffset); // indexName is the name of the index file
     outIndexName = indexName;
+    bloomFilter = nullptr;
+    bloomFileName = indexName + ".bloom";
+    bloomFilterDirty = false;
 
     IndexMetaInfo* metadata;
-    Page *headerPage;
-    Page *rootPage;
 
     // Check if the specified index file opened and its existence
     try {
         file = new BlobFile(outIndexName, false);
         headerPageNum = file->getFirstPageNo();
         // Read file by calling the read page in the buffer manager
-        bufMgr->readPage(file, headerPageNum, headerPage);
+        PageHandle headerPage = bufMgr->readPage(file, headerPageNum);
         // Metdata of the header page
-        metadata = (IndexMetaInfo *) headerPage;
+        metadata = headerPage.as<IndexMetaInfo>();
         rootPageNum = metadata->rootPageNo;
+        innerLayout = metadata->innerLayout;
+        nodeOccupancy = innerLayout == CACHE_BLOCKED ? INTARRAYNONLEAFBLOCKEDSIZE : INTARRAYNONLEAFSIZE;
+        stats = metadata->stats;
 
         // Check index information
         if (strcmp(metadata->relationName, relationName.c_str()) != 0 ||
             metadata->attrType != attrType || metadata->attrByteOffset != attrByteOffset){
-            // UnPin by calling unPinPage in the buffer manager
-            // Unpin by turning  dirty off
-            bufMgr->unPinPage(file, headerPageNum, false);
+            // The handle unpins the header page, clean, on the way out
             throw BadIndexInfoException(outIndexName);
         }
 
-        bufMgr->unPinPage(file, headerPageNum, false);
+        headerPage.release();
+
+        if (useBloomFilter) {
+            try {
+                bloomFilter = BloomFilter::load(bloomFileName);
+            }
+            catch (FileNotFoundException e) {
+            }
+            // Missing, or left behind while the index was updated without it
+            if (bloomFilter == nullptr || bloomFilter->keyCount() != stats.numKeys)
+                rebuildBloomFilter();
+        }
     }
     catch (FileNotFoundException e) {
         // Creat new file if File not found
         file = new BlobFile(outIndexName, true);
-        bufMgr->allocPage(file, headerPageNum, headerPage);
-        bufMgr->allocPage(file, rootPageNum, rootPage);
+        PageHandle headerPage = bufMgr->allocPage(file, headerPageNum);
+        PageHandle rootPage = bufMgr->allocPage(file, rootPageNum);
 
-        metadata = (IndexMetaInfo *) headerPage;
+        metadata = headerPage.as<IndexMetaInfo>();
         strncpy((char *) (&(metadata->relationName)), relationName.c_str(), 20);
         metadata->relationName[19] = 0;
 
         metadata->attrByteOffset = attrByteOffset;
         metadata->attrType = attrType;
         metadata->rootPageNo = rootPageNum;
+        metadata->innerLayout = innerLayout;
+        nodeOccupancy = innerLayout == CACHE_BLOCKED ? INTARRAYNONLEAFBLOCKEDSIZE : INTARRAYNONLEAFSIZE;
+
+        // The tree starts as a single empty leaf
+        memset(&stats, 0, sizeof(IndexStats));
+        stats.height = 1;
+        stats.numLeafPages = 1;
+        metadata->stats = stats;
 
         initialRootPageNum = rootPageNum;
-        LeafNodeInt *root = (LeafNodeInt *) rootPage;
+        rightmostLeafPageNum = rootPageNum;
+        LeafNodeInt *root = rootPage.as<LeafNodeInt>();
         root->rightSibPageNo = 0;
 
         try {
             // Scan the new file
-            FileScan fileScan(relationName, bufMgr);
+            FileScan fileScan(relationName, relationBufMgr);
             RecordId scanRid = {};
             while (1) {
                 // By using scanNext
@@ -110,11 +208,19 @@ BTreeIndex::BTreeIndex(const std::string &relationName,
             }
         }
         catch (EndOfFileException e) {
-            bufMgr->flushFile(file);
         }
-        // UnPin as soon as you can
-        bufMgr->unPinPage(file, headerPageNum, true);
-        bufMgr->unPinPage(file, rootPageNum, true);
+        // UnPin as soon as you can, the root may have moved up while loading
+        headerPage.markDirty();
+        headerPage.release();
+        rootPage.markDirty();
+        rootPage.release();
+
+        // Every key is in the tree now, build the histogram and the filter before writing them out
+        buildHistogram();
+        writeStats();
+        if (useBloomFilter)
+            rebuildBloomFilter();
+        bufMgr->flushFile(file);
     }
 
 }
@@ -132,6 +238,24 @@ BTreeIndex::~BTreeIndex()
 {
     if (scanExecuting)
         endScan();
+    // Persist the statistics gathered while the index was open, the meta page keeps the old ones if the pool is full
+    try {
+        writeStats();
+    }
+    catch (BufferExceededException e) {
+    }
+    if (bloomFilter != nullptr) {
+        // A filter that cannot be saved is rebuilt when the index is opened again
+        try {
+            if (bloomFilterDirty)
+                bloomFilter->save(bloomFileName);
+        }
+        catch (FileOpenException e) {
+        }
+        catch (FileExistsException e) {
+        }
+        delete bloomFilter;
+    }
     // Flush index file by calling flushFile in buffer
     bufMgr->flushFile(file);
     delete file;
@@ -155,13 +279,46 @@ const void BTreeIndex::insertEntry(const void *key, const RecordId rid) {
     RIDKeyPair<int> entry;
     entry.set(rid, *((int *) key));
 
+    if (bloomFilter != nullptr) {
+        // Rebuild larger before the false positive rate gets out of hand
+        if (bloomFilter->isOverloaded())
+            rebuildBloomFilter();
+        bloomFilter->insert(entry.key);
+        bloomFilterDirty = true;
+    }
+
+    // Appends go straight to the rightmost leaf when it has room, skipping the descent
+    bool isAppend = stats.numKeys > 0 && entry.key >= stats.maxKey;
+
+    // Keep the key bounds up to date, the histogram is only rebuilt on demand
+    if (stats.numKeys == 0 || entry.key < stats.minKey)
+        stats.minKey = entry.key;
+    if (stats.numKeys == 0 || entry.key > stats.maxKey)
+        stats.maxKey = entry.key;
+    stats.numKeys++;
+
+    if (isAppend && rightmostLeafPageNum != 0 && stats.height > 1) {
+        PageHandle leafPage = bufMgr->readPage(file, rightmostLeafPageNum);
+        LeafNodeInt *leaf = leafPage.as<LeafNodeInt>();
+        // Every key in the rightmost leaf is at least its separator, so a larger key is routed here too
+        if (leaf->ridArray[leafOccupancy - 1].page_number == 0 && leaf->ridArray[0].page_number != 0 &&
+            entry.key > leaf->keyArray[0]) {
+            leafInsertion(leaf, entry);
+            leafPage.markDirty();
+            return;
+        }
+        // Full, the split needs the parents so take the normal path
+        leafPage.release();
+    }
+
     // read current page
-    Page *current;
-    bufMgr->readPage(file, rootPageNum, current);
+    PageHandle current = bufMgr->readPage(file, rootPageNum);
 
     // New Child entry setup
     PageKeyPair<int> *newEntry = nullptr;
-    insertion(current, rootPageNum, entry, newEntry, initialRootPageNum == rootPageNum ? true : false);
+    insertion(current, entry, newEntry, initialRootPageNum == rootPageNum ? true : false);
+    // A split of the root has already been absorbed by updateRoot
+    delete newEntry;
 }
 
 // -----------------------------------------------------------------------------
@@ -171,60 +328,64 @@ const void BTreeIndex::insertEntry(const void *key, const RecordId rid) {
  * Recursively perform insertion with different cases, the helper method perform the most important
  * insertion of the b+ tree
  *
- * @param current       the current Page given
- * @param currPageNum   the current Page Id given
+ * @param current       handle of the current Page given, released before returning
  * @param entry     the index entry given to be inserted
  * @param newEntry      the new entry which is a page key pair pushed up to after splitting
  * @param isLeaf        whether the current page is a leaf node
  */
-const void BTreeIndex::insertion(Page *current, PageId currPageNum, const RIDKeyPair<int> entry,
+const void BTreeIndex::insertion(PageHandle &current, const RIDKeyPair<int> entry,
         PageKeyPair<int> *&newEntry,
         bool isLeaf)
     {
     // Insertion case for non leaf node
     if (!isLeaf) {
         // Casting the current non leaf node
-        NonLeafNodeInt *node = (NonLeafNodeInt *) current;
+        NonLeafNodeInt *node = current.as<NonLeafNodeInt>();
         // Turn to next page
-        Page *nextPage;
         PageId nextNode;
         findNext(node, nextNode, entry.key);
-        bufMgr->readPage(file, nextNode, nextPage);
+        PageHandle nextPage = bufMgr->readPage(file, nextNode);
         // Set next insertion isLeaf to true for leaf case
         isLeaf = node->level == 1;
-        insertion(nextPage, nextNode, entry, newEntry,isLeaf);
+        insertion(nextPage, entry, newEntry,isLeaf);
 
         // Other cases
         if (newEntry == nullptr) {
             // There is no split and no new entry, Unpin as soon as you can
-            bufMgr->unPinPage(file, currPageNum, false);
+            current.release();
         }
         // Current node not full, calls nonLeafInsertion
         else if(node->pageNoArray[nodeOccupancy] == 0) {
             nonLeafInsertion(node, newEntry);
+            delete newEntry;
             newEntry = nullptr;
             // UnPin as soon as you can
-            bufMgr->unPinPage(file, currPageNum, true);
+            current.markDirty();
+            current.release();
         }
         // Current node is full, split needed
         else if(node->pageNoArray[nodeOccupancy] != 0){
-            splitNonLeaf(node, currPageNum, newEntry);
+            splitNonLeaf(current, newEntry);
         }
     }
 
     // Insertion case for leaf node
     else {
-        LeafNodeInt *node = (LeafNodeInt *) current;
+        LeafNodeInt *node = current.as<LeafNodeInt>();
+        // Remember the rightmost leaf when we come across it
+        if (node->rightSibPageNo == 0)
+            rightmostLeafPageNum = current.pageNo();
         // Perform leaf insertion
         if (node->ridArray[leafOccupancy - 1].page_number == 0) {
             leafInsertion(node, entry);
             newEntry = nullptr;
             // Unpin as soon as you can
-            bufMgr->unPinPage(file, currPageNum, true);
+            current.markDirty();
+            current.release();
         }
         // Split needed
         else {
-            splitLeaf(node, currPageNum, newEntry, entry);
+            splitLeaf(current, newEntry, entry);
         }
     }
 }
@@ -236,16 +397,17 @@ const void BTreeIndex::insertion(Page *current, PageId currPageNum, const RIDKey
  * Split the given non leaf node. It moves the values stored in the
  * given node after the split index into a new non leaf node.
  *
- * @param node       the node given we will split from
- * @param pageId     the page ID of the node given
+ * @param page       handle of the node given we will split from, released before returning
  * @param newEntry   the new entry which is a page key pair pushed up to after splitting
 */
-const void BTreeIndex::splitNonLeaf(NonLeafNodeInt *node, PageId pageId, PageKeyPair<int> *&newEntry) {
+const void BTreeIndex::splitNonLeaf(PageHandle &page, PageKeyPair<int> *&newEntry) {
+    NonLeafNodeInt *node = page.as<NonLeafNodeInt>();
+    PageId pageId = page.pageNo();
     // Allocate a new page
-    Page *newPage;
     PageId newPageId;
-    bufMgr->allocPage(file, newPageId, newPage);
-    NonLeafNodeInt *newNode = (NonLeafNodeInt *) newPage;
+    PageHandle newPage = bufMgr->allocPage(file, newPageId);
+    NonLeafNodeInt *newNode = newPage.as<NonLeafNodeInt>();
+    stats.numNonLeafPages++;
 
     // Set up the mid point and push entry
     int midPt = nodeOccupancy / 2;
@@ -256,29 +418,33 @@ const void BTreeIndex::splitNonLeaf(NonLeafNodeInt *node, PageId pageId, PageKey
         pushIndex = newEntry->key < node->keyArray[midPt] ? midPt - 1 : midPt;
     pushEntry.set(newPageId, node->keyArray[pushIndex]);
 
-    // New mid point fro recursion
+    // The keys right of the pushed one move over together with the children right of it
     midPt = pushIndex + 1;
-    for (int i = midPt; i < nodeOccupancy; i++) {
-        newNode->pageNoArray[i - midPt] = node->pageNoArray[i + 1];
-        newNode->keyArray[i - midPt] = node->keyArray[i];
+    for (int i = midPt; i <= nodeOccupancy; i++) {
+        if (i < nodeOccupancy)
+            newNode->keyArray[i - midPt] = node->keyArray[i];
+        newNode->pageNoArray[i - midPt] = node->pageNoArray[i];
 
-        node->pageNoArray[i + 1] = (PageId) 0;
-        node->keyArray[i + 1] = 0;
+        node->pageNoArray[i] = (PageId) 0;
+        node->keyArray[i - 1] = 0;
     }
 
     // Back to the original node for performing insertion
     newNode->level = node->level;
-    node->keyArray[pushIndex] = 0;
-    node->pageNoArray[pushIndex] = (PageId) 0;
-    if(newEntry->key < newNode->keyArray[0])
+    if(newEntry->key < pushEntry.key)
         nonLeafInsertion( node, newEntry);
     else
         nonLeafInsertion( newNode, newEntry);
+    buildBlockDirectory(node);
+    buildBlockDirectory(newNode);
 
-    // Updating root after insertion
-    newEntry = &pushEntry;
-    bufMgr->unPinPage(file, pageId, true);
-    bufMgr->unPinPage(file, newPageId, true);
+    // Updating root after insertion, the entry from below is consumed and ours goes up
+    delete newEntry;
+    newEntry = new PageKeyPair<int>(pushEntry);
+    page.markDirty();
+    page.release();
+    newPage.markDirty();
+    newPage.release();
     if (pageId == rootPageNum) {
         updateRoot(pageId, newEntry);
     }
@@ -291,23 +457,29 @@ const void BTreeIndex::splitNonLeaf(NonLeafNodeInt *node, PageId pageId, PageKey
  * Split function to split a leaf node into two
  * It moves the records after the split index into a new node.
  *
- * @param node         the original given we will split from
- * @param leafPageId  the page ID of the splitting leaf
+ * @param leafPage     handle of the leaf we will split from, released before returning
  * @param newEntry     the new entry which is a page key pair pushed up to after splitting
  * @param entry    the data entry given to perform insertion
 */
-const void BTreeIndex::splitLeaf(LeafNodeInt *node, PageId leafPageId, PageKeyPair<int> *&newEntry,
+const void BTreeIndex::splitLeaf(PageHandle &leafPage, PageKeyPair<int> *&newEntry,
         const RIDKeyPair<int> entry) {
+    LeafNodeInt *node = leafPage.as<LeafNodeInt>();
+    PageId leafPageId = leafPage.pageNo();
     // Allocate a new leaf page
-    Page *newPage;
     PageId newPageNum;
-    bufMgr->allocPage(file, newPageNum, newPage);
-    LeafNodeInt *newLeafNode = (LeafNodeInt *) newPage;
+    PageHandle newPage = bufMgr->allocPage(file, newPageNum);
+    LeafNodeInt *newLeafNode = newPage.as<LeafNodeInt>();
+    stats.numLeafPages++;
 
     // Set up the mid point
     int midPt = leafOccupancy / 2;
+    bool isRightmost = node->rightSibPageNo == 0;
+    if (isRightmost && entry.key > node->keyArray[leafOccupancy - 1]) {
+        // Appending past the last key, leave the left leaf nearly full
+        midPt = (int) (leafOccupancy * APPENDSPLITRATIO);
+    }
     // Check and adjust mid point
-    if (leafOccupancy % 2 == 1 && entry.key > node->keyArray[midPt])
+    else if (leafOccupancy % 2 == 1 && entry.key > node->keyArray[midPt])
         midPt = midPt + 1;
     for (int i = midPt; i < leafOccupancy; i++) {
         newLeafNode->ridArray[i - midPt] = node->ridArray[i];
@@ -323,14 +495,18 @@ const void BTreeIndex::splitLeaf(LeafNodeInt *node, PageId leafPageId, PageKeyPa
     else
         leafInsertion(node, entry);
 
-    newLeafNode->rightSibPageNo =newPageNum;
+    // Link the new leaf in right after the original one
+    newLeafNode->rightSibPageNo = node->rightSibPageNo;
+    node->rightSibPageNo = newPageNum;
+    if (isRightmost)
+        rightmostLeafPageNum = newPageNum;
     // Updating root after insertion
     newEntry = new PageKeyPair<int>();
-    PageKeyPair<int> newKeyPair;
-    newKeyPair.set(newPageNum, newLeafNode->keyArray[0]);
-    newEntry = &newKeyPair;
-    bufMgr->unPinPage(file, leafPageId, true);
-    bufMgr->unPinPage(file, newPageNum, true);
+    newEntry->set(newPageNum, newLeafNode->keyArray[0]);
+    leafPage.markDirty();
+    leafPage.release();
+    newPage.markDirty();
+    newPage.release();
     if (leafPageId == rootPageNum) {
         updateRoot(leafPageId, newEntry);
     }
@@ -349,26 +525,27 @@ const void BTreeIndex::splitLeaf(LeafNodeInt *node, PageId leafPageId, PageKeyPa
 const void BTreeIndex::updateRoot(PageId firstPid, PageKeyPair<int> *newEntry) {
         // Alloc a new page for root
         PageId newRootPageId;
-        Page *root;
-        bufMgr->allocPage(file, newRootPageId, root);
-        NonLeafNodeInt *newRoot = (NonLeafNodeInt *) root;
+        PageHandle root = bufMgr->allocPage(file, newRootPageId);
+        NonLeafNodeInt *newRoot = root.as<NonLeafNodeInt>();
+        stats.numNonLeafPages++;
+        stats.height++;
 
         // Set up the key and page numbers
         newRoot->level = initialRootPageNum == rootPageNum ? 1 : 0;
         newRoot->pageNoArray[0] = firstPid;
         newRoot->pageNoArray[1] = newEntry->pageNo;
         newRoot->keyArray[0] = newEntry->key;
+        buildBlockDirectory(newRoot);
 
         // Updating the index meta infromation
-        Page *metaData;
-        bufMgr->readPage(file, headerPageNum, metaData);
-        IndexMetaInfo *metaPage = (IndexMetaInfo *) metaData;
+        PageHandle metaData = bufMgr->readPage(file, headerPageNum);
+        IndexMetaInfo *metaPage = metaData.as<IndexMetaInfo>();
         metaPage->rootPageNo = newRootPageId;
         rootPageNum = newRootPageId;
 
-        // Unpin as soon as you can
-        bufMgr->unPinPage(file, headerPageNum, true);
-        bufMgr->unPinPage(file, newRootPageId, true);
+        // Both pages are unpinned dirty as the handles go
+        metaData.markDirty();
+        root.markDirty();
     }
 
 // -----------------------------------------------------------------------------
@@ -381,25 +558,17 @@ const void BTreeIndex::updateRoot(PageId firstPid, PageKeyPair<int> *newEntry) {
   * @param entry   the entry of the record ID pair given for inserting
   */
 const void BTreeIndex::leafInsertion(LeafNodeInt *node, RIDKeyPair<int> entry) {
-    if (node->ridArray[0].page_number == 0) {
-        // Set the record Id if leaf page empty
-        node->ridArray[0] = entry.rid;
-        node->keyArray[0] = entry.key;
+    // Shift the larger keys one slot right, starting from the last entry in use
+    int i = leafEntryCount(node) - 1;
+    while (i >= 0 && node->keyArray[i] > entry.key) {
+        node->keyArray[i + 1] = node->keyArray[i];
+        node->ridArray[i + 1] = node->ridArray[i];
+        i--;
     }
-    else {
-        size_t length = 0;
-        int i = leafOccupancy - 1;
-        while (i >= 0 && (node->ridArray[i].page_number == 0)) {
-            i--;
-            length++;
-        }
-        memmove(&node->keyArray[i + 1], &node->keyArray[i], length * sizeof(int));
-        memmove(&node->ridArray[i + 1], &node->ridArray[i], length * sizeof(RecordId));
 
-        // save the key and record id to the leaf node
-        node->keyArray[i + 1] = entry.key;
-        node->ridArray[i + 1] = entry.rid;
-    }
+    // save the key and record id to the leaf node
+    node->keyArray[i + 1] = entry.key;
+    node->ridArray[i + 1] = entry.rid;
 }
 
 // -----------------------------------------------------------------------------
@@ -412,18 +581,18 @@ const void BTreeIndex::leafInsertion(LeafNodeInt *node, RIDKeyPair<int> entry) {
   * @param entry   the entry of the record ID pair given for inserting
   */
 const void BTreeIndex::nonLeafInsertion(NonLeafNodeInt *node, PageKeyPair<int> *entry) {
-    size_t length = 0;
-    int i = nodeOccupancy;
-    while (i >= 0 && (node->pageNoArray[i] == 0)) {
+    // Shift the larger keys and the children right of them one slot right
+    int i = nonLeafChildCount(node) - 1;
+    while (i > 0 && node->keyArray[i - 1] > entry->key) {
+        node->keyArray[i] = node->keyArray[i - 1];
+        node->pageNoArray[i + 1] = node->pageNoArray[i];
         i--;
-        length++;
     }
-    memmove(&node->keyArray[i], &node->keyArray[i - 1], length * sizeof(int));
-    memmove(&node->pageNoArray[i + 1], &node->pageNoArray[i], length * sizeof(PageId));
 
-    // store the key and page number to the node
+    // store the key and page number to the node, the new child sits right of its key
     node->keyArray[i] = entry->key;
     node->pageNoArray[i + 1] = entry->pageNo;
+    buildBlockDirectory(node);
 }
 
 // -----------------------------------------------------------------------------
@@ -463,6 +632,38 @@ const bool BTreeIndex::checkSatisfy(int lowVal, const Operator lowOp, int highVa
  * @param val           the value of key given
 */
 const void BTreeIndex::findNext(NonLeafNodeInt *node, PageId &nextNodeNum, int val) {
+    nextNodeNum = node->pageNoArray[findChildIndex(node, val)];
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::findChildIndex
+// -----------------------------------------------------------------------------
+/**
+ * To find the slot of the child that the key value should be at the next level
+ *
+ * @param node          the current node given
+ * @param val           the value of key given
+ * @return              index of the child in pageNoArray
+*/
+const int BTreeIndex::findChildIndex(NonLeafNodeInt *node, int val) {
+    if (innerLayout == CACHE_BLOCKED) {
+        // Skip whole blocks through the directory, then look at a single block of keys
+        int numKeys = node->keyArray[nodeOccupancy + 1];
+        const int *directory = &node->keyArray[nodeOccupancy + 2];
+        int numBlocks = (numKeys + INTNONLEAFBLOCKKEYS - 1) / INTNONLEAFBLOCKKEYS;
+        int block = 0;
+        while (block < numBlocks && directory[block] < val) {
+            block++;
+        }
+        // Past the last block every key is smaller, take the last child
+        int i = block < numBlocks ? block * INTNONLEAFBLOCKKEYS : numKeys;
+        int end = i + INTNONLEAFBLOCKKEYS < numKeys ? i + INTNONLEAFBLOCKKEYS : numKeys;
+        while (i < end && node->keyArray[i] < val) {
+            i++;
+        }
+        return i;
+    }
+
     int i = nodeOccupancy;
     while (i >= 0 && (node->pageNoArray[i] == 0)) {
         i--;
@@ -470,7 +671,249 @@ const void BTreeIndex::findNext(NonLeafNodeInt *node, PageId &nextNodeNum, int v
     while (i > 0 && (node->keyArray[i - 1] >= val)) {
         i--;
     }
-    nextNodeNum = node->pageNoArray[i];
+    return i;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::buildBlockDirectory
+// -----------------------------------------------------------------------------
+/**
+ * Rebuild the key count and block directory of a CACHE_BLOCKED non leaf node after its keys changed.
+ * Does nothing for the SORTED_ARRAY layout.
+ *
+ * @param node    the non leaf node given
+*/
+const void BTreeIndex::buildBlockDirectory(NonLeafNodeInt *node) {
+    if (innerLayout != CACHE_BLOCKED)
+        return;
+
+    // Both live in the key slots past nodeOccupancy, which the node never uses for keys
+    int numKeys = nonLeafChildCount(node) - 1;
+    int *directory = &node->keyArray[nodeOccupancy + 2];
+    node->keyArray[nodeOccupancy + 1] = numKeys;
+    for (int block = 0; block * INTNONLEAFBLOCKKEYS < numKeys; block++) {
+        int last = block * INTNONLEAFBLOCKKEYS + INTNONLEAFBLOCKKEYS - 1;
+        directory[block] = node->keyArray[last < numKeys ? last : numKeys - 1];
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::leafEntryCount
+// -----------------------------------------------------------------------------
+/**
+ * Count the entries in use in the given leaf node. Entries are packed from the front of the node.
+ *
+ * @param node    the leaf node given
+ * @return        number of keys stored in the node
+*/
+const int BTreeIndex::leafEntryCount(LeafNodeInt *node) {
+    // Binary search for the first empty slot
+    int low = 0;
+    int high = leafOccupancy;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (node->ridArray[mid].page_number == 0)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::nonLeafChildCount
+// -----------------------------------------------------------------------------
+/**
+ * Count the child pointers in use in the given non leaf node.
+ *
+ * @param node    the non leaf node given
+ * @return        number of children of the node
+*/
+const int BTreeIndex::nonLeafChildCount(NonLeafNodeInt *node) {
+    int i = nodeOccupancy;
+    while (i >= 0 && (node->pageNoArray[i] == 0)) {
+        i--;
+    }
+    return i + 1;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::findLeaf
+// -----------------------------------------------------------------------------
+/**
+ * Find the page Id of the leaf that the key value should be at.
+ *
+ * @param val           the value of key given
+ * @param leafPageNum   value for the page ID of the leaf
+*/
+const void BTreeIndex::findLeaf(int val, PageId &leafPageNum) {
+    leafPageNum = rootPageNum;
+    for (int level = 1; level < stats.height; level++) {
+        PageHandle page = bufMgr->readPage(file, leafPageNum);
+        PageId nextPageNum;
+        findNext(page.as<NonLeafNodeInt>(), nextPageNum, val);
+        page.release();
+        leafPageNum = nextPageNum;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::findRangeInLeaf
+// -----------------------------------------------------------------------------
+/**
+ * Find the entries of a sorted leaf node that fall in a range.
+ *
+ * @param node    the leaf node given
+ * @param count   number of entries in the node
+ * @param lowVal  Low value of range
+ * @param lowOp   Low operator (GT/GTE)
+ * @param highVal High value of range
+ * @param highOp  High operator (LT/LTE)
+ * @param start   value for the index of the first entry not below the range
+ * @param end     value for the index of the first entry above the range
+*/
+const void BTreeIndex::findRangeInLeaf(LeafNodeInt *node, int count, int lowVal, const Operator lowOp,
+                                       int highVal, const Operator highOp, int &start, int &end) {
+    const int *keys = node->keyArray;
+    start = (int) ((lowOp == GTE ? std::lower_bound(keys, keys + count, lowVal)
+                                 : std::upper_bound(keys, keys + count, lowVal)) - keys);
+    end = (int) ((highOp == LT ? std::lower_bound(keys + start, keys + count, highVal)
+                               : std::upper_bound(keys + start, keys + count, highVal)) - keys);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::sumKeys
+// -----------------------------------------------------------------------------
+/**
+ * Sum a run of keys, four at a time with SSE2 where available.
+ *
+ * @param keys    the first key given
+ * @param count   number of keys to add up
+ * @return        sum of the keys
+*/
+const long long BTreeIndex::sumKeys(const int *keys, int count) {
+    long long sum = 0;
+    int i = 0;
+#ifdef __SSE2__
+    // Sign extend each group of four keys into two pairs of 64-bit lanes so the sum cannot overflow
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (keys + i));
+        __m128i sign = _mm_srai_epi32(v, 31);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, sign));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, sign));
+    }
+    long long lanes[2];
+    _mm_storeu_si128((__m128i *) lanes, acc);
+    sum = lanes[0] + lanes[1];
+#endif
+    for (; i < count; i++)
+        sum += keys[i];
+    return sum;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::findLeftmostLeaf
+// -----------------------------------------------------------------------------
+/**
+ * Find the page Id of the leftmost leaf of the tree.
+ *
+ * @param leafPageNum   value for the page ID of the leftmost leaf
+*/
+const void BTreeIndex::findLeftmostLeaf(PageId &leafPageNum) {
+    leafPageNum = rootPageNum;
+    // Follow the first child down to the leaves
+    for (int level = 1; level < stats.height; level++) {
+        PageHandle page = bufMgr->readPage(file, leafPageNum);
+        PageId nextPageNum = page.as<NonLeafNodeInt>()->pageNoArray[0];
+        page.release();
+        leafPageNum = nextPageNum;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::buildHistogram
+// -----------------------------------------------------------------------------
+/**
+ * Rebuild the equi-depth histogram and the key bounds by walking the whole leaf chain.
+ * Called at the end of bulk load when every page of the index is at hand anyway.
+*/
+const void BTreeIndex::buildHistogram() {
+    stats.histogramSampled = false;
+    if (stats.numKeys == 0) {
+        stats.numHistogramBuckets = 0;
+        return;
+    }
+
+    // Bound b is the key of rank b * (numKeys - 1) / buckets, so the first and last bounds are min and max
+    long long numKeys = stats.numKeys;
+    int buckets = numKeys < INDEXHISTOGRAMBUCKETS ? (int) numKeys : INDEXHISTOGRAMBUCKETS;
+    int nextBound = 0;
+    long long rank = 0;
+
+    PageId currentLeafNum;
+    findLeftmostLeaf(currentLeafNum);
+    // Never walk more leaves than the tree has, the chain ends with page number 0
+    for (int visited = 0; currentLeafNum != 0 && visited < stats.numLeafPages; visited++) {
+        PageHandle page = bufMgr->readPage(file, currentLeafNum);
+        LeafNodeInt *leaf = page.as<LeafNodeInt>();
+        int count = leafEntryCount(leaf);
+        for (int i = 0; i < count; i++, rank++) {
+            if (rank == 0)
+                stats.minKey = leaf->keyArray[i];
+            stats.maxKey = leaf->keyArray[i];
+            while (nextBound <= buckets && rank == nextBound * (numKeys - 1) / buckets) {
+                stats.histogramBounds[nextBound] = leaf->keyArray[i];
+                nextBound++;
+            }
+        }
+        PageId nextLeafNum = leaf->rightSibPageNo;
+        page.release();
+        currentLeafNum = nextLeafNum;
+    }
+
+    // The walk is the authoritative key count
+    stats.numKeys = rank;
+    stats.numHistogramBuckets = nextBound > buckets ? buckets : 0;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::writeStats
+// -----------------------------------------------------------------------------
+/**
+ * Write the in-memory statistics back to the meta page.
+*/
+const void BTreeIndex::writeStats() {
+    PageHandle metaData = bufMgr->readPage(file, headerPageNum);
+    IndexMetaInfo *metaPage = metaData.as<IndexMetaInfo>();
+    metaPage->stats = stats;
+    metaData.markDirty();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::rebuildBloomFilter
+// -----------------------------------------------------------------------------
+/**
+ * Size a new Bloom filter for the current number of keys and fill it by walking the leaf chain.
+*/
+const void BTreeIndex::rebuildBloomFilter() {
+    delete bloomFilter;
+    // Leave room to keep inserting before the next rebuild
+    bloomFilter = new BloomFilter(stats.numKeys + stats.numKeys / 2 + 1024);
+    bloomFilterDirty = true;
+
+    PageId currentLeafNum;
+    findLeftmostLeaf(currentLeafNum);
+    for (int visited = 0; currentLeafNum != 0 && visited < stats.numLeafPages; visited++) {
+        PageHandle page = bufMgr->readPage(file, currentLeafNum);
+        LeafNodeInt *leaf = page.as<LeafNodeInt>();
+        int count = leafEntryCount(leaf);
+        for (int i = 0; i < count; i++)
+            bloomFilter->insert(leaf->keyArray[i]);
+        PageId nextLeafNum = leaf->rightSibPageNo;
+        page.release();
+        currentLeafNum = nextLeafNum;
+    }
 }
 
 // -----------------------------------------------------------------------------
@@ -512,37 +955,40 @@ const void BTreeIndex::startScan(const void *lowValParm,
         if (scanExecuting)
             endScan();
 
-        currentPageNum = rootPageNum;
-        bufMgr->readPage(file, currentPageNum, currentPageData);
+        // A point lookup for a key the filter has never seen can stop before reading the root
+        if (bloomFilter != nullptr && lowOp == GTE && highOp == LTE && lowValInt == highValInt &&
+            !bloomFilter->mayContain(lowValInt))
+            throw NoSuchKeyFoundException();
+
+        currentPage = bufMgr->readPage(file, rootPageNum);
 
         // Whether found the leaf
         bool found = false;
         // Non leaf node case
-        NonLeafNodeInt *node = (NonLeafNodeInt *) currentPageData;
+        NonLeafNodeInt *node = currentPage.as<NonLeafNodeInt>();
         if (initialRootPageNum != rootPageNum) {
             while (!found) {
                 // Check leaf
-                node = (NonLeafNodeInt *) currentPageData;
+                node = currentPage.as<NonLeafNodeInt>();
                 if (node->level == 1) {
                     found = true;
                 }
                 PageId nextPageNum;
                 findNext(node, nextPageNum, lowValInt);
                 // UnPin as soon as you can
-                bufMgr->unPinPage(file, currentPageNum, false);
+                currentPage.release();
                 // Turn to next
-                currentPageNum = nextPageNum;
-                bufMgr->readPage(file, currentPageNum, currentPageData);
+                currentPage = bufMgr->readPage(file, nextPageNum);
             }
         }
 
         // Leaf node case
         found = false;
-        LeafNodeInt *leafNode = (LeafNodeInt *) currentPageData;
+        LeafNodeInt *leafNode = currentPage.as<LeafNodeInt>();
         while (!found) {
             if (leafNode->ridArray[0].page_number == 0) {
                 // Unpin as soon as you can
-                bufMgr->unPinPage(file, currentPageNum, false);
+                currentPage.release();
                 // No key satisfies the scan criteria since page number is 0
                 throw NoSuchKeyFoundException();
             }
@@ -564,23 +1010,24 @@ const void BTreeIndex::startScan(const void *lowValParm,
                     break;
                 } else if (highOp == LT && val >= highValInt) {
                     // Unpin as soon as you can
-                    bufMgr->unPinPage(file, currentPageNum, false);
+                    currentPage.release();
                     throw NoSuchKeyFoundException();
                 } else if (highOp == LTE && val > highValInt){
                     // Unpin as soon as you can
-                    bufMgr->unPinPage(file, currentPageNum, false);
+                    currentPage.release();
                     throw NoSuchKeyFoundException();
                 }
 
                 if ( foundVal || i == leafOccupancy - 1 ) {
-                    bufMgr->unPinPage(file, currentPageNum, false);
+                    PageId nextPageNum = leafNode->rightSibPageNo;
+                    currentPage.release();
                     // No key satisfies the scan criteria since right page number is 0
-                    if (leafNode->rightSibPageNo == 0) {
+                    if (nextPageNum == 0) {
                         throw NoSuchKeyFoundException();
                     }
                     // Turn to next
-                    currentPageNum = leafNode->rightSibPageNo;
-                    bufMgr->readPage(file, currentPageNum, currentPageData);
+                    currentPage = bufMgr->readPage(file, nextPageNum);
+                    leafNode = currentPage.as<LeafNodeInt>();
                 }
             }
         }
@@ -604,24 +1051,24 @@ const void BTreeIndex::scanNext(RecordId& outRid) {
     if (!scanExecuting)
         throw ScanNotInitializedException();
 
-    LeafNodeInt *node = (LeafNodeInt *) currentPageData;
+    LeafNodeInt *node = currentPage.as<LeafNodeInt>();
 
-    // outRid is the record ID of next record found
-    outRid = node->ridArray[nextEntry];
-    if (outRid.page_number == 0 || nextEntry == INTARRAYLEAFSIZE) {
+    // Step to the right sibling past the last entry of the leaf
+    if (nextEntry == INTARRAYLEAFSIZE || node->ridArray[nextEntry].page_number == 0) {
+        PageId nextPageNum = node->rightSibPageNo;
         // UnPin as soon as you can
-        bufMgr->unPinPage(file, currentPageNum, false);
-        if (node->rightSibPageNo == Page::INVALID_NUMBER)
+        currentPage.release();
+        if (nextPageNum == Page::INVALID_NUMBER)
             throw IndexScanCompletedException();
         nextEntry = 0;
-        currentPageNum = node->rightSibPageNo;
-        bufMgr->readPage(file, currentPageNum, currentPageData);
-        node = (LeafNodeInt *) currentPageData;
+        currentPage = bufMgr->readPage(file, nextPageNum);
+        node = currentPage.as<LeafNodeInt>();
     }
 
+    // outRid is the record ID of next record found, taken once the leaf holding it is known
     int val = node->keyArray[nextEntry];
     if (checkSatisfy(lowValInt, lowOp, highValInt, highOp, val))
-        nextEntry++;
+        outRid = node->ridArray[nextEntry++];
     else
         throw IndexScanCompletedException();
 }
@@ -640,7 +1087,234 @@ const void BTreeIndex::endScan()
         throw ScanNotInitializedException();
 
     scanExecuting = false;
-    bufMgr->unPinPage(file, currentPageNum, false); // Unpin
+    currentPage.release(); // Unpin
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::aggregateRange
+// -----------------------------------------------------------------------------
+/**
+  * Compute an aggregate over the keys in a range using the index alone, without fetching any record.
+  * MIN and MAX descend to one boundary leaf; COUNT and SUM walk the leaves of the range, taking whole leaves
+  * at a time and reading only the keys. Does not disturb a scan in progress.
+  * @param lowValParm	Low value of range, pointer to integer / double / char string
+  * @param lowOpParm		Low operator (GT/GTE)
+  * @param highValParm	High value of range, pointer to integer / double / char string
+  * @param highOpParm	High operator (LT/LTE)
+  * @param kind		Aggregate to compute
+  * @return			The smallest or largest key, the number of entries or the sum of the keys in the range.
+  *					COUNT and SUM of an empty range are 0.
+  * @throws  BadOpcodesException      If lowOp and highOp do not contain one of their their expected values
+  * @throws  BadScanrangeException    If lowVal > highval
+  * @throws  NoSuchKeyFoundException  If MIN or MAX is asked of a range with no key in the B+ tree.
+ **/
+const long long BTreeIndex::aggregateRange(const void *lowValParm,
+        const Operator lowOpParm,
+        const void *highValParm,
+        const Operator highOpParm,
+        const AggKind kind)
+{
+    if (lowOpParm != GT && lowOpParm != GTE) throw BadOpcodesException();
+    if (highOpParm != LT && highOpParm != LTE) throw BadOpcodesException();
+
+    // Kept apart from the scan members so a scan in progress carries on
+    int lowVal = *((int *) lowValParm);
+    int highVal = *((int *) highValParm);
+    if (lowVal > highVal)
+        throw BadScanrangeException();
+
+    PageId currentLeafNum;
+    PageHandle page;
+    LeafNodeInt *leaf;
+    int count, start, end;
+
+    if (kind == AGG_MAX) {
+        // Descend to the leaf highVal belongs in, remembering the nearest subtree left of the path and the
+        // nearest separator right of it
+        PageId leftNum = 0;
+        int leftLevel = 0;
+        bool bounded = false;
+        int rightBound = 0;
+        currentLeafNum = rootPageNum;
+        for (int level = 1; level < stats.height; level++) {
+            page = bufMgr->readPage(file, currentLeafNum);
+            NonLeafNodeInt *node = page.as<NonLeafNodeInt>();
+            int child = findChildIndex(node, highVal);
+            if (child > 0) {
+                leftNum = node->pageNoArray[child - 1];
+                leftLevel = level + 1;
+            }
+            if (child < nonLeafChildCount(node) - 1) {
+                bounded = true;
+                rightBound = node->keyArray[child];
+            }
+            currentLeafNum = node->pageNoArray[child];
+            page.release();
+        }
+
+        bool found = false;
+        bool walked = false;
+        bool aboveRange = false;
+        long long maxKey = 0;
+        while (currentLeafNum != 0) {
+            page = bufMgr->readPage(file, currentLeafNum);
+            leaf = page.as<LeafNodeInt>();
+            count = leafEntryCount(leaf);
+            findRangeInLeaf(leaf, count, lowVal, lowOpParm, highVal, highOpParm, start, end);
+            if (start < end) {
+                found = true;
+                maxKey = leaf->keyArray[end - 1];
+            }
+            PageId nextLeafNum = leaf->rightSibPageNo;
+            page.release();
+            // Only a separator equal to an included highVal can put more of the range in the right sibling
+            if (end < count || count == 0 || (bounded && (rightBound > highVal || highOpParm == LT))) {
+                aboveRange = !found && count > 0 && end == 0 && !walked;
+                break;
+            }
+            bounded = false;
+            walked = true;
+            currentLeafNum = nextLeafNum;
+        }
+
+        // Every key of the boundary leaf is past the range, the largest key below it ends the left neighbour
+        if (!found && aboveRange && leftNum != 0) {
+            for (int level = leftLevel; level < stats.height; level++) {
+                page = bufMgr->readPage(file, leftNum);
+                NonLeafNodeInt *node = page.as<NonLeafNodeInt>();
+                leftNum = node->pageNoArray[nonLeafChildCount(node) - 1];
+                page.release();
+            }
+            page = bufMgr->readPage(file, leftNum);
+            leaf = page.as<LeafNodeInt>();
+            count = leafEntryCount(leaf);
+            if (count > 0 && checkSatisfy(lowVal, lowOpParm, highVal, highOpParm, leaf->keyArray[count - 1])) {
+                found = true;
+                maxKey = leaf->keyArray[count - 1];
+            }
+            page.release();
+        }
+
+        if (!found)
+            throw NoSuchKeyFoundException();
+        return maxKey;
+    }
+
+    findLeaf(lowVal, currentLeafNum);
+    long long result = 0;
+    bool found = false;
+    while (currentLeafNum != 0) {
+        page = bufMgr->readPage(file, currentLeafNum);
+        leaf = page.as<LeafNodeInt>();
+        count = leafEntryCount(leaf);
+        findRangeInLeaf(leaf, count, lowVal, lowOpParm, highVal, highOpParm, start, end);
+
+        if (start < end) {
+            if (kind == AGG_MIN && !found) {
+                result = leaf->keyArray[start];
+                found = true;
+            } else if (kind == AGG_COUNT) {
+                result += end - start;
+            } else if (kind == AGG_SUM) {
+                result += sumKeys(&leaf->keyArray[start], end - start);
+            }
+        }
+
+        PageId nextLeafNum = leaf->rightSibPageNo;
+        page.release();
+        // Stop at the first key past the range, or at the first key in it for MIN
+        if (end < count || (kind == AGG_MIN && found))
+            break;
+        currentLeafNum = nextLeafNum;
+    }
+
+    if (kind == AGG_MIN && !found)
+        throw NoSuchKeyFoundException();
+    return result;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::getStats
+// -----------------------------------------------------------------------------
+/**
+  * Report the size and shape of the tree: height, leaf and non-leaf page counts, average fill factors,
+  * key bounds and the equi-depth key histogram. Page counts and fill factors are exact; the histogram is as of
+  * the last bulk load or refreshStats() call.
+  * @param outStats	Statistics of the index returned in this
+ **/
+const void BTreeIndex::getStats(IndexStats& outStats) {
+    // Every key lives in a leaf
+    stats.leafFillFactor = (double) stats.numKeys / ((double) stats.numLeafPages * leafOccupancy);
+
+    // Every page but the root hangs off exactly one non leaf node, and a node with n children holds n - 1 keys
+    if (stats.numNonLeafPages > 0) {
+        long long children = stats.numLeafPages + stats.numNonLeafPages - 1;
+        stats.nonLeafFillFactor = (double) (children - stats.numNonLeafPages) /
+                                  ((double) stats.numNonLeafPages * nodeOccupancy);
+    } else {
+        stats.nonLeafFillFactor = 0;
+    }
+
+    outStats = stats;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::refreshStats
+// -----------------------------------------------------------------------------
+/**
+  * Refresh the key bounds and histogram without reading the whole index. The bounds come from the leftmost and
+  * rightmost leaves; the histogram is rebuilt from keys picked by numSamples random root-to-leaf descents.
+  * The refreshed statistics are persisted in the meta page when the index is closed.
+  * @param numSamples	Number of random descents to make
+ **/
+const void BTreeIndex::refreshStats(const int numSamples) {
+    if (stats.numKeys == 0) {
+        stats.numHistogramBuckets = 0;
+        return;
+    }
+
+    std::vector<int> samples;
+    samples.reserve(numSamples);
+    // Sample number -1 and -2 follow the first and last child all the way down for the exact bounds
+    for (int sample = -2; sample < numSamples; sample++) {
+        PageId currentPageNum = rootPageNum;
+        PageHandle page;
+        for (int level = 1; level < stats.height; level++) {
+            page = bufMgr->readPage(file, currentPageNum);
+            NonLeafNodeInt *node = page.as<NonLeafNodeInt>();
+            int children = nonLeafChildCount(node);
+            int child = sample == -2 ? 0 : (sample == -1 ? children - 1 : (int) (random() % children));
+            PageId nextPageNum = node->pageNoArray[child];
+            page.release();
+            currentPageNum = nextPageNum;
+        }
+
+        page = bufMgr->readPage(file, currentPageNum);
+        LeafNodeInt *leaf = page.as<LeafNodeInt>();
+        int count = leafEntryCount(leaf);
+        if (count > 0) {
+            if (sample == -2)
+                stats.minKey = leaf->keyArray[0];
+            else if (sample == -1)
+                stats.maxKey = leaf->keyArray[count - 1];
+            else
+                samples.push_back(leaf->keyArray[random() % count]);
+        }
+        page.release();
+    }
+
+    if (samples.empty())
+        return;
+
+    // Equi-depth bounds from the sorted sample, pinned to the exact bounds at both ends
+    std::sort(samples.begin(), samples.end());
+    int buckets = (int) samples.size() < INDEXHISTOGRAMBUCKETS ? (int) samples.size() : INDEXHISTOGRAMBUCKETS;
+    stats.histogramBounds[0] = stats.minKey;
+    for (int b = 1; b < buckets; b++)
+        stats.histogramBounds[b] = samples[(size_t) b * samples.size() / buckets];
+    stats.histogramBounds[buckets] = stats.maxKey;
+    stats.numHistogramBuckets = buckets;
+    stats.histogramSampled = true;
 }
 
 }
@@ -16,6 +16,8 @@
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
+#include "bufPoolSet.h"
+#include "bloom.h"
 
 namespace badgerdb
 {
@@ -30,6 +32,26 @@ enum Datatype
 	STRING = 2
 };
 
+/**
+ * @brief Aggregate functions enumeration. Passed to BTreeIndex::aggregateRange() method.
+ */
+enum AggKind
+{
+	AGG_MIN,	/* Smallest key in the range */
+	AGG_MAX,	/* Largest key in the range */
+	AGG_COUNT,	/* Number of entries in the range */
+	AGG_SUM		/* Sum of the keys in the range */
+};
+
+/**
+ * @brief Layout of the keys in non-leaf nodes. Passed to the BTreeIndex constructor and kept in the meta page.
+ */
+enum NodeLayout
+{
+	SORTED_ARRAY = 0,	/* Plain sorted key array */
+	CACHE_BLOCKED = 1	/* Sorted key array split into cache line blocks, searched through a block directory */
+};
+
 /**
  * @brief Scan operations enumeration. Passed to BTreeIndex::startScan() method.
  */
@@ -54,6 +76,25 @@ const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int
 //                                                     level     extra pageNo                  key       pageNo
 const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
 
+/**
+ * @brief Number of keys in one cache line sized block of a CACHE_BLOCKED non-leaf node.
+ */
+const  int INTNONLEAFBLOCKKEYS = 64 / sizeof( int );
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for INTEGER key with the CACHE_BLOCKED layout.
+ * The key slots past it hold the key count and the block directory, the largest key of every block.
+ */
+//                                  count and spare key slot   directory slot per block
+const  int INTARRAYNONLEAFBLOCKEDSIZE = ( ( INTARRAYNONLEAFSIZE - 2 ) * INTNONLEAFBLOCKKEYS / ( INTNONLEAFBLOCKKEYS + 1 ) )
+                                        / INTNONLEAFBLOCKKEYS * INTNONLEAFBLOCKKEYS;
+
+/**
+ * @brief Fraction of the keys kept in the left leaf when the rightmost leaf is split by an append.
+ * Ascending inserts never go back to the left leaf, so it is left almost full instead of half full.
+ */
+const  double APPENDSPLITRATIO = 0.9;
+
 /**
  * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that
  * add to or make changes to the leaf node pages of the tree. Is templated for the key member.
@@ -100,6 +141,74 @@ bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
 		return r1.rid.page_number < r2.rid.page_number;
 }
 
+/**
+ * @brief Number of buckets in the equi-depth key histogram kept in the meta page.
+ */
+const  int INDEXHISTOGRAMBUCKETS = 64;
+
+/**
+ * @brief Statistics describing the size and shape of a B+ Tree index. Page counts, height and key count are
+ * maintained on every insert; the histogram is built during bulk load and refreshed by BTreeIndex::refreshStats().
+ * Persisted in the meta page as part of IndexMetaInfo.
+*/
+struct IndexStats{
+  /**
+   * Number of levels in the tree, 1 while the root is still a leaf.
+   */
+	int height;
+
+  /**
+   * Number of leaf pages.
+   */
+	int numLeafPages;
+
+  /**
+   * Number of non-leaf pages.
+   */
+	int numNonLeafPages;
+
+  /**
+   * Number of keys stored in the leaves.
+   */
+	long long numKeys;
+
+  /**
+   * Average fraction of leaf key slots in use.
+   */
+	double leafFillFactor;
+
+  /**
+   * Average fraction of non-leaf key slots in use.
+   */
+	double nonLeafFillFactor;
+
+  /**
+   * Smallest key in the index. Only meaningful if numKeys > 0.
+   */
+	int minKey;
+
+  /**
+   * Largest key in the index. Only meaningful if numKeys > 0.
+   */
+	int maxKey;
+
+  /**
+   * Number of buckets in use in histogramBounds, 0 if no histogram has been built yet.
+   */
+	int numHistogramBuckets;
+
+  /**
+   * Equi-depth histogram. Bucket b covers keys in [histogramBounds[b], histogramBounds[b + 1]] and holds
+   * roughly numKeys / numHistogramBuckets keys.
+   */
+	int histogramBounds[ INDEXHISTOGRAMBUCKETS + 1 ];
+
+  /**
+   * True if the histogram was estimated from sampled leaves rather than built from every key.
+   */
+	bool histogramSampled;
+};
+
 /**
  * @brief The meta page, which holds metadata for Index file, is always first page of the btree index file and is cast
  * to the following structure to store or retrieve information from it.
@@ -128,8 +237,21 @@ struct IndexMetaInfo{
    * Page number of root page of the B+ Tree inside the file index file.
    */
 	PageId rootPageNo;
+
+  /**
+   * Layout of the keys in the non-leaf nodes.
+   */
+	NodeLayout innerLayout;
+
+  /**
+   * Size, shape and key distribution of the tree.
+   */
+	IndexStats stats;
 };
 
+static_assert(sizeof(IndexMetaInfo) <= Page::SIZE,
+              "Index meta information must fit in the meta page.");
+
 /*
 Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
 These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of
@@ -224,10 +346,15 @@ class BTreeIndex {
 	int	leafOccupancy;
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
+   * Number of keys in non-leaf node, depending upon the type of key and the node layout.
    */
 	int	nodeOccupancy;
 
+  /**
+   * Layout of the keys in non-leaf nodes.
+   */
+	NodeLayout innerLayout;
+
 
 	// MEMBERS SPECIFIC TO SCANNING
 
@@ -242,14 +369,9 @@ class BTreeIndex {
 	int	nextEntry;
 
   /**
-   * Page number of current page being scanned.
+   * Current Page being scanned, kept pinned between calls to scanNext.
    */
-	PageId	currentPageNum;
-
-  /**
-   * Current Page being scanned.
-   */
-	Page	*currentPageData;
+	PageHandle	currentPage;
 
   /**
    * Low INTEGER value for scan.
@@ -296,18 +418,42 @@ class BTreeIndex {
    */
     PageId initialRootPageNum;
 
+  /**
+   * In-memory copy of the index statistics. Written back to the meta page when the index is closed.
+   */
+    IndexStats stats;
+
+  /**
+   * Page number of the rightmost leaf, 0 if it is not known yet. Appends go straight to it while it has room.
+   */
+    PageId rightmostLeafPageNum;
+
+  /**
+   * Bloom filter over the keys in the index, NULL if the index was opened without one.
+   */
+    BloomFilter *bloomFilter;
+
+  /**
+   * Name of the file the Bloom filter is kept in, next to the index file.
+   */
+    std::string bloomFileName;
+
+  /**
+   * True if the Bloom filter changed since it was read from or written to its file.
+   */
+    bool bloomFilterDirty;
+
 
     /**
      * Recursively perform insertion with different cases, the helper method perform the most important
      * insertion of the b+ tree
      *
-     * @param current       the current Page given
-     * @param curPageNum    the current Page Id given
+     * @param current       handle of the current Page given, released before returning
      * @param dataEntry     the index entry given to be inserted
      * @param newEntry      the new entry which is a page key pair pushed up to after splitting
      * @param isLeaf        whether the current page is a leaf node
      */
-    const void insertion(Page *current, PageId curPageNum, const RIDKeyPair<int> dataEntry,
+    const void insertion(PageHandle &current, const RIDKeyPair<int> dataEntry,
                                          PageKeyPair<int> *&newEntry,
                                          bool isLeaf);
 
@@ -315,22 +461,20 @@ class BTreeIndex {
       * Split the given non leaf node. It moves the values stored in the
       * given node after the split index into a new non leaf node.
       *
-      * @param node       the node given we will split from
-      * @param pageId     the page ID of the node given
+      * @param page       handle of the node given we will split from, released before returning
       * @param newEntry   the new entry which is a page key pair pushed up to after splitting
       */
-    const void splitNonLeaf(NonLeafNodeInt *node, PageId pageId, PageKeyPair<int> *&newEntry);
+    const void splitNonLeaf(PageHandle &page, PageKeyPair<int> *&newEntry);
 
     /**
       * Split function to split a leaf node into two
       * It moves the records after the split index into a new node.
       *
-      * @param node         the original given we will split from
-      * @param leafPageId  the page ID of the splitting leaf
+      * @param leafPage     handle of the leaf we will split from, released before returning
       * @param newEntry     the new entry which is a page key pair pushed up to after splitting
       * @param entry    the data entry given to perform insertion
       */
-    const void splitLeaf(LeafNodeInt *node, PageId leafPageId, PageKeyPair<int> *&newEntry,
+    const void splitLeaf(PageHandle &leafPage, PageKeyPair<int> *&newEntry,
                          const RIDKeyPair<int> entry);
 
     /**
@@ -380,6 +524,110 @@ class BTreeIndex {
       */
     const void findNext(NonLeafNodeInt *node, PageId &nextNodeNum, int val);
 
+    /**
+      * To find the slot of the child that the key value should be at the next level
+      *
+      * @param node          the current node given
+      * @param val           the value of key given
+      * @return              index of the child in pageNoArray
+      */
+    const int findChildIndex(NonLeafNodeInt *node, int val);
+
+    /**
+      * Rebuild the key count and block directory of a CACHE_BLOCKED non leaf node after its keys changed.
+      * Does nothing for the SORTED_ARRAY layout.
+      *
+      * @param node    the non leaf node given
+      */
+    const void buildBlockDirectory(NonLeafNodeInt *node);
+
+    /**
+      * Count the entries in use in the given leaf node. Entries are packed from the front of the node.
+      *
+      * @param node    the leaf node given
+      * @return        number of keys stored in the node
+      */
+    const int leafEntryCount(LeafNodeInt *node);
+
+    /**
+      * Count the child pointers in use in the given non leaf node.
+      *
+      * @param node    the non leaf node given
+      * @return        number of children of the node
+      */
+    const int nonLeafChildCount(NonLeafNodeInt *node);
+
+    /**
+      * Find the page Id of the leaf that the key value should be at.
+      *
+      * @param val           the value of key given
+      * @param leafPageNum   value for the page ID of the leaf
+      */
+    const void findLeaf(int val, PageId &leafPageNum);
+
+    /**
+      * Find the entries of a sorted leaf node that fall in a range.
+      *
+      * @param node    the leaf node given
+      * @param count   number of entries in the node
+      * @param lowVal  Low value of range
+      * @param lowOp   Low operator (GT/GTE)
+      * @param highVal High value of range
+      * @param highOp  High operator (LT/LTE)
+      * @param start   value for the index of the first entry not below the range
+      * @param end     value for the index of the first entry above the range
+      */
+    const void findRangeInLeaf(LeafNodeInt *node, int count, int lowVal, const Operator lowOp,
+                               int highVal, const Operator highOp, int &start, int &end);
+
+    /**
+      * Sum a run of keys, four at a time with SSE2 where available.
+      *
+      * @param keys    the first key given
+      * @param count   number of keys to add up
+      * @return        sum of the keys
+      */
+    const long long sumKeys(const int *keys, int count);
+
+    /**
+      * Find the page Id of the leftmost leaf of the tree.
+      *
+      * @param leafPageNum   value for the page ID of the leftmost leaf
+      */
+    const void findLeftmostLeaf(PageId &leafPageNum);
+
+    /**
+      * Rebuild the equi-depth histogram and the key bounds by walking the whole leaf chain.
+      * Called at the end of bulk load when every page of the index is at hand anyway.
+      */
+    const void buildHistogram();
+
+    /**
+      * Write the in-memory statistics back to the meta page.
+      */
+    const void writeStats();
+
+    /**
+      * Size a new Bloom filter for the current number of keys and fill it by walking the leaf chain.
+      */
+    const void rebuildBloomFilter();
+
+    /**
+      * Open the index file, or create it from the base relation, for the constructors.
+      *
+      * @param relationName        Name of file.
+      * @param outIndexName        Return the name of index file.
+      * @param indexBufMgr         Buffer Manager Instance for the index file
+      * @param relationBufMgr      Buffer Manager Instance to scan the base relation through
+      * @param attrByteOffset      Offset of attribute, over which index is to be built, in the record
+      * @param attrType            Datatype of attribute over which index is built
+      * @param useBloomFilter      Keep a Bloom filter over the keys next to the index file
+      * @param layout              Layout of the keys in non leaf nodes of a new index
+      */
+    const void openIndex(const std::string &relationName, std::string &outIndexName, BufMgr *indexBufMgr,
+                         BufMgr *relationBufMgr, const int attrByteOffset, const Datatype attrType,
+                         const bool useBloomFilter, const NodeLayout layout);
+
 public:
 
   /**
@@ -392,9 +640,39 @@ public:
    * @param bufMgrIn			Buffer Manager Instance
    * @param attrByteOffset		Offset of attribute, over which index is to be built, in the record
    * @param attrType			Datatype of attribute over which index is built
+   * @param useBloomFilter	Keep a Bloom filter over the keys in "<index file>.bloom" so that point lookups of
+   *							missing keys do not read any page
+   * @param layout			Layout of the keys in non-leaf nodes of a new index. An existing index keeps the
+   *							layout it was built with.
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const bool useBloomFilter = false, const NodeLayout layout = SORTED_ARRAY);
+
+  /**
+   * BTreeIndex Constructor taking its buffer pools from a BufPoolSet. The index file uses the pool its name is
+   * routed to, so that it can be kept apart from the base relation, which is scanned through its own pool.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param pools				Buffer pools to pick from
+   * @param attrByteOffset		Offset of attribute, over which index is to be built, in the record
+   * @param attrType			Datatype of attribute over which index is built
+   * @param useBloomFilter	Keep a Bloom filter over the keys in "<index file>.bloom"
+   * @param layout			Layout of the keys in non-leaf nodes of a new index
+   */
+	BTreeIndex(const std::string & relationName, std::string & outIndexName,
+						BufPoolSet *pools,	const int attrByteOffset,	const Datatype attrType,
+						const bool useBloomFilter = false, const NodeLayout layout = SORTED_ARRAY);
+
+  /**
+   * Returns the name of the index file over an attribute of a relation, to route it to a pool before the index
+   * is opened.
+   *
+   * @param relationName        Name of file.
+   * @param attrByteOffset		Offset of attribute in the record
+   */
+	static const std::string indexFileName(const std::string & relationName, const int attrByteOffset);
 
 
   /**
@@ -425,6 +703,8 @@ public:
 	* If another scan is already executing, that needs to be ended here.
 	* Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
 	* that satisfies the scan parameters. Keep that page pinned in the buffer pool.
+	* A point lookup (lowVal GTE, highVal LTE, lowVal == highVal) is answered from the Bloom filter, if any, when the
+	* key is definitely not in the index.
     * @param lowVal	Low value of range, pointer to integer / double / char string
     * @param lowOp		Low operator (GT/GTE)
     * @param highVal	High value of range, pointer to integer / double / char string
@@ -452,6 +732,43 @@ public:
 	**/
 	const void endScan();
 
+
+  /**
+	* Report the size and shape of the tree: height, leaf and non-leaf page counts, average fill factors,
+	* key bounds and the equi-depth key histogram. Page counts and fill factors are exact; the histogram is as of
+	* the last bulk load or refreshStats() call.
+    * @param outStats	Statistics of the index returned in this
+	**/
+	const void getStats(IndexStats& outStats);
+
+
+  /**
+	* Refresh the key bounds and histogram without reading the whole index. The bounds come from the leftmost and
+	* rightmost leaves; the histogram is rebuilt from keys picked by numSamples random root-to-leaf descents.
+	* The refreshed statistics are persisted in the meta page when the index is closed.
+    * @param numSamples	Number of random descents to make
+	**/
+	const void refreshStats(const int numSamples);
+
+
+  /**
+	* Compute an aggregate over the keys in a range using the index alone, without fetching any record.
+	* MIN and MAX descend to one boundary leaf; COUNT and SUM walk the leaves of the range, taking whole leaves
+	* at a time and reading only the keys. Does not disturb a scan in progress.
+    * @param lowVal	Low value of range, pointer to integer / double / char string
+    * @param lowOp		Low operator (GT/GTE)
+    * @param highVal	High value of range, pointer to integer / double / char string
+    * @param highOp	High operator (LT/LTE)
+    * @param kind		Aggregate to compute
+    * @return			The smallest or largest key, the number of entries or the sum of the keys in the range.
+	*					COUNT and SUM of an empty range are 0.
+    * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+    * @throws  BadScanrangeException If lowVal > highval
+	* @throws  NoSuchKeyFoundException If MIN or MAX is asked of a range with no key in the B+ tree.
+	**/
+	const long long aggregateRange(const void* lowVal, const Operator lowOp, const void* highVal,
+								   const Operator highOp, const AggKind kind);
+
 };
 
 }
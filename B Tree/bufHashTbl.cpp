@@ -15,100 +15,131 @@
 
 namespace badgerdb {
 
+std::uint64_t BufHashTbl::hashKey(const File* file, const PageId pageNo)
+{
+  // 64-bit finalizer over the whole pointer and the page number, so neighbouring
+  // pages of a file land in unrelated slots
+  std::uint64_t key = (std::uint64_t) (std::uintptr_t) file * 0x9e3779b97f4a7c15ULL ^ pageNo;
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
 int BufHashTbl::hash(const File* file, const PageId pageNo)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  return (int) (hashKey(file, pageNo) & mask);
 }
 
 BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
+	: HTSIZE(1), numEntries(0)
 {
-  // allocate an array of pointers to hashBuckets
-  ht = new hashBucket* [htSize];
+  while (HTSIZE < 2 * htSize)
+    HTSIZE *= 2;
+  mask = HTSIZE - 1;
+
+  // allocate the slots, all empty
+  ht = new hashBucket [HTSIZE];
   for(int i=0; i < HTSIZE; i++)
-    ht[i] = NULL;
+    ht[i].file = NULL;
 }
 
 BufHashTbl::~BufHashTbl()
 {
-  for(int i = 0; i < HTSIZE; i++) {
-    hashBucket* tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
-      delete tmpBuf;
-    }
-  }
   delete [] ht;
 }
 
-void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+int BufHashTbl::findSlot(const File* file, const PageId pageNo)
 {
-  int index = hash(file, pageNo);
+  std::uint64_t index = hash(file, pageNo);
+  while (ht[index].file != NULL) {
+    if (ht[index].file == file && ht[index].pageNo == pageNo)
+      return (int) index;
+    index = (index + 1) & mask;
+  }
+  return -1;
+}
 
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
+void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+{
+  if (!tryInsert(file, pageNo, frameNo))
+  {
+    FrameId presentFrameNo = 0;
+    tryLookup(file, pageNo, presentFrameNo);
+  	throw HashAlreadyPresentException(file->filename(), pageNo, presentFrameNo);
   }
+}
 
-  tmpBuc = new hashBucket;
-  if (!tmpBuc)
-  	throw HashTableException();
+void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+{
+  if (!tryLookup(file, pageNo, frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
+}
 
-  tmpBuc->file = (File*) file;
-  tmpBuc->pageNo = pageNo;
-  tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+void BufHashTbl::remove(const File* file, const PageId pageNo)
+{
+  if (!tryRemove(file, pageNo))
+    throw HashNotFoundException(file->filename(), pageNo);
 }
 
-void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+bool BufHashTbl::tryInsert(const File* file, const PageId pageNo, const FrameId frameNo)
 {
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-    {
-      frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
-    }
-    tmpBuc = tmpBuc->next;
+  if (numEntries == HTSIZE - 1)
+  	throw HashTableException();
+
+  std::uint64_t index = hash(file, pageNo);
+  while (ht[index].file != NULL) {
+    if (ht[index].file == file && ht[index].pageNo == pageNo)
+      return false;
+    index = (index + 1) & mask;
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  ht[index].file = (File*) file;
+  ht[index].pageNo = pageNo;
+  ht[index].frameNo = frameNo;
+  numEntries++;
+  return true;
 }
 
-void BufHashTbl::remove(const File* file, const PageId pageNo) {
+bool BufHashTbl::tryLookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+{
+  int index = findSlot(file, pageNo);
+  if (index < 0)
+    return false;
+
+  frameNo = ht[index].frameNo; // return frameNo by reference
+  return true;
+}
 
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  hashBucket* prevBuc = NULL;
+bool BufHashTbl::tryRemove(const File* file, const PageId pageNo) {
 
-  while (tmpBuc)
+  int found = findSlot(file, pageNo);
+  if (found < 0)
+    return false;
+
+  // Backward shift: pull later entries of the run into the hole unless that would
+  // move them in front of their home slot
+  std::uint64_t hole = found;
+  std::uint64_t index = hole;
+  while (true)
 	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-		{
-      if(prevBuc) 
-				prevBuc->next = tmpBuc->next;
-      else
-				ht[index] = tmpBuc->next;
+    index = (index + 1) & mask;
+    if (ht[index].file == NULL)
+      break;
 
-      delete tmpBuc;
-      return;
-    }
-		else
+    std::uint64_t home = hash(ht[index].file, ht[index].pageNo);
+    if (((index - home) & mask) >= ((index - hole) & mask))
 		{
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
+      ht[hole] = ht[index];
+      hole = index;
     }
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  ht[hole].file = NULL;
+  numEntries--;
+  return true;
 }
 
 }
@@ -7,12 +7,14 @@
 
 #pragma once
 
+#include <cstdint>
 #include "file.h"
 
 namespace badgerdb {
 
 /**
-* @brief Declarations for buffer pool hash table
+* @brief Declarations for buffer pool hash table. One slot of the open addressing table, sized so that four
+* slots share a cache line. A slot whose file is NULL is empty.
 */
 struct hashBucket {
 	/**
@@ -29,30 +31,40 @@ struct hashBucket {
 	 * frame number of page in the buffer pool
 	 */
 	FrameId frameNo;
-
-	/**
-	 * Next node in the hash table
-	 */
-	hashBucket*   next;
 };
 
 
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
+* Flat open addressing table with linear probing. Deletion shifts the following entries of the probe run back
+* instead of leaving tombstones, so lookups never scan past the run of their own key and no entry is ever
+* allocated on its own.
+*
 * @warning This class is not threadsafe.
 */
 class BufHashTbl
 {
  private:
 	/**
-	 *	Size of Hash Table
+	 *	Size of Hash Table, a power of two
 	 */
   int HTSIZE;
+
+	/**
+	 *	HTSIZE - 1, masks a hash value down to a slot
+	 */
+  std::uint64_t mask;
+
+	/**
+	 *	Number of entries in the table
+	 */
+  int numEntries;
+
 	/**
 	 * Actual Hash table object
 	 */
-  hashBucket**  ht;
+  hashBucket*  ht;
 
 	/**
 	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
@@ -63,9 +75,27 @@ class BufHashTbl
 	 */
   int	 hash(const File* file, const PageId pageNo);
 
+	/**
+	 * returns the slot holding (file, pageNo), or -1 if it is not in the table
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  int	 findSlot(const File* file, const PageId pageNo);
+
  public:
 	/**
-   * Constructor of BufHashTbl class
+	 * returns a well mixed 64-bit hash of file and pageNo. The table takes its slot from the low bits, so callers
+	 * partitioning pages above the table should use the high bits.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  static std::uint64_t hashKey(const File* file, const PageId pageNo);
+
+	/**
+   * Constructor of BufHashTbl class. The table is sized to at least twice htSize slots so that probe runs
+	 * stay short while htSize entries are present.
 	 */
 	BufHashTbl(const int htSize);  // constructor
 
@@ -104,6 +134,36 @@ class BufHashTbl
    * @throws HashNotFoundException if the page entry is not found in the hash table 
 	 */
   void remove(const File* file, const PageId pageNo);  
+
+	/**
+   * Insert entry into hash table mapping (file, pageNo) to frameNo, without throwing if it is already there.
+	 *
+	 * @param file   	File object
+	 * @param pageNo 	Page number in the file
+	 * @param frameNo Frame number assigned to that page of the file
+	 * @return				False if the page already exists in the hash table, in which case nothing is inserted
+	 */
+  bool tryInsert(const File* file, const PageId pageNo, const FrameId frameNo);
+
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool, without throwing on a miss.
+	 * This is the lookup used on the buffer manager's hit and miss paths.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference, set only when the page is found
+	 * @return				True if the page entry is found in the hash table
+	 */
+  bool tryLookup(const File* file, const PageId pageNo, FrameId &frameNo);
+
+	/**
+   * Delete entry (file,pageNo) from hash table, without throwing if it is not there.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return				False if the page entry is not found in the hash table
+	 */
+  bool tryRemove(const File* file, const PageId pageNo);
 };
 
 }
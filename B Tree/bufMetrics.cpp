@@ -0,0 +1,142 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstdio>
+#include <sstream>
+#include "bufMetrics.h"
+
+namespace badgerdb {
+
+const int LatencySnapshot::NUM_BUCKETS;
+
+std::uint64_t LatencySnapshot::percentileMicros(const double fraction) const
+{
+  if (count == 0)
+    return 0;
+
+  std::uint64_t wanted = (std::uint64_t) (fraction * count);
+  if (wanted >= count)
+    wanted = count - 1;
+  std::uint64_t seen = 0;
+  for (int b = 0; b < NUM_BUCKETS; b++)
+  {
+    seen += buckets[b];
+    if (seen > wanted)
+      return (std::uint64_t) 1 << b;
+  }
+  return (std::uint64_t) 1 << (NUM_BUCKETS - 1);
+}
+
+void LatencyHistogram::record(const std::uint64_t nanos)
+{
+  std::uint64_t micros = nanos / 1000;
+  int bucket = 0;
+  while (micros > 0 && bucket < LatencySnapshot::NUM_BUCKETS - 1)
+  {
+    micros >>= 1;
+    bucket++;
+  }
+
+  buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  totalNanos.fetch_add(nanos, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::clear()
+{
+  count = 0;
+  totalNanos = 0;
+  for (int b = 0; b < LatencySnapshot::NUM_BUCKETS; b++)
+    buckets[b] = 0;
+}
+
+void LatencyHistogram::snapshot(LatencySnapshot& out) const
+{
+  out.count = 0;
+  for (int b = 0; b < LatencySnapshot::NUM_BUCKETS; b++)
+  {
+    out.buckets[b] = buckets[b].load(std::memory_order_relaxed);
+    out.count += out.buckets[b];
+  }
+  out.totalNanos = totalNanos.load(std::memory_order_relaxed);
+}
+
+/**
+ * Write a string as a JSON string literal.
+ */
+static void writeJsonString(std::ostringstream& out, const std::string& value)
+{
+  out << '"';
+  for (std::size_t i = 0; i < value.size(); i++)
+  {
+    unsigned char c = (unsigned char) value[i];
+    if (c == '"' || c == '\\')
+      out << '\\' << value[i];
+    else if (c < 0x20)
+    {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out << escaped;
+    }
+    else
+      out << value[i];
+  }
+  out << '"';
+}
+
+static void writeJsonMetrics(std::ostringstream& out, const BufMetrics& metrics)
+{
+  out << "\"hits\":" << metrics.hits
+      << ",\"misses\":" << metrics.misses
+      << ",\"evictions\":" << metrics.evictions
+      << ",\"dirtyEvictions\":" << metrics.dirtyEvictions
+      << ",\"sweepSteps\":" << metrics.sweepSteps
+      << ",\"pinWaits\":" << metrics.pinWaits;
+}
+
+static void writeJsonLatency(std::ostringstream& out, const LatencySnapshot& latency)
+{
+  out << "{\"count\":" << latency.count
+      << ",\"totalNanos\":" << latency.totalNanos
+      << ",\"p50Micros\":" << latency.percentileMicros(0.5)
+      << ",\"p99Micros\":" << latency.percentileMicros(0.99)
+      << ",\"buckets\":[";
+  for (int b = 0; b < LatencySnapshot::NUM_BUCKETS; b++)
+    out << (b > 0 ? "," : "") << latency.buckets[b];
+  out << "]}";
+}
+
+std::string BufStatsSnapshot::toJson() const
+{
+  std::ostringstream out;
+  out << "{\"accesses\":" << accesses
+      << ",\"diskreads\":" << diskreads
+      << ",\"diskwrites\":" << diskwrites
+      << ",\"prefetches\":" << prefetches
+      << ",\"secondTierHits\":" << secondTierHits << ',';
+  writeJsonMetrics(out, total);
+
+  out << ",\"files\":{";
+  for (std::map<std::string, BufMetrics>::const_iterator it = files.begin(); it != files.end(); ++it)
+  {
+    if (it != files.begin())
+      out << ',';
+    writeJsonString(out, it->first);
+    out << ":{";
+    writeJsonMetrics(out, it->second);
+    out << '}';
+  }
+
+  out << "},\"readLatency\":";
+  writeJsonLatency(out, readLatency);
+  out << ",\"writeLatency\":";
+  writeJsonLatency(out, writeLatency);
+  out << '}';
+  return out.str();
+}
+
+}
@@ -0,0 +1,161 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <map>
+
+namespace badgerdb {
+
+/**
+* @brief Counts of buffer pool events for the pages of one file.
+*
+* Every shard keeps its own counters per file and only touches them with its latch held, so updating them costs no
+* atomic operation and threads working in different shards never share a cache line.
+*/
+struct BufMetrics
+{
+	/**
+	 * readPage() and readPageAsync() calls that found the page in the pool
+	 */
+	std::uint64_t hits;
+
+	/**
+	 * readPage() and readPageAsync() calls that had to read the page
+	 */
+	std::uint64_t misses;
+
+	/**
+	 * Pages of the file evicted to make room for other pages
+	 */
+	std::uint64_t evictions;
+
+	/**
+	 * Evicted pages that had to be written back first
+	 */
+	std::uint64_t dirtyEvictions;
+
+	/**
+	 * Frames the replacement policy looked at while finding room for pages of the file
+	 */
+	std::uint64_t sweepSteps;
+
+	/**
+	 * Times a reader of the file waited for another thread's read or write back of the page before pinning it
+	 */
+	std::uint64_t pinWaits;
+
+	BufMetrics()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		hits = misses = evictions = dirtyEvictions = sweepSteps = pinWaits = 0;
+	}
+
+	void add(const BufMetrics& other)
+	{
+		hits += other.hits;
+		misses += other.misses;
+		evictions += other.evictions;
+		dirtyEvictions += other.dirtyEvictions;
+		sweepSteps += other.sweepSteps;
+		pinWaits += other.pinWaits;
+	}
+};
+
+/**
+* @brief Copy of a LatencyHistogram taken at one point in time.
+*/
+struct LatencySnapshot
+{
+	/**
+	 * Number of buckets. Bucket 0 counts latencies below 1 microsecond and bucket b latencies from 2^(b-1) up to
+	 * 2^b microseconds; the last bucket also takes everything longer.
+	 */
+	static const int NUM_BUCKETS = 32;
+
+	std::uint64_t count;
+	std::uint64_t totalNanos;
+	std::uint64_t buckets[NUM_BUCKETS];
+
+	/**
+	 * Returns the upper bound, in microseconds, of the bucket holding the given fraction of the latencies, or 0 if
+	 * nothing was recorded.
+	 *
+	 * @param fraction	Fraction between 0 and 1, 0.99 for the 99th percentile
+	 */
+	std::uint64_t percentileMicros(const double fraction) const;
+};
+
+/**
+* @brief Latencies bucketed by powers of two, recorded without a lock from any thread.
+*/
+class LatencyHistogram
+{
+ public:
+	LatencyHistogram()
+	{
+		clear();
+	}
+
+	/**
+	 * Record one latency.
+	 */
+	void record(const std::uint64_t nanos);
+
+	void clear();
+
+	/**
+	 * Copy the counts out. Latencies recorded meanwhile may or may not be included.
+	 */
+	void snapshot(LatencySnapshot& out) const;
+
+ private:
+	std::atomic<std::uint64_t> count;
+	std::atomic<std::uint64_t> totalNanos;
+	std::atomic<std::uint64_t> buckets[LatencySnapshot::NUM_BUCKETS];
+};
+
+/**
+* @brief Everything the buffer pool has measured, gathered by BufMgr::getStatsSnapshot().
+*/
+struct BufStatsSnapshot
+{
+	/**
+	 * The BufStats counters
+	 */
+	std::uint64_t accesses;
+	std::uint64_t diskreads;
+	std::uint64_t diskwrites;
+	std::uint64_t prefetches;
+	std::uint64_t secondTierHits;
+
+	/**
+	 * Event counts of the whole pool, and of each file by name
+	 */
+	BufMetrics total;
+	std::map<std::string, BufMetrics> files;
+
+	/**
+	 * Time taken by the disk reads of readPage() misses, and by every write of pages to disk
+	 */
+	LatencySnapshot readLatency;
+	LatencySnapshot writeLatency;
+
+	/**
+	 * Returns the snapshot as a JSON object.
+	 */
+	std::string toJson() const;
+};
+
+}
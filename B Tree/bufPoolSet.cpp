@@ -0,0 +1,154 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "bufPoolSet.h"
+
+namespace badgerdb {
+
+BufPoolSet::BufPoolSet()
+	: defaultPool(NULL), memoryBudget(0)
+{
+}
+
+BufPoolSet::~BufPoolSet()
+{
+  for (std::map<std::string, BufMgr*>::iterator it = pools.begin(); it != pools.end(); ++it)
+    delete it->second;
+}
+
+BufMgr* BufPoolSet::createPool(const std::string& name, const std::uint32_t bufs, const std::uint32_t shards,
+                               const ReplacementKind policy, const std::uint32_t maxBufs,
+                               const std::uint32_t pagesPerFrame)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  if (pools.find(name) != pools.end())
+    return NULL;
+
+  BufMgr* pool = new BufMgr(bufs, shards, policy, maxBufs, pagesPerFrame);
+  pools[name] = pool;
+  if (defaultPool == NULL)
+    defaultPool = pool;
+  return pool;
+}
+
+BufMgr* BufPoolSet::getPool(const std::string& name) const
+{
+  std::lock_guard<std::mutex> lock(latch);
+  std::map<std::string, BufMgr*>::const_iterator it = pools.find(name);
+  return it != pools.end() ? it->second : NULL;
+}
+
+std::vector<std::string> BufPoolSet::getPoolNames() const
+{
+  std::lock_guard<std::mutex> lock(latch);
+  std::vector<std::string> names;
+  for (std::map<std::string, BufMgr*>::const_iterator it = pools.begin(); it != pools.end(); ++it)
+    names.push_back(it->first);
+  return names;
+}
+
+bool BufPoolSet::setDefaultPool(const std::string& name)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  std::map<std::string, BufMgr*>::iterator it = pools.find(name);
+  if (it == pools.end())
+    return false;
+  defaultPool = it->second;
+  return true;
+}
+
+bool BufPoolSet::assignFile(const std::string& filename, const std::string& pool)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  std::map<std::string, BufMgr*>::iterator it = pools.find(pool);
+  if (it == pools.end())
+    return false;
+  routes[filename] = it->second;
+  return true;
+}
+
+bool BufPoolSet::declarePageSize(const std::string& filename, const std::size_t pageSize)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  for (std::map<std::string, BufMgr*>::iterator it = pools.begin(); it != pools.end(); ++it)
+  {
+    if (it->second->getFrameSize() == pageSize)
+    {
+      routes[filename] = it->second;
+      return true;
+    }
+  }
+  return false;
+}
+
+void BufPoolSet::setMemoryBudget(const std::size_t bytes)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  memoryBudget = bytes;
+}
+
+std::size_t BufPoolSet::rebalance()
+{
+  // what each pool read from disk since the last call, plus a frame's worth so that an idle pool keeps a share
+  std::vector<BufMgr*> list;
+  std::vector<double> weights;
+  double totalWeight = 0;
+  std::size_t budget;
+  {
+    std::lock_guard<std::mutex> lock(latch);
+    budget = memoryBudget;
+    if (budget == 0)
+      return 0;
+    for (std::map<std::string, BufMgr*>::iterator it = pools.begin(); it != pools.end(); ++it)
+    {
+      BufStatsSnapshot stats;
+      it->second->getStatsSnapshot(stats);
+      std::uint64_t& last = lastMisses[it->second];
+      std::uint64_t misses = stats.total.misses >= last ? stats.total.misses - last : stats.total.misses;
+      last = stats.total.misses;
+
+      list.push_back(it->second);
+      weights.push_back((double) (misses + 1) * it->second->getFrameSize());
+      totalWeight += weights.back();
+    }
+  }
+
+  // shrink first, so that the pools never hold much more than the budget between resizes
+  std::vector<std::uint32_t> wanted(list.size());
+  for (std::size_t n = 0; n < list.size(); n++)
+    wanted[n] = (std::uint32_t) (budget * (weights[n] / totalWeight) / list[n]->getFrameSize());
+
+  for (std::size_t n = 0; n < list.size(); n++)
+  {
+    if (wanted[n] < list[n]->getNumBufs())
+      list[n]->resize(wanted[n]);
+  }
+
+  std::size_t total = 0;
+  for (std::size_t n = 0; n < list.size(); n++)
+  {
+    if (wanted[n] > list[n]->getNumBufs())
+      list[n]->resize(wanted[n]);
+    total += (std::size_t) list[n]->getNumBufs() * list[n]->getFrameSize();
+  }
+  return total;
+}
+
+void BufPoolSet::unassignFile(const std::string& filename)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  routes.erase(filename);
+}
+
+BufMgr* BufPoolSet::poolFor(const std::string& filename) const
+{
+  std::lock_guard<std::mutex> lock(latch);
+  std::unordered_map<std::string, BufMgr*>::const_iterator it = routes.find(filename);
+  return it != routes.end() ? it->second : defaultPool;
+}
+
+}
@@ -0,0 +1,163 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include "buffer.h"
+
+namespace badgerdb {
+
+/**
+* @brief Named buffer pools, each a BufMgr with its own size and replacement policy, and the routing of files to
+* them.
+*
+* Keeping index pages and scanned relation pages in different pools stops a large scan from evicting the index.
+* Files are routed by name rather than by File object, so a route can be set up before the file is opened, as
+* BTreeIndex opens its index file itself. Files with no route go to the default pool, the first one created unless
+* changed with setDefaultPool().
+*
+* Pools may have frames of different sizes, for files with pages larger than Page::SIZE. A file declares its page
+* size to be routed to a pool of that frame size, and the pools can share one memory budget, moved between them by
+* rebalance() towards those reading the most from disk.
+*/
+class BufPoolSet
+{
+ public:
+	BufPoolSet();
+
+	/**
+	 * Deletes every pool. Every file using one must have been flushed or closed first.
+	 */
+	~BufPoolSet();
+
+	/**
+	 * Create a pool. Arguments after the name are those of the BufMgr constructor.
+	 *
+	 * @param name		Name of the pool
+	 * @param bufs		Number of frames in the pool
+	 * @param shards	Number of shards, or 0 to pick automatically
+	 * @param policy	Replacement policy of the pool
+	 * @param maxBufs	Most frames the pool may be resized to, or 0 for bufs
+	 * @param pagesPerFrame	Pages each frame holds
+	 * @return			The pool, owned by this object, or NULL if a pool of that name already exists
+	 */
+	BufMgr* createPool(const std::string& name, const std::uint32_t bufs, const std::uint32_t shards = 0,
+					   const ReplacementKind policy = REPL_CLOCK, const std::uint32_t maxBufs = 0,
+					   const std::uint32_t pagesPerFrame = 1);
+
+	/**
+	 * Returns the pool of the given name, or NULL if there is none.
+	 */
+	BufMgr* getPool(const std::string& name) const;
+
+	/**
+	 * Returns the names of all pools, in order.
+	 */
+	std::vector<std::string> getPoolNames() const;
+
+	/**
+	 * Make a pool the one files with no route go to.
+	 *
+	 * @param name		Name of the pool
+	 * @return			False if there is no such pool
+	 */
+	bool setDefaultPool(const std::string& name);
+
+	/**
+	 * Route a file to a pool. Pages of the file already in another pool stay there until it is flushed, so routes
+	 * should be set up before the file is first read.
+	 *
+	 * @param filename	Name of the file
+	 * @param pool		Name of the pool
+	 * @return			False if there is no such pool
+	 */
+	bool assignFile(const std::string& filename, const std::string& pool);
+
+	/**
+	 * Route a file to the first pool, by name, whose frames are the size of the file's pages.
+	 *
+	 * @param filename	Name of the file
+	 * @param pageSize	Bytes in a page of the file, a multiple of Page::SIZE
+	 * @return			False if no pool has frames of that size
+	 */
+	bool declarePageSize(const std::string& filename, const std::size_t pageSize);
+
+	/**
+	 * Set the memory every pool together may use for frames, for rebalance() to share out.
+	 *
+	 * @param bytes		Memory budget, 0 for none
+	 */
+	void setMemoryBudget(const std::size_t bytes);
+
+	/**
+	 * Share the memory budget out again, each pool getting a part in proportion to the bytes it read from disk on
+	 * misses since the last call, and resizing to it within its maxBufs. A pool that read nothing keeps a small part
+	 * rather than none. Pools are resized one at a time, and pages pinned in frames being taken away are waited for,
+	 * so the caller must not hold any pins itself. Does nothing without a budget.
+	 *
+	 * @return			Bytes of frames the pools have now
+	 */
+	std::size_t rebalance();
+
+	/**
+	 * Send a file back to the default pool.
+	 *
+	 * @param filename	Name of the file
+	 */
+	void unassignFile(const std::string& filename);
+
+	/**
+	 * Returns the pool a file is routed to, or the default pool, or NULL if no pool has been created.
+	 *
+	 * @param filename	Name of the file
+	 */
+	BufMgr* poolFor(const std::string& filename) const;
+
+	BufMgr* poolFor(const File* file) const
+	{
+		return poolFor(file->filename());
+	}
+
+ private:
+	/**
+	 * Guards everything below
+	 */
+	mutable std::mutex latch;
+
+	/**
+	 * Pools by name
+	 */
+	std::map<std::string, BufMgr*> pools;
+
+	/**
+	 * Pool of every routed file, by file name
+	 */
+	std::unordered_map<std::string, BufMgr*> routes;
+
+	/**
+	 * Pool of files with no route
+	 */
+	BufMgr* defaultPool;
+
+	/**
+	 * Memory budget of all pools, 0 for none
+	 */
+	std::size_t memoryBudget;
+
+	/**
+	 * Misses of each pool when the budget was last shared out
+	 */
+	std::unordered_map<BufMgr*, std::uint64_t> lastMisses;
+};
+
+}
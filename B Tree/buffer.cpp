@@ -7,6 +7,18 @@
 
 #include <memory>
 #include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <unordered_set>
+#include <new>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
@@ -16,137 +28,536 @@
 
 namespace badgerdb { 
 
+// frames are laid out back to back, so each starts on a boundary good for O_DIRECT
+static_assert(sizeof(Page) == Page::SIZE, "Page objects must be exactly one page.");
+
+/**
+ * Map memory for the buffer pool. Explicit huge pages are used if allowed and any are reserved; otherwise ordinary
+ * pages, aligned to a huge page and marked for transparent huge pages. Either way the memory reads as zeros and is
+ * only backed once touched.
+ */
+static void* mapPool(const std::size_t bytes, const std::size_t hugePageSize, const bool allowHugeTLB, bool& huge)
+{
+#ifdef MAP_HUGETLB
+  if (allowHugeTLB)
+  {
+    void* pool = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (pool != MAP_FAILED)
+    {
+      huge = true;
+      return pool;
+    }
+  }
+#endif
+  huge = false;
+
+  // map a huge page more than needed and trim both ends to the aligned part
+  char* raw = static_cast<char*>(mmap(NULL, bytes + hugePageSize, PROT_READ | PROT_WRITE,
+                                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+  if (raw == MAP_FAILED)
+    throw std::bad_alloc();
+  char* aligned = reinterpret_cast<char*>(
+    (reinterpret_cast<std::uintptr_t>(raw) + hugePageSize - 1) & ~(std::uintptr_t) (hugePageSize - 1));
+  if (aligned > raw)
+    munmap(raw, aligned - raw);
+  munmap(aligned + bytes, raw + hugePageSize - aligned);
+
+#ifdef MADV_HUGEPAGE
+  madvise(aligned, bytes, MADV_HUGEPAGE);
+#endif
+  return aligned;
+}
+
+/**
+ * Returns the nanoseconds since a point in time.
+ */
+static std::uint64_t elapsedNanos(const std::chrono::steady_clock::time_point start)
+{
+  return (std::uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Size of the hash table for a shard with the given number of frames
+ */
+static int hashTableSize(const std::uint32_t numFrames)
+{
+  return ((((int) (numFrames * 1.2))*2)/2)+1;
+}
+
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
-	bufDescTable = new BufDesc[bufs];
+BufMgr::BufMgr(std::uint32_t bufs, std::uint32_t numShardsParm, ReplacementKind policy, std::uint32_t maxBufsParm,
+               std::uint32_t pagesPerFrame)
+	: numBufs(bufs), maxBufs(maxBufsParm > bufs ? maxBufsParm : bufs), warmUpStop(false),
+	  writerStop(false), writerCleanPercent(0), writerIntervalMs(0), secondTier(0), framePages(1), sharedPool(NULL) {
+  // blocks must tile the file evenly, and their pages fit the present mask
+  while (framePages < pagesPerFrame && framePages < MAX_FRAME_PAGES)
+    framePages *= 2;
 
-  for (FrameId i = 0; i < bufs; i++) 
+	// descriptors and address space for the largest the pool may grow to, memory is only used once frames are
+	bufDescTable = new BufDesc[maxBufs];
+
+  for (FrameId i = 0; i < maxBufs; i++) 
   {
   	bufDescTable[i].frameNo = i;
   	bufDescTable[i].valid = false;
   }
 
-  bufPool = new Page[bufs];
+  // explicit huge pages are reserved when mapped, so only for a pool that cannot grow
+  poolBytes = ((std::size_t) maxBufs * getFrameSize() + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+  bufPool = static_cast<Page*>(mapPool(poolBytes, HUGE_PAGE_SIZE, maxBufs == bufs, poolHugePages));
+
+  // deal the pool out to the NUMA nodes in turn. Nothing is backed yet, so every frame ends up on its node
+  // whichever thread touches it first
+  numa = &NumaTopology::system();
+  std::size_t runBytes = (std::size_t) BufShard::NODE_RUN_FRAMES * getFrameSize();
+  if (numa->getNumNodes() > 1)
+  {
+    for (std::size_t run = 0; run * runBytes < poolBytes; run++)
+      numa->bind(reinterpret_cast<char*>(bufPool) + run * runBytes, runBytes, run % numa->getNumNodes());
+  }
+
+  // one shard per hardware thread, as long as every shard keeps a useful number of frames
+  numShards = numShardsParm;
+  if (numShards == 0)
+  {
+    std::uint32_t threads = std::thread::hardware_concurrency();
+    numShards = 1;
+    while (numShards * 2 <= threads && bufs / (numShards * 2) >= MIN_SHARD_FRAMES)
+      numShards *= 2;
+  }
+  if (numShards > bufs)
+    numShards = bufs;
+
+  shards = new BufShard[numShards];
+  for (std::uint32_t i = 0; i < numShards; i++)
+  {
+    shards[i].index = i;
+    shards[i].numFrames = framesOfShard(i, bufs);
+    shards[i].stride = numShards;
+    shards[i].writerHand = 0;
+    shards[i].descTable = bufDescTable;
+    shards[i].numNodes = numa->getNumNodes();
+    shards[i].freeSlots.resize(shards[i].numNodes);
+    shards[i].numFree = 0;
+
+    shards[i].hashTable = new BufHashTbl (hashTableSize(shards[i].numFrames));  // allocate the buffer hash table
+    shards[i].policy = ReplacementPolicy::create(policy, shards[i].numFrames);
+
+    // every frame starts out empty, handed out lowest first
+    for (std::uint32_t slot = shards[i].numFrames; slot > 0; slot--)
+      shards[i].pushFree(slot - 1);
+  }
+
+  ioEngine = IOEngine::create(*this, IO_QUEUE_DEPTH, IO_WORKERS);
 
-  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+  readAheadMax = bufs / 4 < READ_AHEAD_MAX ? bufs / 4 : READ_AHEAD_MAX;
+  readAheadOn = true;
+  File::addCloseHandler(&BufMgr::fileClosed, this);
+}
 
-  clockHand = bufs - 1;
+BufMgr::BufMgr(const std::string& sharedName, std::uint32_t bufs)
+	: numBufs(0), maxBufs(0), numShards(0), shards(NULL), warmUpStop(false), writerStop(false), writerCleanPercent(0),
+	  writerIntervalMs(0), ioEngine(NULL), readAheadOn(false), readAheadMax(0), bufDescTable(NULL), secondTier(0),
+	  poolBytes(0), poolHugePages(false), framePages(1), sharedPool(NULL) {
+  // everything but the statistics lives in the segment
+  sharedPool = new SharedBufPool(sharedName, bufs, bufStats);
+  bufPool = sharedPool->frames();
+  numBufs = maxBufs = sharedPool->getNumBufs();
+  numa = &NumaTopology::system();
+  File::addCloseHandler(&BufMgr::fileClosed, this);
 }
 
 
 BufMgr::~BufMgr() {
+  File::removeCloseHandler(&BufMgr::fileClosed, this);
+  stopWarmUp();
+  if (!hotPagePath.empty())
+    saveHotPages(hotPagePath);
+  stopBackgroundWriter();
+
+  // the pages stay in the segment for the other processes
+  if (sharedPool != NULL)
+  {
+    delete sharedPool;
+    return;
+  }
+
+  // let reads in flight land before the frames go away
+  delete ioEngine;
+
   //Flush out all unwritten pages
   for (std::uint32_t i = 0; i < numBufs; i++) 
   {
   	BufDesc* tmpbuf = &bufDescTable[i];
   	if (tmpbuf->valid == true && tmpbuf->dirty == true)
 		{
-			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+			writeFrame(i);
   	}
   }
 
+  for (std::uint32_t i = 0; i < numShards; i++)
+  {
+    delete shards[i].hashTable;
+    delete shards[i].policy;
+  }
+  delete [] shards;
   delete [] bufDescTable;
-  delete [] bufPool;
+  munmap(bufPool, poolBytes);
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+void BufMgr::allocBuf(BufShard & shard, std::unique_lock<std::mutex> & lock, const std::uint32_t fileId,
+                      const std::uint64_t key, FrameId & frame, const bool cleanOnly) 
 {
-  // perform first part of clock algorithm to search for 
-  // open buffer frame
-  // Assumes non-concurrent access to buffer manager
-  std::uint32_t numScanned = 0;
-  bool found = 0;
+  // use an empty frame if the shard has one, on this thread's NUMA node if there is
+  std::uint32_t node = shard.numNodes > 1 ? numa->currentNode() : BufShard::ANY_NODE;
+  std::uint32_t slot;
+  if (shard.popFree(node, slot))
+  {
+    frame = frameOf(shard, slot);
+    return;
+  }
+
+  // otherwise evict a page, from this thread's node if any will do. A frame borrowed earlier comes last, then a
+  // new one is borrowed from another shard; only clean pages are evicted there, so no reads wait for writes elsewhere.
+  // The shard's hash table is sized for twice its own frames at most
+  FrameId frameNo;
+  if (pickVictim(shard, fileId, key, node, cleanOnly, slot) ||
+      (node != BufShard::ANY_NODE && pickVictim(shard, fileId, key, BufShard::ANY_NODE, cleanOnly, slot)))
+  {
+    frameNo = frameOf(shard, slot);
+  }
+  else if (!pickBorrowed(shard, cleanOnly, frameNo))
+  {
+    if (cleanOnly || shard.borrowed.size() >= shard.numFrames || !borrowFrame(shard, lock, fileId, key, frame))
+      throw BufferExceededException();
+    return;
+  }
+
+  if (bufDescTable[frameNo].valid)
+    evictFrame(shard, lock, frameNo);
+
+  // resize() may have taken the frame away while the latch was dropped, it is empty now as resize() wants
+  if (frameNo % numShards == shard.index && slotOf(frameNo) >= shard.numFrames)
+  {
+    shard.ioDone.notify_all();
+    allocBuf(shard, lock, fileId, key, frame, cleanOnly);
+    return;
+  }
+
+  // return new frame number
+  frame = frameNo;
+} // end allocBuf
 
-  while (numScanned < 2*numBufs)	//Need to scn twice
+void BufMgr::evictFrame(BufShard & shard, std::unique_lock<std::mutex> & lock, const FrameId frameNo)
+{
+  BufDesc* victim = &bufDescTable[frameNo];
+  bool dirty = victim->dirty;
+  bool keepCopy = framePages == 1 && secondTier.getCapacity() > 0;
+  
+  // flush any existing changes to disk if necessary, then keep a compressed copy of the clean page, which saves
+  // reading it back. The latch is dropped for both; IO_WRITE keeps other threads from pinning or reusing the frame
+  // meanwhile, and a miss on the page waits for the frame instead of looking in the second tier too early
+  if (dirty || keepCopy)
   {
-    // advance the clock
-    advanceClock();
-    numScanned++;
+    // the background writer, if running, is falling behind
+    if (dirty)
+      writerWake.notify_one();
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
+    victim->ioState = IO_WRITE;
+    lock.unlock();
+    try
     {
-      break;
+      if (dirty)
+        writeFrame(frameNo);
+      if (keepCopy)
+        secondTier.put(victim->file, victim->pageNo, bufPool[frameNo]);
+    }
+    catch(...)
+    {
+      lock.lock();
+      victim->ioState = IO_NONE;
+      pageLoaded(shard, frameNo, BufHashTbl::hashKey(victim->file, victim->pageNo));
+      shard.ioDone.notify_all();
+      throw;
+    }
+    lock.lock();
+    if (dirty)
+      shard.metricsOf(victim->metricsId).dirtyEvictions++;
+    victim->ioState = IO_NONE;
+    shard.ioDone.notify_all();
+  }
+  shard.metricsOf(victim->metricsId).evictions++;
+
+  // remove previous entry from hash table
+  shard.hashTable->tryRemove(victim->file, victim->pageNo);
+  unlinkFrame(frameNo);
+
+	//Reset all the BufDesc entry for the frame before returning the frame
+  victim->Clear();
+}
+
+bool BufMgr::pickBorrowed(BufShard & shard, const bool cleanOnly, FrameId & frame)
+{
+  for (std::size_t n = 0; n < shard.borrowed.size(); n++)
+  {
+    const BufDesc& desc = bufDescTable[shard.borrowed[n]];
+    if (!desc.valid ||
+        (desc.pinCnt == 0 && desc.ioState == IO_NONE && !(cleanOnly && desc.dirty)))
+    {
+      frame = shard.borrowed[n];
+      return true;
     }
+  }
+  return false;
+}
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
+bool BufMgr::borrowFrame(BufShard & shard, std::unique_lock<std::mutex> & lock, const std::uint32_t fileId,
+                         const std::uint64_t key, FrameId & frame)
+{
+  lock.unlock();
+  bool lent = false;
+  for (std::uint32_t n = 1; n < numShards && !lent; n++)
+  {
+    // only the lender's own frames are lent, never ones it borrowed itself
+    BufShard& lender = shards[(shard.index + n) % numShards];
+    std::unique_lock<std::mutex> lenderLock(lender.latch);
+    std::uint32_t slot;
+    if (lender.popFree(BufShard::ANY_NODE, slot) ||
+        pickVictim(lender, fileId, key, BufShard::ANY_NODE, true, slot))
     {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
+      frame = frameOf(lender, slot);
+      if (bufDescTable[frame].valid)
+        evictFrame(lender, lenderLock, frame);
+
+      // resize() may have taken the frame away while the page was copied to the second tier
+      if (slot >= lender.numFrames)
       {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
-        break;
+        lender.ioDone.notify_all();
+        continue;
       }
+      bufDescTable[frame].lentTo = shard.index;
+      lent = true;
     }
-    else
+  }
+  lock.lock();
+
+  if (lent)
+    shard.borrowed.push_back(frame);
+  return lent;
+}
+
+bool BufMgr::returnFrame(BufShard & shard, const FrameId frameNo)
+{
+  // borrowFrame() marks the frame lent before it can list it with the borrower
+  std::vector<FrameId>::iterator it = std::find(shard.borrowed.begin(), shard.borrowed.end(), frameNo);
+  if (it == shard.borrowed.end())
+    return false;
+
+  BufShard& owner = shards[frameNo % numShards];
+  std::unique_lock<std::mutex> ownerLock(owner.latch, std::try_to_lock);
+  if (!ownerLock.owns_lock())
+    return false;
+
+  shard.borrowed.erase(it);
+  bufDescTable[frameNo].lentTo = BufDesc::NOT_LENT;
+  freeFrame(owner, frameNo);
+  owner.ioDone.notify_all();
+  return true;
+}
+
+void BufMgr::reclaimFrame(BufShard & shard, std::unique_lock<std::mutex> & lock, const FrameId frameNo)
+{
+  BufDesc& desc = bufDescTable[frameNo];
+  std::uint32_t lentTo = desc.lentTo;
+  if (lentTo == BufDesc::NOT_LENT)
+    return;
+
+  BufShard& borrower = shards[lentTo];
+  lock.unlock();
+  try
+  {
+    std::unique_lock<std::mutex> borrowerLock(borrower.latch);
+    if (desc.lentTo == lentTo)
     {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
+      if (desc.valid && (desc.pinCnt > 0 || desc.ioState != IO_NONE))
+      {
+        // the borrower's lookups of the page wait too, once it is evicted
+        borrower.ioDone.wait_for(borrowerLock, std::chrono::milliseconds(10));
+      }
+      else
+      {
+        if (desc.valid)
+          evictFrame(borrower, borrowerLock, frameNo);
+        if (!returnFrame(borrower, frameNo))
+          borrower.ioDone.wait_for(borrowerLock, std::chrono::milliseconds(1));
+      }
     }
   }
-  
-  // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+  catch(...)
   {
-    throw BufferExceededException();
+    lock.lock();
+    throw;
   }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+  lock.lock();
+}
+
+bool BufMgr::pickVictim(BufShard & shard, const std::uint32_t fileId, const std::uint64_t key, const std::uint32_t node,
+                        const bool cleanOnly, std::uint32_t & slot)
+{
+  // a victim the background writer picked ahead of need. One discardFile() or flushFile() is dropping is passed
+  // over until they are done with it
+  for (std::size_t n = 0; n < shard.readySlots.size(); n++)
   {
-    bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    slot = shard.readySlots[n];
+    if ((node != BufShard::ANY_NODE && shard.nodeOf(slot) != node) || !shard.canEvictClean(slot))
+      continue;
+
+    shard.readySlots.erase(shard.readySlots.begin() + n);
+    bufDescTable[frameOf(shard, slot)].ready = false;
+    if (shard.readySlots.size() == READY_QUEUE_SIZE / 2)
+      writerWake.notify_one();
+    return true;
   }
 
-	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+  // otherwise let the policy pick an unpinned page to evict
+  CleanEvictionCheck clean(shard);
+  NodeEvictionCheck onNode(cleanOnly ? (const EvictionCheck&) clean : shard, shard, node);
+  CountingEvictionCheck check(onNode);
+  bool picked = shard.policy->pickVictim(check, key, slot);
+  shard.metricsOf(fileId).sweepSteps += check.steps;
+  return picked;
+}
 
-  // return new frame number
-  frame = clockHand;
-} // end allocBuf
+bool BufMgr::claimFrame(BufShard & shard, std::unique_lock<std::mutex> & lock, File* file, const PageId pageNo,
+                        const std::uint64_t key, FrameId & frame, const bool cleanOnly)
+{
+  FrameId newFrameNo;
+  std::uint32_t fileId = metricsIdOf(file);
+  allocBuf(shard, lock, fileId, key, newFrameNo, cleanOnly);
+
+  // the latch may have been dropped, someone else may have brought the page in
+  FrameId frameNo;
+  if (shard.hashTable->tryLookup(file, pageNo, frameNo))
+  {
+    freeFrame(shard, newFrameNo);
+    return false;
+  }
+
+  // claim the frame for the page before reading so concurrent misses wait for this read
+  bufDescTable[newFrameNo].Set(file, pageNo);
+  bufDescTable[newFrameNo].ioState = IO_READ;
+  bufDescTable[newFrameNo].pendingReads = framePages;
+  bufDescTable[newFrameNo].metricsId = fileId;
+  shard.hashTable->tryInsert(file, pageNo, newFrameNo);
+  linkFrame(newFrameNo);
+  pageLoaded(shard, newFrameNo, key);
+  frame = newFrameNo;
+  return true;
+}
 
 	
 void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 {
-  // check to see if it is already in the buffer pool
-  // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
-  FrameId frameNo = 0;
-	try
-	{
-  	hashTable->lookup(file, pageNo, frameNo);
+  if (sharedPool != NULL)
+    return sharedPool->readPage(file, pageNo, page);
 
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
-  }
-  catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
+  // get reads ahead of a sequential run going before possibly blocking on this page
+  PageId aheadFirst;
+  std::uint32_t aheadCount;
+  if (noteAccess(file, pageNo, aheadFirst, aheadCount))
+    prefetch(file, aheadFirst, aheadCount);
+
+  // the pool holds the page's block, a single page unless frames hold several
+  PageId block = blockOf(pageNo);
+  std::uint64_t key = BufHashTbl::hashKey(file, block);
+  BufShard& shard = shardOf(file, block);
+  std::unique_lock<std::mutex> lock(shard.latch);
+  bufStats.accesses++;
+
+  FrameId frameNo = 0;
+  while (true)
   {
-    // alloc a new frame
-    allocBuf(frameNo);
+    // check to see if it is already in the buffer pool
+    if (shard.hashTable->tryLookup(file, block, frameNo))
+    {
+      // another thread is reading or writing back the page, wait for it and look again.
+      // The background writer works from a copy, so its writes need no waiting
+      if (bufDescTable[frameNo].ioState == IO_READ || bufDescTable[frameNo].ioState == IO_WRITE)
+      {
+        shard.metricsOf(bufDescTable[frameNo].metricsId).pinWaits++;
+        shard.ioDone.wait(lock);
+        continue;
+      }
 
-    // read the page into the new frame
-    bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
+      // an asynchronous read of the page failed and a reader still holds it
+      if (bufDescTable[frameNo].ioError)
+        std::rethrow_exception(bufDescTable[frameNo].ioError);
+
+      shard.metricsOf(bufDescTable[frameNo].metricsId).hits++;
+      // set the referenced bit
+      bufDescTable[frameNo].refbit = true;
+      bufDescTable[frameNo].pinCnt++;
+      pageHit(shard, frameNo);
+      page = frameData(frameNo) + (pageNo - block);
+
+      // the block is in, but not this page of it
+      if (!hasPage(bufDescTable[frameNo], pageNo))
+      {
+        try
+        {
+          fillPage(shard, lock, frameNo, pageNo);
+        }
+        catch(...)
+        {
+          bufDescTable[frameNo].pinCnt--;
+          throw;
+        }
+      }
+      return;
+    }
+
+    //not in the buffer pool, must allocate a new page
+    if (!claimFrame(shard, lock, file, block, key, frameNo))
+      continue;
+    shard.metricsOf(bufDescTable[frameNo].metricsId).misses++;
+    lock.unlock();
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+    page = frameData(frameNo) + (pageNo - block);
+    if (framePages == 1 && readFromSecondTier(file, pageNo, frameNo))
+      return;
+
+    // read the page into the new frame
+    std::uint64_t present;
+    try
+    {
+      std::chrono::steady_clock::time_point began = std::chrono::steady_clock::now();
+      present = readBlock(file, pageNo, frameNo);
+      bufStats.readLatency.record(elapsedNanos(began));
+    }
+    catch(...)
+    {
+      // readPageAsync() may have pinned the page meanwhile, if so it finds the error in waitPage()
+      lock.lock();
+      bufDescTable[frameNo].pinCnt--;
+      bufDescTable[frameNo].ioState = IO_NONE;
+      if (bufDescTable[frameNo].pinCnt > 0)
+        bufDescTable[frameNo].ioError = std::current_exception();
+      else
+        dropFailedFrame(shard, frameNo);
+      shard.ioDone.notify_all();
+      throw;
+    }
 
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+    lock.lock();
+    bufStats.diskreads++;
+    bufDescTable[frameNo].present = present;
+    bufDescTable[frameNo].ioState = IO_NONE;
+    shard.ioDone.notify_all();
+    return;
   }
 }
 
@@ -154,97 +565,1577 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 void BufMgr::unPinPage(File* file, const PageId pageNo, 
 			     const bool dirty) 
 {
+  if (sharedPool != NULL)
+    return sharedPool->unPinPage(file, pageNo, dirty);
+
+  PageId block = blockOf(pageNo);
+  BufShard& shard = shardOf(file, block);
+  std::lock_guard<std::mutex> lock(shard.latch);
+
   // lookup in hashtable
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  if (!shard.hashTable->tryLookup(file, block, frameNo))
+  	throw HashNotFoundException(file->filename(), pageNo);
+
+  unPinFrame(shard, frameNo, dirty);
+}
 
-  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+void BufMgr::unPinFrame(BufShard & shard, const FrameId frameNo, const bool dirty)
+{
+  BufDesc& desc = bufDescTable[frameNo];
+  if (dirty == true) desc.dirty = dirty;
 
   // make sure the page is actually pinned
-  if (bufDescTable[frameNo].pinCnt == 0)
+  if (desc.pinCnt == 0)
+  {
+  	throw PageNotPinnedException(desc.file->filename(), desc.pageNo, frameNo);
+  }
+  else desc.pinCnt--;
+
+  if (desc.ioError && desc.pinCnt == 0)
+    dropFailedFrame(shard, frameNo);
+
+  // a borrowed frame goes back as soon as its page can be dropped without a write
+  else if (desc.lentTo != BufDesc::NOT_LENT && desc.pinCnt == 0 && !desc.dirty && desc.ioState == IO_NONE)
   {
-  	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+    shard.metricsOf(desc.metricsId).evictions++;
+    shard.hashTable->tryRemove(desc.file, desc.pageNo);
+    if (framePages == 1)
+      secondTier.put(desc.file, desc.pageNo, bufPool[frameNo]);
+    freeFrame(shard, frameNo);
   }
-  else bufDescTable[frameNo].pinCnt--;
+
+  // resize() may be waiting to empty the frame
+  if (!inPolicy(shard, frameNo))
+    shard.ioDone.notify_all();
 }
 
-void BufMgr::flushFile(const File* file) 
+PageHandle BufMgr::readPage(File* file, const PageId pageNo)
 {
-  for (std::uint32_t i = 0; i < numBufs; i++)
-	{
-  	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->valid == true && tmpbuf->file == file)
-		{
-	    if (tmpbuf->pinCnt > 0)
-  			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
-
-	    if (tmpbuf->dirty == true)
-			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
-    	}
-
-    	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
-  	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
-  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+  Page* page;
+  readPage(file, pageNo, page);
+  return PageHandle(this, pageNo, (FrameId) ((page - bufPool) / framePages), page);
+}
+
+void BufMgr::readPageAsync(File* file, const PageId pageNo, Page*& page)
+{
+  // a shared pool has no engine to read in the background, the page is read here
+  if (sharedPool != NULL)
+    return sharedPool->readPage(file, pageNo, page);
+
+  PageId aheadFirst;
+  std::uint32_t aheadCount;
+  if (noteAccess(file, pageNo, aheadFirst, aheadCount))
+    prefetch(file, aheadFirst, aheadCount);
+
+  PageId block = blockOf(pageNo);
+  std::uint64_t key = BufHashTbl::hashKey(file, block);
+  BufShard& shard = shardOf(file, block);
+  std::unique_lock<std::mutex> lock(shard.latch);
+  bufStats.accesses++;
+
+  FrameId frameNo = 0;
+  while (true)
+  {
+    if (shard.hashTable->tryLookup(file, block, frameNo))
+    {
+      // a page being read can be pinned right away, one being written back is about to leave its frame
+      if (bufDescTable[frameNo].ioState == IO_WRITE)
+      {
+        shard.metricsOf(bufDescTable[frameNo].metricsId).pinWaits++;
+        shard.ioDone.wait(lock);
+        continue;
+      }
+      if (bufDescTable[frameNo].ioError)
+        std::rethrow_exception(bufDescTable[frameNo].ioError);
+
+      shard.metricsOf(bufDescTable[frameNo].metricsId).hits++;
+      bufDescTable[frameNo].refbit = true;
+      bufDescTable[frameNo].pinCnt++;
+      pageHit(shard, frameNo);
+      page = frameData(frameNo) + (pageNo - block);
+      return;
+    }
+
+    if (!claimFrame(shard, lock, file, block, key, frameNo))
+      continue;
+    shard.metricsOf(bufDescTable[frameNo].metricsId).misses++;
+    lock.unlock();
+
+    page = frameData(frameNo) + (pageNo - block);
+    if (framePages == 1 && readFromSecondTier(file, pageNo, frameNo))
+      return;
+
+    submitReads(file, block, frameNo);
+    return;
   }
 }
 
-void BufMgr::disposePage(File* file, const PageId pageNo) 
+void BufMgr::waitPage(File* file, const PageId pageNo)
 {
-	//Deallocate from file altogether
-  //See if it is in the buffer pool
+  if (sharedPool != NULL)
+  {
+    if (!sharedPool->contains(file, pageNo))
+      throw HashNotFoundException(file->filename(), pageNo);
+    return;
+  }
+
+  PageId block = blockOf(pageNo);
+  BufShard& shard = shardOf(file, block);
+  std::unique_lock<std::mutex> lock(shard.latch);
+
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  while (true)
+  {
+    if (!shard.hashTable->tryLookup(file, block, frameNo))
+      throw HashNotFoundException(file->filename(), pageNo);
 
-	// clear the page
-	bufDescTable[frameNo].Clear();
+    BufDesc& desc = bufDescTable[frameNo];
+    if (desc.ioState == IO_READ)
+    {
+      shard.ioDone.wait(lock);
+      continue;
+    }
 
-	hashTable->remove(file, pageNo);
+    // the read failed, give up the pin readPageAsync took
+    if (desc.ioError)
+    {
+      std::exception_ptr error = desc.ioError;
+      if (desc.pinCnt > 0)
+        desc.pinCnt--;
+      if (desc.pinCnt == 0)
+        dropFailedFrame(shard, frameNo);
+      std::rethrow_exception(error);
+    }
 
-  // deallocate it in the file	
-  file->deletePage(pageNo);
+    // the reads of a block leave out pages that failed, this one is read again to find out why
+    if (!hasPage(desc, pageNo))
+    {
+      try
+      {
+        fillPage(shard, lock, frameNo, pageNo);
+      }
+      catch(...)
+      {
+        if (desc.pinCnt > 0)
+          desc.pinCnt--;
+        if (desc.pinCnt == 0 && desc.present == 0)
+          dropFailedFrame(shard, frameNo);
+        throw;
+      }
+    }
+    return;
+  }
 }
 
+void BufMgr::prefetch(File* file, const PageId pageNo, const std::uint32_t count)
+{
+  if (sharedPool != NULL)
+    return;
 
-void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+  for (PageId p = pageNo; p < pageNo + count; p++)
+  {
+    if (!prefetchPage(file, p, false))
+      return;
+  }
+}
+
+bool BufMgr::prefetchPage(File* file, const PageId pageNo, const bool emptyOnly)
 {
   FrameId frameNo;
+  bool claimed;
+  if (!claimPrefetch(file, pageNo, emptyOnly, frameNo, claimed))
+    return false;
+  if (!claimed)
+    return true;
+
+  if (framePages == 1 && readFromSecondTier(file, pageNo, frameNo))
+    return true;
+  submitReads(file, blockOf(pageNo), frameNo);
+  return true;
+}
 
-  // alloc a new frame
-  allocBuf(frameNo);
+bool BufMgr::claimPrefetch(File* file, const PageId pageNo, const bool emptyOnly, FrameId & frameNo,
+                           bool & claimed)
+{
+  PageId block = blockOf(pageNo);
+  std::uint64_t key = BufHashTbl::hashKey(file, block);
+  BufShard& shard = shardOf(file, block);
+  std::unique_lock<std::mutex> lock(shard.latch);
 
-  // allocate a new page in the file
-	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
-  page = &bufPool[frameNo];
+  claimed = false;
+  if (shard.hashTable->tryLookup(file, block, frameNo))
+    return true;
+  if (emptyOnly && shard.numFree == 0)
+    return false;
 
-  // set up the entry properly
-  bufDescTable[frameNo].Set(file, pageNo);
+  try
+  {
+    if (!claimFrame(shard, lock, file, block, key, frameNo, true))
+      return true;
+  }
+  catch(BufferExceededException e)
+  {
+    // no room to read ahead without writing pages back
+    return false;
+  }
+  bufDescTable[frameNo].pinCnt = 0;
+  bufDescTable[frameNo].prefetched = true;
+  lock.unlock();
 
-  // insert in the hash table
-  hashTable->insert(file, pageNo, frameNo);
+  bufStats.prefetches++;
+  claimed = true;
+  return true;
 }
 
-void BufMgr::printSelf(void) 
+void BufMgr::submitReads(File* file, const PageId block, const FrameId frameNo)
 {
-  BufDesc* tmpbuf;
-	int validFrames = 0;
-  
-  for (std::uint32_t i = 0; i < numBufs; i++)
-	{
-  	tmpbuf = &(bufDescTable[i]);
-		std::cout << "FrameNo:" << i << " ";
-		tmpbuf->Print();
+  Page* data = frameData(frameNo);
+  for (std::uint32_t i = 0; i < framePages; i++)
+  {
+    IORequest request = { file, block + i, data + i, frameNo };
+    ioEngine->submit(request);
+  }
+}
 
-  	if (tmpbuf->valid == true)
-    	validFrames++;
+bool BufMgr::readFromSecondTier(const File* file, const PageId pageNo, const FrameId frameNo)
+{
+  if (!secondTier.take(file, pageNo, bufPool[frameNo]))
+    return false;
+
+  BufShard& shard = shardOfFrame(frameNo);
+  std::lock_guard<std::mutex> lock(shard.latch);
+  bufStats.secondTierHits++;
+  bufDescTable[frameNo].ioState = IO_NONE;
+  shard.ioDone.notify_all();
+  return true;
+}
+
+std::uint64_t BufMgr::readBlock(File* file, const PageId pageNo, const FrameId frameNo)
+{
+  // the whole block with one positional read, short at the end of the file. It needs no latch, unlike the file's
+  // stream
+  PageId block = blockOf(pageNo);
+  char* buffer = reinterpret_cast<char*>(frameData(frameNo));
+  long long offset = File::pageOffset(block);
+  long total = (long) getFrameSize();
+  long done = 0;
+  while (done < total)
+  {
+    ssize_t n = pread(file->descriptor(), buffer + done, total - done, offset + done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    done += n;
   }
 
-	std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
+  std::uint64_t present = 0;
+  for (std::uint32_t i = 0; i < framePages; i++)
+  {
+    long bytesRead = done - (long) (i * Page::SIZE);
+    bytesRead = bytesRead < 0 ? 0 : (bytesRead > (long) Page::SIZE ? (long) Page::SIZE : bytesRead);
+    try
+    {
+      file->checkPage(block + i, frameData(frameNo)[i], bytesRead);
+      present |= (std::uint64_t) 1 << i;
+    }
+    catch(...)
+    {
+      // not in use, or past the end of the file
+    }
+  }
+
+  // the page wanted must be there, reading it alone throws the file's own error if it is not
+  if ((present >> (pageNo - block) & 1) == 0)
+  {
+    std::lock_guard<std::mutex> ioLock(file->streamLatch());
+    file->readPage(pageNo, frameData(frameNo)[pageNo - block]);
+    present |= (std::uint64_t) 1 << (pageNo - block);
+  }
+  return present;
+}
+
+void BufMgr::fillPage(BufShard & shard, std::unique_lock<std::mutex> & lock, const FrameId frameNo,
+                      const PageId pageNo)
+{
+  BufDesc& desc = bufDescTable[frameNo];
+  while (desc.ioState != IO_NONE)
+    shard.ioDone.wait(lock);
+  if (hasPage(desc, pageNo))
+    return;
+
+  desc.ioState = IO_READ;
+  lock.unlock();
+  try
+  {
+    std::lock_guard<std::mutex> ioLock(desc.file->streamLatch());
+    desc.file->readPage(pageNo, frameData(frameNo)[pageNo - desc.pageNo]);
+  }
+  catch(...)
+  {
+    lock.lock();
+    desc.ioState = IO_NONE;
+    shard.ioDone.notify_all();
+    throw;
+  }
+  lock.lock();
+  bufStats.diskreads++;
+  desc.present |= (std::uint64_t) 1 << (pageNo - desc.pageNo);
+  desc.ioState = IO_NONE;
+  shard.ioDone.notify_all();
+}
+
+bool BufMgr::noteAccess(const File* file, const PageId pageNo, PageId & first, std::uint32_t & count)
+{
+  if (!readAheadOn)
+    return false;
+
+  std::lock_guard<std::mutex> lock(readAheadLatch);
+  if (readAheadMax < READ_AHEAD_MIN)
+    return false;
+  ReadAheadState& state = readAhead[file];
+
+  // the same page again neither extends nor breaks a run
+  if (pageNo == state.lastPage)
+    return false;
+
+  if (pageNo == state.lastPage + 1)
+    state.run++;
+  else
+  {
+    state.run = 0;
+    state.window /= 2;
+    if (state.window < READ_AHEAD_MIN)
+      state.window = 0;
+    state.nextPage = 0;
+    state.lastOnDisk = Page::INVALID_NUMBER;
+  }
+  state.lastPage = pageNo;
+
+  // wait for a run, then until the reader is halfway through the window read last
+  if (state.run < SEQUENTIAL_RUN || state.nextPage > pageNo + state.window / 2)
+    return false;
+
+  state.window = state.window == 0 ? READ_AHEAD_MIN : std::min(state.window * 2, readAheadMax);
+  first = std::max(state.nextPage, pageNo + 1);
+  state.nextPage = pageNo + 1 + state.window;
+
+  // pages past the end would be allocated rather than read, and an append may be about to. The size is taken once
+  // a run, pages appended during it are the ones not to read ahead anyway
+  if (state.lastOnDisk == Page::INVALID_NUMBER)
+  {
+    struct stat st;
+    state.lastOnDisk = fstat(file->descriptor(), &st) == 0 && st.st_size > File::pageOffset(1) ?
+      (PageId) ((st.st_size - File::pageOffset(1)) / Page::SIZE) : 0;
+  }
+  if (state.nextPage > state.lastOnDisk + 1)
+    state.nextPage = std::max(state.lastOnDisk + 1, first);
+  count = state.nextPage - first;
+  return count > 0;
+}
+
+void BufMgr::fileClosed(const File* file, void* mgr)
+{
+  BufMgr* self = static_cast<BufMgr*>(mgr);
+  if (self->sharedPool != NULL)
+    return self->sharedPool->fileClosed(file);
+  {
+    std::lock_guard<std::mutex> lock(self->readAheadLatch);
+    self->readAhead.erase(file);
+  }
+  self->forgetMetricsId(file);
+
+  // the I/O engine uses the File until a read of one of its pages is done
+  std::vector<FrameId> resident;
+  {
+    std::lock_guard<std::mutex> lock(self->fileListLatch);
+    std::unordered_map<const File*, FrameId>::iterator head = self->fileFrames.find(file);
+    if (head != self->fileFrames.end())
+    {
+      for (FrameId i = head->second; i != NO_FRAME; i = self->bufDescTable[i].fileNext)
+        resident.push_back(i);
+    }
+  }
+  for (std::size_t n = 0; n < resident.size(); n++)
+  {
+    std::unique_lock<std::mutex> lock;
+    BufShard& shard = self->lockShardOfFrame(resident[n], lock);
+    const BufDesc& desc = self->bufDescTable[resident[n]];
+    while (desc.ioState == IO_READ && desc.file == file)
+      shard.ioDone.wait(lock);
+  }
+}
+
+void BufMgr::readDone(const IORequest& request, std::exception_ptr error)
+{
+  FrameId frameNo = request.tag;
+  BufShard& shard = shardOfFrame(frameNo);
+  std::lock_guard<std::mutex> lock(shard.latch);
+  BufDesc& desc = bufDescTable[frameNo];
+
+  // the pages of a block are read one by one, and one that fails is just left out. The block is readable once
+  // the last read is in, and is dropped then only if none of its pages exist
+  if (framePages > 1)
+  {
+    if (!error)
+    {
+      bufStats.diskreads++;
+      desc.present |= (std::uint64_t) 1 << (request.pageNo - desc.pageNo);
+    }
+    if (--desc.pendingReads > 0)
+      return;
+    desc.ioState = IO_NONE;
+    if (desc.present == 0 && desc.pinCnt == 0)
+      dropFailedFrame(shard, frameNo);
+    shard.ioDone.notify_all();
+    return;
+  }
+
+  desc.ioState = IO_NONE;
+  if (!error)
+    bufStats.diskreads++;
+  else if (desc.pinCnt > 0)
+    desc.ioError = error;
+  else
+    dropFailedFrame(shard, frameNo);
+  shard.ioDone.notify_all();
+}
+
+void BufMgr::dropFailedFrame(BufShard & shard, const FrameId frameNo)
+{
+  shard.hashTable->tryRemove(bufDescTable[frameNo].file, bufDescTable[frameNo].pageNo);
+  pageRemoved(shard, frameNo);
+  freeFrame(shard, frameNo);
+  shard.ioDone.notify_all();
+}
+
+void BufMgr::linkFrame(const FrameId frameNo)
+{
+  std::lock_guard<std::mutex> lock(fileListLatch);
+  BufDesc& desc = bufDescTable[frameNo];
+  std::unordered_map<const File*, FrameId>::iterator head = fileFrames.find(desc.file);
+
+  desc.filePrev = NO_FRAME;
+  if (head == fileFrames.end())
+  {
+    desc.fileNext = NO_FRAME;
+    fileFrames[desc.file] = frameNo;
+  }
+  else
+  {
+    desc.fileNext = head->second;
+    bufDescTable[head->second].filePrev = frameNo;
+    head->second = frameNo;
+  }
+}
+
+void BufMgr::unlinkFrame(const FrameId frameNo)
+{
+  std::lock_guard<std::mutex> lock(fileListLatch);
+  BufDesc& desc = bufDescTable[frameNo];
+
+  if (desc.fileNext != NO_FRAME)
+    bufDescTable[desc.fileNext].filePrev = desc.filePrev;
+  if (desc.filePrev != NO_FRAME)
+    bufDescTable[desc.filePrev].fileNext = desc.fileNext;
+  else if (desc.fileNext != NO_FRAME)
+    fileFrames[desc.file] = desc.fileNext;
+  else
+    fileFrames.erase(desc.file);
+
+  desc.filePrev = desc.fileNext = NO_FRAME;
+}
+
+void BufMgr::flushFile(const File* file) 
+{
+  if (sharedPool != NULL)
+    return sharedPool->flushFile(file);
+  dropFile(file, true);
+}
+
+void BufMgr::discardFile(const File* file) 
+{
+  if (sharedPool != NULL)
+    return sharedPool->discardFile(file);
+  dropFile(file, false);
+}
+
+void BufMgr::dropFile(const File* file, const bool write) 
+{
+  {
+    std::lock_guard<std::mutex> lock(readAheadLatch);
+    readAhead.erase(file);
+  }
+
+  // the frames holding the file's pages now
+  std::vector<FrameId> resident;
+  {
+    std::lock_guard<std::mutex> lock(fileListLatch);
+    std::unordered_map<const File*, FrameId>::iterator head = fileFrames.find(file);
+    if (head != fileFrames.end())
+    {
+      for (FrameId i = head->second; i != NO_FRAME; i = bufDescTable[i].fileNext)
+        resident.push_back(i);
+    }
+  }
+
+  // mark every frame of the file IO_WRITE, so that nothing pins or evicts them while they are written
+  std::vector<FrameId> frames;
+  std::vector<FrameId> dirtyFrames;
+  try
+  {
+    for (std::size_t n = 0; n < resident.size(); n++)
+    {
+      FrameId i = resident[n];
+      std::unique_lock<std::mutex> lock;
+      BufShard& shard = lockShardOfFrame(i, lock);
+      BufDesc* tmpbuf = &(bufDescTable[i]);
+
+      // let any read or write back in progress on the frame finish first
+      while (tmpbuf->ioState != IO_NONE && tmpbuf->file == file)
+        shard.ioDone.wait(lock);
+
+      if(tmpbuf->valid == true && tmpbuf->file == file)
+      {
+        if (tmpbuf->pinCnt > 0)
+          throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+
+        tmpbuf->ioState = IO_WRITE;
+        frames.push_back(i);
+        if (write && tmpbuf->dirty == true)
+          dirtyFrames.push_back(i);
+      }
+      else if (tmpbuf->valid == false && tmpbuf->file == file)
+        throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+    }
+
+    writeFrames(dirtyFrames);
+  }
+  catch(...)
+  {
+    // leave the frames as they were
+    for (std::size_t n = 0; n < frames.size(); n++)
+    {
+      BufShard& shard = shardOfFrame(frames[n]);
+      std::lock_guard<std::mutex> lock(shard.latch);
+      bufDescTable[frames[n]].ioState = IO_NONE;
+      shard.ioDone.notify_all();
+    }
+    throw;
+  }
+
+  // drop the file's pages from the pool
+  for (std::size_t n = 0; n < frames.size(); n++)
+  {
+    FrameId i = frames[n];
+    BufShard& shard = shardOfFrame(i);
+    std::lock_guard<std::mutex> lock(shard.latch);
+    shard.hashTable->tryRemove(file, bufDescTable[i].pageNo);
+    pageRemoved(shard, i);
+    freeFrame(shard, i);
+    shard.ioDone.notify_all();
+  }
+  secondTier.dropFile(file);
+
+  // the File may be deleted next, its counters stay under its name
+  forgetMetricsId(file);
+}
+
+std::uint32_t BufMgr::metricsIdOf(const File* file)
+{
+  std::lock_guard<std::mutex> lock(metricsLatch);
+  std::unordered_map<const File*, std::uint32_t>::iterator it = metricsIds.find(file);
+  if (it != metricsIds.end())
+    return it->second;
+
+  // the name is only looked at the first time a File misses
+  std::unordered_map<std::string, std::uint32_t>::iterator named = metricsNameIds.find(file->filename());
+  if (named == metricsNameIds.end())
+  {
+    named = metricsNameIds.insert(std::make_pair(file->filename(), (std::uint32_t) metricsNames.size())).first;
+    metricsNames.push_back(file->filename());
+  }
+  metricsIds[file] = named->second;
+  return named->second;
+}
+
+void BufMgr::forgetMetricsId(const File* file)
+{
+  std::lock_guard<std::mutex> lock(metricsLatch);
+  metricsIds.erase(file);
+}
+
+void BufMgr::writeFrame(const FrameId frameNo)
+{
+  const BufDesc& desc = bufDescTable[frameNo];
+  std::uint64_t present = presentPages(desc);
+  std::vector<const Page*> run;
+  for (std::uint32_t i = 0; i < framePages; i += run.size() + 1)
+  {
+    // the run of pages the frame holds starting here, skipping those it does not
+    run.clear();
+    while (i + run.size() < framePages && (present >> (i + run.size()) & 1))
+      run.push_back(frameData(frameNo) + i + run.size());
+    if (run.empty())
+      continue;
+
+    std::chrono::steady_clock::time_point began = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> ioLock(desc.file->streamLatch());
+    desc.file->writePages(desc.pageNo + i, &run[0], run.size());
+    bufStats.writeLatency.record(elapsedNanos(began));
+    bufStats.diskwrites += run.size();
+  }
+}
+
+void BufMgr::writeFrames(std::vector<FrameId> & frames)
+{
+  // every page the frames hold, a block of them for frames of several pages
+  struct FramePage
+  {
+    File* file;
+    PageId pageNo;
+    const Page* page;
+  };
+  std::vector<FramePage> pages;
+  for (std::size_t n = 0; n < frames.size(); n++)
+  {
+    const BufDesc& desc = bufDescTable[frames[n]];
+    std::uint64_t present = presentPages(desc);
+    for (std::uint32_t i = 0; i < framePages; i++)
+    {
+      if (present >> i & 1)
+      {
+        FramePage page = { desc.file, desc.pageNo + i, frameData(frames[n]) + i };
+        pages.push_back(page);
+      }
+    }
+  }
+
+  std::sort(pages.begin(), pages.end(), [](const FramePage& a, const FramePage& b) {
+    if (a.file != b.file)
+      return a.file < b.file;
+    return a.pageNo < b.pageNo;
+  });
+
+  std::vector<const Page*> run;
+  for (std::size_t start = 0; start < pages.size(); start += run.size())
+  {
+    // gather the run of consecutive pages of one file starting here
+    const FramePage& first = pages[start];
+    run.clear();
+    while (start + run.size() < pages.size())
+    {
+      const FramePage& next = pages[start + run.size()];
+      if (next.file != first.file || next.pageNo != first.pageNo + run.size())
+        break;
+      run.push_back(next.page);
+    }
+
+    std::chrono::steady_clock::time_point began = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> ioLock(first.file->streamLatch());
+    first.file->writePages(first.pageNo, &run[0], run.size());
+    bufStats.writeLatency.record(elapsedNanos(began));
+    bufStats.diskwrites += run.size();
+  }
+
+  for (std::size_t n = 0; n < frames.size(); n++)
+    bufDescTable[frames[n]].dirty = false;
+}
+
+void BufMgr::startBackgroundWriter(const std::uint32_t cleanPercent, const std::uint32_t intervalMs)
+{
+  if (writerThread.joinable() || sharedPool != NULL)
+    return;
+
+  writerStop = false;
+  writerCleanPercent = cleanPercent;
+  writerIntervalMs = intervalMs;
+  writerThread = std::thread(&BufMgr::backgroundWriter, this);
+}
+
+void BufMgr::stopBackgroundWriter()
+{
+  if (!writerThread.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(writerLatch);
+    writerStop = true;
+  }
+  writerWake.notify_one();
+  writerThread.join();
+}
+
+void BufMgr::backgroundWriter()
+{
+  std::unique_lock<std::mutex> lock(writerLatch);
+  while (!writerStop)
+  {
+    writerWake.wait_for(lock, std::chrono::milliseconds(writerIntervalMs));
+    if (writerStop)
+      break;
+
+    lock.unlock();
+    try
+    {
+      writeDirtyFrames();
+      fillReadyQueues();
+    }
+    catch(...)
+    {
+      // the pages stay dirty and eviction writes them itself
+    }
+    lock.lock();
+  }
+}
+
+void BufMgr::fillReadyQueues()
+{
+  for (std::uint32_t s = 0; s < numShards; s++)
+  {
+    BufShard& shard = shards[s];
+    std::lock_guard<std::mutex> lock(shard.latch);
+
+    // empty frames come first anyway, and a small shard keeps most of its pages with the policy
+    std::uint32_t wanted = shard.numFrames / 8 < READY_QUEUE_SIZE ? shard.numFrames / 8 : READY_QUEUE_SIZE;
+    CleanEvictionCheck clean(shard);
+    std::uint32_t slot;
+    while (shard.readySlots.size() + shard.numFree < wanted && shard.policy->pickVictim(clean, 0, slot))
+    {
+      shard.readySlots.push_back(slot);
+      bufDescTable[frameOf(shard, slot)].ready = true;
+    }
+  }
+}
+
+void BufMgr::takeOffReadyQueue(BufShard & shard, const FrameId frameNo)
+{
+  std::vector<std::uint32_t>::iterator it = std::find(shard.readySlots.begin(), shard.readySlots.end(),
+                                                      slotOf(frameNo));
+  if (it != shard.readySlots.end())
+    shard.readySlots.erase(it);
+  bufDescTable[frameNo].ready = false;
+}
+
+void BufMgr::writeDirtyFrames()
+{
+  struct DirtyPage
+  {
+    File* file;
+    PageId pageNo;
+    FrameId frameNo;
+    std::size_t copy;
+  };
+  std::vector<DirtyPage> picked;
+  std::vector<Page> copies;
+  std::vector<FrameId> frames;
+
+  for (std::uint32_t s = 0; s < numShards; s++)
+  {
+    BufShard& shard = shards[s];
+    std::lock_guard<std::mutex> lock(shard.latch);
+
+    std::uint32_t lowWater = shard.numFrames * writerCleanPercent / 100;
+    std::uint32_t clean = shard.numFree;
+    for (std::uint32_t slot = 0; slot < shard.numFrames && clean < lowWater; slot++)
+    {
+      const BufDesc& desc = bufDescTable[frameOf(shard, slot)];
+      if (desc.lentTo == BufDesc::NOT_LENT && desc.valid && !desc.dirty && desc.pinCnt == 0 && desc.ioState == IO_NONE)
+        clean++;
+    }
+
+    // continue round the shard from where the last round stopped, copying pages out under the latch
+    for (std::uint32_t n = 0; n < shard.numFrames && clean < lowWater; n++)
+    {
+      FrameId frameNo = frameOf(shard, shard.writerHand);
+      shard.writerHand = (shard.writerHand + 1) % shard.numFrames;
+
+      // frames lent to another shard are looked after by that shard
+      BufDesc& desc = bufDescTable[frameNo];
+      if (desc.lentTo == BufDesc::NOT_LENT && desc.valid && desc.dirty && desc.pinCnt == 0 &&
+          desc.ioState == IO_NONE)
+      {
+        std::uint64_t present = presentPages(desc);
+        for (std::uint32_t i = 0; i < framePages; i++)
+        {
+          if (present >> i & 1)
+          {
+            DirtyPage page = { desc.file, desc.pageNo + i, frameNo, copies.size() };
+            picked.push_back(page);
+            copies.push_back(frameData(frameNo)[i]);
+          }
+        }
+        frames.push_back(frameNo);
+        desc.dirty = false;
+        desc.ioState = IO_FLUSH;
+        clean++;
+      }
+    }
+  }
+
+  std::sort(picked.begin(), picked.end(), [](const DirtyPage& a, const DirtyPage& b) {
+    if (a.file != b.file)
+      return a.file < b.file;
+    return a.pageNo < b.pageNo;
+  });
+
+  // frames whose pages did not all make it to disk
+  std::unordered_set<FrameId> failed;
+  std::vector<const Page*> run;
+  for (std::size_t start = 0; start < picked.size(); start += run.size())
+  {
+    run.clear();
+    while (start + run.size() < picked.size() &&
+           picked[start + run.size()].file == picked[start].file &&
+           picked[start + run.size()].pageNo == picked[start].pageNo + run.size())
+      run.push_back(&copies[picked[start + run.size()].copy]);
+
+    try
+    {
+      std::chrono::steady_clock::time_point began = std::chrono::steady_clock::now();
+      std::lock_guard<std::mutex> ioLock(picked[start].file->streamLatch());
+      picked[start].file->writePages(picked[start].pageNo, &run[0], run.size());
+      bufStats.writeLatency.record(elapsedNanos(began));
+      bufStats.diskwrites += run.size();
+    }
+    catch(...)
+    {
+      for (std::size_t n = start; n < start + run.size(); n++)
+        failed.insert(picked[n].frameNo);
+    }
+  }
+
+  // frames may be evicted again once all their pages are written, still dirty if a write failed
+  for (std::size_t n = 0; n < frames.size(); n++)
+  {
+    BufShard& shard = shardOfFrame(frames[n]);
+    std::lock_guard<std::mutex> lock(shard.latch);
+    BufDesc& desc = bufDescTable[frames[n]];
+    if (failed.count(frames[n]) > 0)
+      desc.dirty = true;
+    desc.ioState = IO_NONE;
+    shard.ioDone.notify_all();
+  }
+}
+
+void BufMgr::disposePage(File* file, const PageId pageNo) 
+{
+  if (sharedPool != NULL)
+    return sharedPool->disposePage(file, pageNo);
+
+  PageId block = blockOf(pageNo);
+  BufShard& shard = shardOf(file, block);
+  std::unique_lock<std::mutex> lock(shard.latch);
+
+	//Deallocate from file altogether
+  //See if it is in the buffer pool
+  FrameId frameNo = 0;
+  while (shard.hashTable->tryLookup(file, block, frameNo))
+  {
+    if (bufDescTable[frameNo].ioState != IO_NONE)
+    {
+      shard.ioDone.wait(lock);
+      continue;
+    }
+
+    // the rest of a block stays in its frame, which is only freed once it holds nothing
+    if (framePages > 1)
+    {
+      bufDescTable[frameNo].present &= ~((std::uint64_t) 1 << (pageNo - block));
+      if (bufDescTable[frameNo].present != 0 || bufDescTable[frameNo].pinCnt > 0)
+        break;
+    }
+
+		// clear the page
+		shard.hashTable->tryRemove(file, block);
+		pageRemoved(shard, frameNo);
+		freeFrame(shard, frameNo);
+    break;
+  }
+  secondTier.erase(file, pageNo);
+
+  // deallocate it in the file	
+  std::lock_guard<std::mutex> ioLock(file->streamLatch());
+  file->deletePage(pageNo);
+}
+
+
+void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+{
+  if (sharedPool != NULL)
+    return sharedPool->allocPage(file, pageNo, page);
+
+  while (true)
+  {
+    // the page number picks the shard, so the frame is claimed for the number the file hands out next and the
+    // page is built right in it
+    PageId expected;
+    {
+      std::lock_guard<std::mutex> ioLock(file->streamLatch());
+      expected = file->nextPageNumber();
+    }
+
+    PageId block = blockOf(expected);
+    std::uint64_t key = BufHashTbl::hashKey(file, block);
+    BufShard& shard = shardOf(file, block);
+    std::unique_lock<std::mutex> lock(shard.latch);
+    bufStats.accesses++;
+
+    // with frames of several pages the block may be in already, holding the pages before this one. Either way a
+    // read ahead past the end of the file may have claimed a frame for the page before it existed; once that read
+    // is over the frame is taken for the new page, whatever the read left in it
+    FrameId frameNo;
+    bool claimed = false;
+    if (shard.hashTable->tryLookup(file, block, frameNo))
+    {
+      BufDesc& desc = bufDescTable[frameNo];
+      if (desc.ioState == IO_READ || desc.ioState == IO_WRITE)
+      {
+        shard.ioDone.wait(lock);
+        continue;
+      }
+      desc.refbit = true;
+      desc.pinCnt++;
+      desc.ioError = std::exception_ptr();
+      desc.present &= ~((std::uint64_t) 1 << (expected - block));
+      pageHit(shard, frameNo);
+    }
+    else
+    {
+      // alloc a new frame, nothing is allocated in the file yet
+      std::uint32_t fileId = metricsIdOf(file);
+      allocBuf(shard, lock, fileId, key, frameNo);
+
+      // the latch may have been dropped, the block may have been read in or read ahead meanwhile
+      if (!shard.hashTable->tryInsert(file, block, frameNo))
+      {
+        freeFrame(shard, frameNo);
+        continue;
+      }
+      bufDescTable[frameNo].Set(file, block);
+      bufDescTable[frameNo].metricsId = fileId;
+      linkFrame(frameNo);
+      pageLoaded(shard, frameNo, key);
+      claimed = true;
+    }
+
+    // readers of the block wait while the page is built without the latch
+    BufDesc& desc = bufDescTable[frameNo];
+    desc.ioState = IO_READ;
+    lock.unlock();
+
+    page = frameData(frameNo) + (expected - block);
+    bool allocated = false;
+    try
+    {
+      // another allocation may have taken the number meanwhile, then the frame is given up and the next one tried
+      std::lock_guard<std::mutex> ioLock(file->streamLatch());
+      if (file->nextPageNumber() == expected)
+      {
+        file->allocatePage(pageNo, *page);
+        allocated = true;
+      }
+    }
+    catch(...)
+    {
+      // readPageAsync() may have pinned the block meanwhile, if so it reads the page in like any missing one
+      lock.lock();
+      desc.ioState = IO_NONE;
+      desc.pinCnt--;
+      if (claimed && desc.pinCnt == 0)
+        dropFailedFrame(shard, frameNo);
+      shard.ioDone.notify_all();
+      throw;
+    }
+
+    lock.lock();
+    desc.ioState = IO_NONE;
+    if (!allocated)
+    {
+      desc.pinCnt--;
+      if (claimed && desc.pinCnt == 0)
+        dropFailedFrame(shard, frameNo);
+      shard.ioDone.notify_all();
+      continue;
+    }
+
+    // a page of the same number deleted earlier may have left a copy behind
+    secondTier.erase(file, pageNo);
+    desc.present |= (std::uint64_t) 1 << (pageNo - block);
+    shard.ioDone.notify_all();
+    return;
+  }
+}
+
+PageHandle BufMgr::allocPage(File* file, PageId &pageNo)
+{
+  Page* page;
+  allocPage(file, pageNo, page);
+  return PageHandle(this, pageNo, (FrameId) ((page - bufPool) / framePages), page);
+}
+
+/**
+ * Marks a hot page list, followed by its version
+ */
+static const std::uint32_t HOT_PAGES_MAGIC = 0x42484f54;
+static const std::uint32_t HOT_PAGES_VERSION = 1;
+
+static void writeU32(std::ofstream& out, const std::uint32_t value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static bool readU32(std::ifstream& in, std::uint32_t& value)
+{
+  return (bool) in.read(reinterpret_cast<char*>(&value), sizeof(value));
+}
+
+bool BufMgr::saveHotPages(const std::string& path)
+{
+  // the pages of a shared pool are not this process's to list
+  if (sharedPool != NULL)
+    return false;
+
+  // each shard's pages, hottest first. Victims already picked for reuse are the coldest
+  std::vector<std::vector<std::pair<const File*, PageId> > > ranked(numShards);
+  std::vector<std::uint32_t> slots;
+  for (std::uint32_t s = 0; s < numShards; s++)
+  {
+    BufShard& shard = shards[s];
+    std::lock_guard<std::mutex> lock(shard.latch);
+    slots.clear();
+    shard.policy->residentSlots(slots);
+    slots.insert(slots.end(), shard.readySlots.begin(), shard.readySlots.end());
+    for (std::size_t n = 0; n < slots.size(); n++)
+    {
+      const BufDesc& desc = bufDescTable[frameOf(shard, slots[n])];
+      if (desc.valid && desc.ioState != IO_READ)
+        ranked[s].push_back(std::make_pair(desc.file, desc.pageNo));
+    }
+  }
+
+  // the list as a whole goes by rank within a shard, shards taking turns. Files are written once, by number
+  std::vector<std::pair<std::uint32_t, PageId> > pages;
+  std::vector<std::string> names;
+  std::unordered_map<const File*, std::uint32_t> fileNumbers;
+  for (std::size_t rank = 0; ; rank++)
+  {
+    bool more = false;
+    for (std::uint32_t s = 0; s < numShards; s++)
+    {
+      if (rank >= ranked[s].size())
+        continue;
+      more = true;
+      const File* file = ranked[s][rank].first;
+      std::unordered_map<const File*, std::uint32_t>::iterator it = fileNumbers.find(file);
+      if (it == fileNumbers.end())
+      {
+        it = fileNumbers.insert(std::make_pair(file, (std::uint32_t) names.size())).first;
+        names.push_back(file->filename());
+      }
+      pages.push_back(std::make_pair(it->second, ranked[s][rank].second));
+    }
+    if (!more)
+      break;
+  }
+
+  std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream out(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+    writeU32(out, HOT_PAGES_MAGIC);
+    writeU32(out, HOT_PAGES_VERSION);
+    writeU32(out, (std::uint32_t) names.size());
+    for (std::size_t n = 0; n < names.size(); n++)
+    {
+      writeU32(out, (std::uint32_t) names[n].size());
+      out.write(names[n].data(), names[n].size());
+    }
+    writeU32(out, (std::uint32_t) pages.size());
+    for (std::size_t n = 0; n < pages.size(); n++)
+    {
+      writeU32(out, pages[n].first);
+      writeU32(out, pages[n].second);
+    }
+    out.flush();
+    if (!out)
+    {
+      out.close();
+      std::remove(tmpPath.c_str());
+      return false;
+    }
+  }
+  return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+bool BufMgr::startWarmUp(const std::string& path, const std::vector<File*>& files)
+{
+  if (sharedPool != NULL)
+    return false;
+
+  std::ifstream in(path.c_str(), std::ios::binary);
+  std::uint32_t magic, version, numNames, numPages;
+  if (!readU32(in, magic) || magic != HOT_PAGES_MAGIC || !readU32(in, version) || version != HOT_PAGES_VERSION ||
+      !readU32(in, numNames))
+    return false;
+
+  // the files of the list, NULL for those not open now
+  std::vector<File*> listed(numNames, (File*) NULL);
+  for (std::uint32_t n = 0; n < numNames; n++)
+  {
+    // no file name is anywhere near this long, the list is corrupt
+    std::uint32_t length;
+    if (!readU32(in, length) || length > 4096)
+      return false;
+    std::string name(length, '\0');
+    if (!in.read(&name[0], length))
+      return false;
+    for (std::size_t f = 0; f < files.size(); f++)
+    {
+      if (files[f]->filename() == name)
+        listed[n] = files[f];
+    }
+  }
+
+  // the blocks of the hottest pages that fit in the shards they belong to
+  if (!readU32(in, numPages))
+    return false;
+  std::vector<std::pair<File*, PageId> > pages;
+  std::vector<std::uint32_t> shardPages(numShards, 0);
+  std::unordered_set<std::uint64_t> blocks;
+  for (std::uint32_t n = 0; n < numPages; n++)
+  {
+    std::uint32_t fileNo, pageNo;
+    if (!readU32(in, fileNo) || !readU32(in, pageNo) || fileNo >= numNames)
+      return false;
+    if (listed[fileNo] == NULL)
+      continue;
+    PageId block = blockOf(pageNo);
+    if (!blocks.insert((std::uint64_t) fileNo << 32 | block).second)
+      continue;
+    BufShard& shard = shardOf(listed[fileNo], block);
+    if (shardPages[shard.index] < shard.numFrames)
+    {
+      shardPages[shard.index]++;
+      pages.push_back(std::make_pair(listed[fileNo], block));
+    }
+  }
+
+  stopWarmUp();
+  warmUpStop = false;
+  warmUpThread = std::thread(&BufMgr::warmUpPages, this, pages);
+  return true;
+}
+
+void BufMgr::waitForWarmUp()
+{
+  if (warmUpThread.joinable())
+    warmUpThread.join();
+}
+
+void BufMgr::stopWarmUp()
+{
+  warmUpStop = true;
+  waitForWarmUp();
+}
+
+void BufMgr::warmUpPages(std::vector<std::pair<File*, PageId> > pages)
+{
+  // the list holds blocks, each once. Sorted, the blocks next to each other in a file come one after the other
+  std::sort(pages.begin(), pages.end());
+  std::vector<FrameId> run;
+  File* runFile = NULL;
+  PageId runFirst = 0;
+  for (std::size_t n = 0; n < pages.size() && !warmUpStop; n++)
+  {
+    File* file = pages[n].first;
+    PageId block = pages[n].second;
+    bool adjacent = file == runFile && block == runFirst + run.size() * framePages;
+    if (!run.empty() && (!adjacent || run.size() == WARM_UP_RUN))
+    {
+      readRun(runFile, runFirst, run);
+      run.clear();
+    }
+
+    // a shard that filled up meanwhile holds pages queries wanted, worth more than the rest of the list. A block
+    // left out, or found in the pool, ends the run since the next one is not adjacent to it
+    FrameId frameNo;
+    bool claimed;
+    if (!claimPrefetch(file, block, true, frameNo, claimed) || !claimed)
+      continue;
+    if (framePages == 1 && readFromSecondTier(file, block, frameNo))
+      continue;
+    if (run.empty())
+    {
+      runFile = file;
+      runFirst = block;
+    }
+    run.push_back(frameNo);
+  }
+
+  // stopping early still owes the frames claimed their read
+  if (!run.empty())
+    readRun(runFile, runFirst, run);
+}
+
+void BufMgr::readRun(File* file, const PageId first, const std::vector<FrameId>& frames)
+{
+  // one positional read scattered over the frames, short at the end of the file
+  long frameSize = (long) getFrameSize();
+  long total = frameSize * (long) frames.size();
+  long done = 0;
+  std::vector<struct iovec> buffers;
+  while (done < total)
+  {
+    buffers.clear();
+    for (std::size_t i = done / frameSize; i < frames.size(); i++)
+    {
+      long skip = i == (std::size_t) (done / frameSize) ? done % frameSize : 0;
+      struct iovec buffer = { reinterpret_cast<char*>(frameData(frames[i])) + skip,
+                              (std::size_t) (frameSize - skip) };
+      buffers.push_back(buffer);
+    }
+    ssize_t n = preadv(file->descriptor(), &buffers[0], (int) buffers.size(), File::pageOffset(first) + done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    done += n;
+  }
+
+  for (std::size_t i = 0; i < frames.size(); i++)
+  {
+    PageId block = first + (PageId) i * framePages;
+    std::uint64_t present = 0;
+    std::exception_ptr error;
+    for (std::uint32_t p = 0; p < framePages; p++)
+    {
+      long bytesRead = done - (long) (i * frameSize + p * Page::SIZE);
+      bytesRead = bytesRead < 0 ? 0 : (bytesRead > (long) Page::SIZE ? (long) Page::SIZE : bytesRead);
+      try
+      {
+        file->checkPage(block + p, frameData(frames[i])[p], bytesRead);
+        present |= (std::uint64_t) 1 << p;
+      }
+      catch(...)
+      {
+        error = std::current_exception();
+      }
+    }
+
+    // completed as readDone() completes the reads of the I/O engine
+    std::unique_lock<std::mutex> lock;
+    BufShard& shard = lockShardOfFrame(frames[i], lock);
+    BufDesc& desc = bufDescTable[frames[i]];
+    desc.ioState = IO_NONE;
+    if (present != 0)
+      bufStats.diskreads++;
+    if (framePages > 1)
+      desc.present = present;
+    if (present == 0 && desc.pinCnt == 0)
+      dropFailedFrame(shard, frames[i]);
+    else if (present == 0 && framePages == 1)
+      desc.ioError = error;
+    shard.ioDone.notify_all();
+  }
+}
+
+std::uint32_t BufMgr::resize(const std::uint32_t bufs)
+{
+  if (sharedPool != NULL)
+    return numBufs;
+
+  std::lock_guard<std::mutex> resizeLock(resizeLatch);
+  std::uint32_t oldBufs = numBufs;
+  std::uint32_t newBufs = bufs < numShards ? numShards : (bufs > maxBufs ? maxBufs : bufs);
+
+  if (newBufs > oldBufs)
+  {
+    for (std::uint32_t i = 0; i < numShards; i++)
+    {
+      std::lock_guard<std::mutex> lock(shards[i].latch);
+      growShard(shards[i], framesOfShard(i, newBufs));
+    }
+  }
+  else if (newBufs < oldBufs)
+  {
+    std::uint32_t i = 0;
+    try
+    {
+      for (; i < numShards; i++)
+      {
+        std::unique_lock<std::mutex> lock(shards[i].latch);
+        shrinkShard(shards[i], lock, framesOfShard(i, newBufs));
+      }
+    }
+    catch(...)
+    {
+      // give back the frames already taken, with any pages they still hold
+      for (std::uint32_t j = 0; j <= i && j < numShards; j++)
+      {
+        std::lock_guard<std::mutex> lock(shards[j].latch);
+        growShard(shards[j], framesOfShard(j, oldBufs));
+      }
+      throw;
+    }
+
+    // the frames removed are contiguous at the end of the pool, return their memory to the system
+    char* first = reinterpret_cast<char*>(frameData(newBufs));
+    char* last = reinterpret_cast<char*>(frameData(oldBufs));
+    if (poolHugePages)
+    {
+      std::uintptr_t mask = HUGE_PAGE_SIZE - 1;
+      first = reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(first) + mask) & ~mask);
+      last = reinterpret_cast<char*>(reinterpret_cast<std::uintptr_t>(last) & ~mask);
+    }
+    if (first < last)
+      madvise(first, last - first, MADV_DONTNEED);
+  }
+
+  numBufs = newBufs;
+  {
+    std::lock_guard<std::mutex> lock(readAheadLatch);
+    readAheadMax = newBufs / 4 < READ_AHEAD_MAX ? newBufs / 4 : READ_AHEAD_MAX;
+  }
+  return newBufs;
+}
+
+void BufMgr::growShard(BufShard & shard, const std::uint32_t numFrames)
+{
+  std::uint32_t oldFrames = shard.numFrames;
+  if (numFrames <= oldFrames)
+    return;
+
+  shard.policy->setNumSlots(numFrames);
+  shard.numFrames = numFrames;
+  for (std::uint32_t slot = numFrames; slot > oldFrames; slot--)
+  {
+    // pages are only left in new slots by a shrink that failed part way, frames still lent come back on their own
+    const BufDesc& desc = bufDescTable[frameOf(shard, slot - 1)];
+    if (desc.lentTo != BufDesc::NOT_LENT)
+      continue;
+    if (desc.valid)
+      shard.policy->pageLoaded(slot - 1, BufHashTbl::hashKey(desc.file, desc.pageNo));
+    else
+      shard.pushFree(slot - 1);
+  }
+
+  // rebuild the hash table at the size for the new number of frames
+  BufHashTbl* table = new BufHashTbl(hashTableSize(numFrames));
+  for (std::uint32_t slot = 0; slot < numFrames; slot++)
+  {
+    const BufDesc& desc = bufDescTable[frameOf(shard, slot)];
+    if (desc.lentTo == BufDesc::NOT_LENT && desc.valid)
+      table->tryInsert(desc.file, desc.pageNo, desc.frameNo);
+  }
+  for (std::size_t n = 0; n < shard.borrowed.size(); n++)
+  {
+    const BufDesc& desc = bufDescTable[shard.borrowed[n]];
+    if (desc.valid)
+      table->tryInsert(desc.file, desc.pageNo, desc.frameNo);
+  }
+  delete shard.hashTable;
+  shard.hashTable = table;
+}
+
+void BufMgr::shrinkShard(BufShard & shard, std::unique_lock<std::mutex> & lock, const std::uint32_t numFrames)
+{
+  std::uint32_t oldFrames = shard.numFrames;
+  if (numFrames >= oldFrames)
+    return;
+
+  // take the slots going away from the policy and the free list first, so that no page is loaded into them
+  for (std::uint32_t slot = numFrames; slot < oldFrames; slot++)
+  {
+    if (bufDescTable[frameOf(shard, slot)].lentTo != BufDesc::NOT_LENT)
+      continue;
+    if (bufDescTable[frameOf(shard, slot)].ready)
+      takeOffReadyQueue(shard, frameOf(shard, slot));
+    else if (bufDescTable[frameOf(shard, slot)].valid)
+      shard.policy->pageRemoved(slot);
+  }
+  shard.policy->setNumSlots(numFrames);
+  for (std::uint32_t node = 0; node < shard.numNodes; node++)
+  {
+    std::vector<std::uint32_t>& free = shard.freeSlots[node];
+    std::size_t before = free.size();
+    free.erase(std::remove_if(free.begin(), free.end(),
+                              [numFrames](const std::uint32_t slot) { return slot >= numFrames; }),
+               free.end());
+    shard.numFree -= before - free.size();
+  }
+  shard.numFrames = numFrames;
+  if (shard.writerHand >= numFrames)
+    shard.writerHand = 0;
+
+  // then empty them, waiting for pins and I/O to go away and writing dirty pages back. Frames lent to other
+  // shards are asked back first
+  for (std::uint32_t slot = numFrames; slot < oldFrames; slot++)
+  {
+    FrameId frameNo = frameOf(shard, slot);
+    BufDesc* desc = &bufDescTable[frameNo];
+    while (desc->lentTo != BufDesc::NOT_LENT)
+      reclaimFrame(shard, lock, frameNo);
+    while (desc->valid)
+    {
+      if (desc->pinCnt > 0 || desc->ioState != IO_NONE)
+      {
+        shard.ioDone.wait(lock);
+        continue;
+      }
+
+      if (desc->dirty)
+      {
+        desc->ioState = IO_WRITE;
+        lock.unlock();
+        try
+        {
+          writeFrame(frameNo);
+        }
+        catch(...)
+        {
+          lock.lock();
+          desc->ioState = IO_NONE;
+          shard.ioDone.notify_all();
+          throw;
+        }
+        lock.lock();
+        desc->dirty = false;
+        desc->ioState = IO_NONE;
+        shard.ioDone.notify_all();
+        continue;
+      }
+
+      shard.hashTable->tryRemove(desc->file, desc->pageNo);
+      unlinkFrame(frameNo);
+      if (framePages == 1)
+        secondTier.put(desc->file, desc->pageNo, bufPool[frameNo]);
+      desc->Clear();
+      shard.ioDone.notify_all();
+    }
+  }
+}
+
+void BufMgr::clearBufStats()
+{
+  bufStats.clear();
+  for (std::uint32_t s = 0; s < numShards; s++)
+  {
+    std::lock_guard<std::mutex> lock(shards[s].latch);
+    shards[s].fileMetrics.assign(shards[s].fileMetrics.size(), BufMetrics());
+  }
+}
+
+void BufMgr::getStatsSnapshot(BufStatsSnapshot & snapshot)
+{
+  snapshot.accesses = bufStats.accesses;
+  snapshot.diskreads = bufStats.diskreads;
+  snapshot.diskwrites = bufStats.diskwrites;
+  snapshot.prefetches = bufStats.prefetches;
+  snapshot.secondTierHits = bufStats.secondTierHits;
+  bufStats.readLatency.snapshot(snapshot.readLatency);
+  bufStats.writeLatency.snapshot(snapshot.writeLatency);
+
+  std::vector<BufMetrics> byId;
+  for (std::uint32_t s = 0; s < numShards; s++)
+  {
+    std::lock_guard<std::mutex> lock(shards[s].latch);
+    const std::vector<BufMetrics>& counters = shards[s].fileMetrics;
+    if (byId.size() < counters.size())
+      byId.resize(counters.size());
+    for (std::size_t id = 0; id < counters.size(); id++)
+      byId[id].add(counters[id]);
+  }
+
+  // every id counted in a shard has its name by now. Files with nothing counted since clearBufStats() are left out
+  snapshot.files.clear();
+  {
+    std::lock_guard<std::mutex> lock(metricsLatch);
+    for (std::size_t id = 0; id < byId.size(); id++)
+    {
+      const BufMetrics& m = byId[id];
+      if (m.hits + m.misses + m.evictions + m.dirtyEvictions + m.sweepSteps + m.pinWaits > 0)
+        snapshot.files[metricsNames[id]].add(m);
+    }
+  }
+
+  snapshot.total.clear();
+  for (std::map<std::string, BufMetrics>::const_iterator it = snapshot.files.begin(); it != snapshot.files.end(); ++it)
+    snapshot.total.add(it->second);
+}
+
+void BufMgr::printSelf(void) 
+{
+  BufDesc* tmpbuf;
+	int validFrames = 0;
+  
+  if (sharedPool != NULL)
+  {
+    std::cout << "Shared buffer pool of " << numBufs << " frames\n";
+    return;
+  }
+
+  for (std::uint32_t i = 0; i < numBufs; i++)
+	{
+  	std::lock_guard<std::mutex> lock(shardOfFrame(i).latch);
+  	tmpbuf = &(bufDescTable[i]);
+		std::cout << "FrameNo:" << i << " ";
+		tmpbuf->Print();
+
+  	if (tmpbuf->valid == true)
+    	validFrames++;
+  }
+
+	std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
+}
+
+//----------------------------------------
+// PageHandle
+//----------------------------------------
+
+PageHandle& PageHandle::operator=(PageHandle&& other)
+{
+  if (this != &other)
+  {
+    release();
+    mgr = other.mgr;
+    pageNumber = other.pageNumber;
+    frameNo = other.frameNo;
+    page = other.page;
+    dirty = other.dirty;
+    other.mgr = NULL;
+    other.page = NULL;
+  }
+  return *this;
+}
+
+PageHandle::~PageHandle()
+{
+  try
+  {
+    release();
+  }
+  catch(...)
+  {
+    // the pin is already gone, nothing is left to drop
+  }
+}
+
+void PageHandle::release()
+{
+  if (page == NULL)
+    return;
+
+  // the frame cannot change pages while pinned, so its shard is known without a lookup
+  BufMgr* owner = mgr;
+  mgr = NULL;
+  page = NULL;
+  if (owner->sharedPool != NULL)
+    return owner->sharedPool->unPinFrame(frameNo, dirty);
+
+  BufShard& shard = owner->shardOfFrame(frameNo);
+  std::lock_guard<std::mutex> lock(shard.latch);
+  owner->unPinFrame(shard, frameNo, dirty);
 }
 
 }
@@ -9,7 +9,21 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "replacementPolicy.h"
+#include "ioEngine.h"
+#include "bufMetrics.h"
+#include "pageCache.h"
+#include "numa.h"
+#include "sharedPool.h"
 #include <iostream>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+#include <map>
 
 namespace badgerdb {
 
@@ -18,12 +32,28 @@ namespace badgerdb {
 */
 class BufMgr;
 
+/**
+* @brief I/O in progress on a buffer pool frame. Threads wanting the page in a frame that is being read or written
+* wait for the I/O to finish instead of starting their own.
+*/
+enum BufIOState
+{
+	IO_NONE,	/* No I/O in progress */
+	IO_READ,	/* Page is being read into the frame */
+	IO_WRITE,	/* Page is being written back from the frame, before it is reused or dropped */
+	IO_FLUSH	/* Background writer is writing a copy of the page; it may be pinned but not evicted meanwhile */
+};
+
 /**
 * @brief Class for maintaining information about buffer pool frames
+*
+* All fields are guarded by the latch of the shard owning the frame. The pin count is atomic so that it can be
+* inspected without the latch.
 */
 class BufDesc {
 
 	friend class BufMgr;
+	friend struct BufShard;
 
  private:
 	/**
@@ -32,7 +62,8 @@ class BufDesc {
   File* file;
 
 	/**
-   * Page within file to which corresponding frame is assigned
+   * Page within file to which corresponding frame is assigned, the first page of the block in a pool of multi-page
+	 * frames
 	 */
   PageId pageNo;
 
@@ -44,7 +75,7 @@ class BufDesc {
 	/**
    * Number of times this page has been pinned
 	 */
-  int pinCnt;
+  std::atomic<int> pinCnt;
 
 	/**
    * True if page is dirty;  false otherwise
@@ -61,6 +92,58 @@ class BufDesc {
 	 */
   bool refbit;
 
+	/**
+   * I/O currently in progress on the frame
+	 */
+  BufIOState ioState;
+
+	/**
+   * True if the page was read ahead of need and has not been accessed since. Its first access is then not a
+	 * re-reference as far as the replacement policy is concerned.
+	 */
+  bool prefetched;
+
+	/**
+   * True if the frame is on its shard's ready queue. Its replacement policy has already given the page up, but the
+	 * page stays in the pool until the frame is reused and is taken back off the queue if it is pinned meanwhile.
+	 */
+  bool ready;
+
+	/**
+   * Neighbours on the list of frames holding pages of the same file, guarded by BufMgr::fileListLatch
+	 */
+  FrameId filePrev;
+  FrameId fileNext;
+
+	/**
+   * Set when an asynchronous read into the frame failed while the page was pinned, until the last pin is dropped
+	 */
+  std::exception_ptr ioError;
+
+	/**
+   * In a pool of multi-page frames, bit i is set if page pageNo + i of the block is in the frame. Pages past the end
+	 * of the file or not in use are left out until they are allocated.
+	 */
+  std::uint64_t present;
+
+	/**
+   * Asynchronous reads of the block's pages still in flight, in a pool of multi-page frames
+	 */
+  std::uint32_t pendingReads;
+
+	/**
+   * Id of the counters of the page's file, recorded when the page is loaded so that hits and evictions count
+	 * without looking the file up, even once the File is gone
+	 */
+  std::uint32_t metricsId;
+
+	/**
+   * Index of the shard the frame is lent to while its own shard does not use it, or NOT_LENT. Only changed while
+	 * the frame is empty, with the latch of the shard that has it; read without a latch to find which one that is.
+	 */
+  static const std::uint32_t NOT_LENT = 0xffffffff;
+  std::atomic<std::uint32_t> lentTo;
+
 	/**
    * Initialize buffer frame for a new user
 	 */
@@ -72,6 +155,12 @@ class BufDesc {
     dirty = false;
     refbit = false;
 		valid = false;
+		ioState = IO_NONE;
+		ioError = std::exception_ptr();
+		prefetched = false;
+		ready = false;
+		present = 0;
+		pendingReads = 0;
   };
 
 	/**
@@ -89,6 +178,10 @@ class BufDesc {
     dirty = false;
     valid = true;
     refbit = true;
+		ioState = IO_NONE;
+		ioError = std::exception_ptr();
+		prefetched = false;
+		present = 0;
   }
 
   void Print()
@@ -104,7 +197,8 @@ class BufDesc {
 		std::cout << "valid:" << valid << " ";
 		std::cout << "pinCnt:" << pinCnt << " ";
 		std::cout << "dirty:" << dirty << " ";
-		std::cout << "refbit:" << refbit << "\n";
+		std::cout << "refbit:" << refbit << " ";
+		std::cout << "ioState:" << ioState << "\n";
   }
 
 	/**
@@ -113,6 +207,9 @@ class BufDesc {
   BufDesc()
 	{
   	Clear();
+		filePrev = fileNext = 0xffffffff;
+		metricsId = 0;
+		lentTo = NOT_LENT;
   }
 };
 
@@ -125,24 +222,42 @@ struct BufStats
 	/**
    * Total number of accesses to buffer pool
 	 */
-  int accesses;
+  std::atomic<int> accesses;
 
 	/**
    * Number of pages read from disk (including allocs)
 	 */
-  int diskreads;
+  std::atomic<int> diskreads;
 
 	/**
    * Number of pages written back to disk
 	 */
-  int diskwrites;
+  std::atomic<int> diskwrites;
+
+	/**
+   * Number of reads started ahead of need by prefetch() and read-ahead, also counted in diskreads once done
+	 */
+  std::atomic<int> prefetches;
+
+	/**
+   * Number of misses served from the compressed second tier instead of disk
+	 */
+  std::atomic<int> secondTierHits;
+
+	/**
+   * Time taken by the disk reads of readPage() misses, and by every write of pages to disk
+	 */
+  LatencyHistogram readLatency;
+  LatencyHistogram writeLatency;
 
 	/**
    * Clear all values 
 	 */
   void clear()
   {
-		accesses = diskreads = diskwrites = 0;
+		accesses = diskreads = diskwrites = prefetches = secondTierHits = 0;
+		readLatency.clear();
+		writeLatency.clear();
   }
       
 	/**
@@ -156,140 +271,1405 @@ struct BufStats
 
 
 /**
-* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+* @brief One partition of the buffer pool. Pages are assigned to a shard by hash, and a shard owns every
+* numShards-th frame of the pool, starting at its index. The k-th frame of a shard is slot k of its replacement
+* policy.
 */
-class BufMgr 
+struct BufShard : public EvictionCheck
 {
- private:
 	/**
-   * Current position of clockhand in our buffer pool
+   * Frames in a row whose memory is on the same NUMA node, a huge page's worth so that no huge page straddles two
+	 * nodes. The pool's memory goes round the nodes in runs of this many frames.
 	 */
-  FrameId clockHand;
+  static const std::uint32_t NODE_RUN_FRAMES = 2 * 1024 * 1024 / Page::SIZE;
 
 	/**
-   * Number of frames in the buffer pool
+   * Stands for any NUMA node where one is asked for
 	 */
-  std::uint32_t numBufs;
-	
+  static const std::uint32_t ANY_NODE = 0xffffffff;
+
+	/**
+   * Guards the shard's hash table, clock hand and the descriptors of its frames
+	 */
+  std::mutex latch;
+
+	/**
+   * Signalled whenever I/O on one of the shard's frames finishes
+	 */
+  std::condition_variable ioDone;
+
+	/**
+   * Index of the shard, also its first frame
+	 */
+  std::uint32_t index;
+
+	/**
+   * Number of frames owned by the shard
+	 */
+  std::uint32_t numFrames;
+
+	/**
+   * Distance between consecutive frames of the shard, the number of shards
+	 */
+  std::uint32_t stride;
+
+	/**
+   * Slot the background writer looks at next
+	 */
+  std::uint32_t writerHand;
+
 	/**
-   * Hash table mapping (File, page) to frame
+   * Hash table mapping (File, page) to frame for the pages of this shard
 	 */
   BufHashTbl *hashTable;
 
 	/**
-   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+   * Picks the frames to evict among the shard's resident pages
 	 */
-  BufDesc *bufDescTable;
+  ReplacementPolicy *policy;
 
 	/**
-   * Maintains Buffer pool usage statistics 
+   * Number of NUMA nodes the pool's memory is spread over
 	 */
-  BufStats bufStats;
+  std::uint32_t numNodes;
 
 	/**
-	 * Allocate a free frame.  
-	 *
-	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
-	 * @throws BufferExceededException If no such buffer is found which can be allocated
+   * Slots of the shard's frames that hold no page, one list for each NUMA node, and their number
+	 */
+  std::vector<std::vector<std::uint32_t> > freeSlots;
+  std::uint32_t numFree;
+
+	/**
+   * Slots of clean, unpinned frames the background writer has already picked as victims, used once freeSlots runs
+	 * out so that allocation does not have to ask the policy
+	 */
+  std::vector<std::uint32_t> readySlots;
+
+	/**
+   * Frames other shards lent this one when it had none left to evict. They hold its pages like its own frames but
+	 * are not its policy's, and go back once empty.
+	 */
+  std::vector<FrameId> borrowed;
+
+	/**
+   * Descriptors of the whole buffer pool
 	 */
-  void allocBuf(FrameId & frame);
+  BufDesc *descTable;
 
 	/**
-   * Advance clock to next frame in the buffer pool
+   * Event counters of every file with pages in the shard, by the id BufMgr::metricsIdOf() gave the file
 	 */
-  void advanceClock()
+  std::vector<BufMetrics> fileMetrics;
+
+	/**
+   * Returns the shard's counters for a file id, created on first use
+	 */
+  BufMetrics& metricsOf(const std::uint32_t fileId)
   {
-		clockHand = (clockHand + 1) % numBufs;
+		if (fileId >= fileMetrics.size())
+			fileMetrics.resize(fileId + 1);
+		return fileMetrics[fileId];
   }
 
+	/**
+   * Returns true if the frame in a slot is unpinned and has no I/O in progress
+	 */
+  bool canEvict(const std::uint32_t slot) const
+  {
+		const BufDesc& desc = descTable[index + slot * stride];
+		return desc.lentTo == BufDesc::NOT_LENT && desc.valid && desc.pinCnt == 0 && desc.ioState == IO_NONE;
+  }
 
- public:
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Returns true if the frame in a slot can be evicted without being written back
 	 */
-  Page* bufPool;
+  bool canEvictClean(const std::uint32_t slot) const
+  {
+		return canEvict(slot) && !descTable[index + slot * stride].dirty;
+  }
 
 	/**
-   * Constructor of BufMgr class
+   * Returns the NUMA node the memory of the frame in a slot is on
 	 */
-  BufMgr(std::uint32_t bufs);
-	
+  std::uint32_t nodeOf(const std::uint32_t slot) const
+  {
+		return (index + slot * stride) / NODE_RUN_FRAMES % numNodes;
+  }
+
 	/**
-   * Destructor of BufMgr class
+   * Put an empty slot on the free list of its node
 	 */
-  ~BufMgr();
+  void pushFree(const std::uint32_t slot)
+  {
+		freeSlots[nodeOf(slot)].push_back(slot);
+		numFree++;
+  }
 
 	/**
-	 * Reads the given page from the file into a frame and returns the pointer to page.
-	 * If the requested page is already present in the buffer pool pointer to that frame is returned
-	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+   * Take an empty slot, on the given node if it has one and otherwise on any.
 	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number in the file to be read
-	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param node		Node wanted, or ANY_NODE
+	 * @param slot		Slot returned via this variable
+	 * @return			False if there is no empty slot
 	 */
-  void readPage(File* file, const PageId PageNo, Page*& page);
+  bool popFree(const std::uint32_t node, std::uint32_t & slot)
+  {
+		if (numFree == 0)
+			return false;
+		std::uint32_t n = node != ANY_NODE && !freeSlots[node].empty() ? node : 0;
+		while (freeSlots[n].empty())
+			n++;
+		slot = freeSlots[n].back();
+		freeSlots[n].pop_back();
+		numFree--;
+		return true;
+  }
+};
+
+
+/**
+* @brief Lets a replacement policy evict only frames that need no write back, for reads made ahead of need.
+*/
+struct CleanEvictionCheck : public EvictionCheck
+{
+	const BufShard& shard;
+
+	CleanEvictionCheck(const BufShard& shard) : shard(shard) {}
+
+	bool canEvict(const std::uint32_t slot) const
+	{
+		return shard.canEvictClean(slot);
+	}
+};
+
+
+/**
+* @brief Lets a replacement policy evict only frames whose memory is on one NUMA node.
+*/
+struct NodeEvictionCheck : public EvictionCheck
+{
+	const EvictionCheck& check;
+	const BufShard& shard;
+	std::uint32_t node;
+
+	NodeEvictionCheck(const EvictionCheck& check, const BufShard& shard, const std::uint32_t node)
+		: check(check), shard(shard), node(node) {}
+
+	bool canEvict(const std::uint32_t slot) const
+	{
+		return (node == BufShard::ANY_NODE || shard.nodeOf(slot) == node) && check.canEvict(slot);
+	}
+};
 
+
+/**
+* @brief Counts the slots a replacement policy looks at while picking a victim.
+*/
+struct CountingEvictionCheck : public EvictionCheck
+{
+	const EvictionCheck& check;
+	mutable std::uint32_t steps;
+
+	CountingEvictionCheck(const EvictionCheck& check) : check(check), steps(0) {}
+
+	bool canEvict(const std::uint32_t slot) const
+	{
+		steps++;
+		return check.canEvict(slot);
+	}
+};
+
+
+/**
+* @brief Recent accesses to one file, used to spot sequential runs and read ahead of them.
+*/
+struct ReadAheadState
+{
 	/**
-	 * Unpin a page from memory since it is no longer required for it to remain in memory.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
-	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
-   * @throws  PageNotPinnedException If the page is not already pinned
+   * Page accessed last
 	 */
-  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+  PageId lastPage;
 
 	/**
-	 * Allocates a new, empty page in the file and returns the Page object.
-	 * The newly allocated page is also assigned a frame in the buffer pool.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
-	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+   * First page past the last read-ahead window
 	 */
-  void allocPage(File* file, PageId &PageNo, Page*& page); 
+  PageId nextPage;
 
 	/**
-	 * Writes out all dirty pages of the file to disk.
-	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
-	 * Otherwise Error returned.
-	 *
-	 * @param file   	File object
-   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
-   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+   * Number of accesses in a row, each to the page after the one before
 	 */
-  void flushFile(const File* file);
+  std::uint32_t run;
 
 	/**
-	 * Delete page from file and also from buffer pool if present.
-	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
+   * Pages in the current read-ahead window, 0 when not reading ahead
 	 */
-  void disposePage(File* file, const PageId PageNo);
+  std::uint32_t window;
 
 	/**
-   * Print member variable values. 
+   * Pages the file had on disk when the run started, Page::INVALID_NUMBER until a window asks
 	 */
-  void  printSelf();
+  PageId lastOnDisk;
+
+  ReadAheadState() : lastPage(Page::INVALID_NUMBER), nextPage(0), run(0), window(0),
+                     lastOnDisk(Page::INVALID_NUMBER) {}
+};
+
+
+/**
+* @brief A pin on a page in the buffer pool, dropped when the handle is destroyed.
+*
+* Returned by BufMgr::readPage() and BufMgr::allocPage(). The handle remembers the frame the page is in, so
+* unpinning goes straight to the frame's shard without a hash table lookup. Handles can be moved but not copied;
+* an empty handle, default constructed or moved from, holds no pin.
+*/
+class PageHandle
+{
+	friend class BufMgr;
+
+ public:
+  PageHandle() : mgr(NULL), pageNumber(Page::INVALID_NUMBER), frameNo(0), page(NULL), dirty(false) {}
+
+  PageHandle(PageHandle&& other)
+	: mgr(other.mgr), pageNumber(other.pageNumber), frameNo(other.frameNo), page(other.page), dirty(other.dirty)
+  {
+		other.mgr = NULL;
+		other.page = NULL;
+  }
 
 	/**
-   * Get buffer pool usage statistics
+   * Drops the pin this handle holds, if any, and takes over the other handle's.
 	 */
-  BufStats & getBufStats()
+  PageHandle& operator=(PageHandle&& other);
+
+  PageHandle(const PageHandle&) = delete;
+  PageHandle& operator=(const PageHandle&) = delete;
+
+	/**
+   * Unpins the page, writing nothing back itself but leaving the frame dirty if markDirty() was called
+	 */
+  ~PageHandle();
+
+	/**
+   * Returns the page, or NULL for an empty handle
+	 */
+  Page* get() const
   {
-		return bufStats;
+		return page;
+  }
+
+	/**
+   * Returns the page viewed as a node or other structure laid over it
+	 */
+  template <typename T>
+  T* as() const
+  {
+		return reinterpret_cast<T*>(page);
+  }
+
+  Page* operator->() const
+  {
+		return page;
+  }
+
+  Page& operator*() const
+  {
+		return *page;
+  }
+
+  explicit operator bool() const
+  {
+		return page != NULL;
+  }
+
+	/**
+   * Returns the number of the page in its file
+	 */
+  PageId pageNo() const
+  {
+		return pageNumber;
+  }
+
+	/**
+   * Returns the frame the page is in
+	 */
+  FrameId frameId() const
+  {
+		return frameNo;
   }
 
 	/**
-   * Clear buffer pool usage statistics
+   * Have the frame marked dirty when the page is unpinned
 	 */
-  void clearBufStats() 
+  void markDirty()
   {
-		bufStats.clear();
+		dirty = true;
   }
+
+	/**
+   * Unpin the page now, leaving the handle empty. Does nothing if it is already empty.
+	 *
+   * @throws  PageNotPinnedException If the page has been unpinned behind the handle's back
+	 */
+  void release();
+
+ private:
+  PageHandle(BufMgr* mgr, const PageId pageNo, const FrameId frameNo, Page* page)
+	: mgr(mgr), pageNumber(pageNo), frameNo(frameNo), page(page), dirty(false) {}
+
+  BufMgr* mgr;
+  PageId pageNumber;
+  FrameId frameNo;
+  Page* page;
+
+	/**
+   * True if the page was changed through this handle
+	 */
+  bool dirty;
+};
+
+
+/**
+* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* The pool is split into shards, each with its own latch, clock and hash table, so threads working on different
+* pages rarely contend. Disk reads and write-backs run without the shard latch held; a frame with I/O in progress is
+* marked in its descriptor and other threads wait for that I/O rather than repeating it. Reads started by
+* readPageAsync() and prefetch() are handed to an IOEngine and many may be in flight at once.
+*/
+class BufMgr : public IOCompletion
+{
+ private:
+	/**
+   * Most asynchronous reads in flight at once, and the number of threads reading when io_uring is not available
+	 */
+  static const std::uint32_t IO_QUEUE_DEPTH = 64;
+  static const std::uint32_t IO_WORKERS = 4;
+
+	/**
+   * Accesses in a row to consecutive pages of a file before reading ahead, and the first and largest read-ahead
+	 * windows. Each window is twice the last, and no window is larger than a quarter of the pool.
+	 */
+  static const std::uint32_t SEQUENTIAL_RUN = 4;
+  static const std::uint32_t READ_AHEAD_MIN = 8;
+  static const std::uint32_t READ_AHEAD_MAX = 64;
+
+	/**
+   * Most frames of adjacent blocks the warm-up reads with a single read
+	 */
+  static const std::uint32_t WARM_UP_RUN = 32;
+
+	/**
+   * Smallest number of frames per shard when the number of shards is picked automatically
+	 */
+  static const std::uint32_t MIN_SHARD_FRAMES = 64;
+
+	/**
+   * Victims the background writer keeps picked ahead of need in each shard
+	 */
+  static const std::uint32_t READY_QUEUE_SIZE = 16;
+
+	/**
+   * Number of frames in the buffer pool
+	 */
+  std::atomic<std::uint32_t> numBufs;
+
+	/**
+   * Most frames the buffer pool can be resized to
+	 */
+  std::uint32_t maxBufs;
+
+	/**
+   * Serializes resize() calls
+	 */
+  std::mutex resizeLatch;
+
+	/**
+   * Number of shards the buffer pool is split into
+	 */
+  std::uint32_t numShards;
+
+	/**
+   * Array of numShards shards
+	 */
+  BufShard *shards;
+
+	/**
+   * Marks the end of a per-file frame list
+	 */
+  static const FrameId NO_FRAME = 0xffffffff;
+
+	/**
+   * First frame of the list of resident frames of each file, threaded through BufDesc::fileNext
+	 */
+  std::unordered_map<const File*, FrameId> fileFrames;
+
+	/**
+   * Guards fileFrames and the list links of every frame. Taken after a shard latch, never before.
+	 */
+  std::mutex fileListLatch;
+
+	/**
+   * Add a frame that has just been given a page to the list of its file. Called with the frame's shard latch held.
+	 */
+  void linkFrame(const FrameId frameNo);
+
+	/**
+   * Take a frame about to lose its page off the list of its file. Called with the frame's shard latch held.
+	 */
+  void unlinkFrame(const FrameId frameNo);
+
+	/**
+   * Drop every page of a file from the buffer pool, looking only at the file's own frames.
+	 *
+	 * @param file   	File object
+	 * @param write   	True to write the dirty pages first, false to throw them away
+	 * @throws  PagePinnedException If any page of the file is pinned in the buffer pool
+	 * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 */
+  void dropFile(const File* file, const bool write);
+
+	/**
+   * Thread reading the pages of a hot page list back in, not joinable when it is not running, and the flag that
+	 * tells it to stop early
+	 */
+  std::thread warmUpThread;
+  std::atomic<bool> warmUpStop;
+
+	/**
+   * File the destructor saves the hot page list to, empty for none
+	 */
+  std::string hotPagePath;
+
+	/**
+   * Body of the warm-up thread. Reads the pages ahead of need in order of file and page number, into frames that
+	 * are still empty. Runs of adjacent blocks of a file are read together with readRun().
+	 */
+  void warmUpPages(std::vector<std::pair<File*, PageId> > pages);
+
+	/**
+   * Read adjacent blocks of a file into frames claimed for them by claimPrefetch(), with one positional read.
+	 * Blocks past the end of the file, or whose pages do not check, are dropped as a failed asynchronous read is.
+	 * Called without any shard latch.
+	 *
+	 * @param file   	File object
+	 * @param first  	First block of the run
+	 * @param frames  	Frame of each block, in order
+	 */
+  void readRun(File* file, const PageId first, const std::vector<FrameId>& frames);
+
+	/**
+   * Start reading one page ahead of need, as prefetch() does.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  	Page number in the file
+	 * @param emptyOnly	Only use an empty frame, evicting nothing
+	 * @return			False if there was no frame to read the page into
+	 */
+  bool prefetchPage(File* file, const PageId pageNo, const bool emptyOnly);
+
+	/**
+   * Claim an unpinned frame to read a page's block ahead of need into, leaving it IO_READ for the caller to read.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  	Page number in the file
+	 * @param emptyOnly	Only use an empty frame, evicting nothing
+	 * @param frameNo  	Set to the frame claimed
+	 * @param claimed  	Set to false if the block is in the pool already, and nothing was claimed
+	 * @return			False if there was no frame to read the page into
+	 */
+  bool claimPrefetch(File* file, const PageId pageNo, const bool emptyOnly, FrameId & frameNo, bool & claimed);
+
+	/**
+   * Background writer thread, not joinable when it is not running
+	 */
+  std::thread writerThread;
+
+	/**
+   * Guards writerStop and lets the writer sleep between rounds
+	 */
+  std::mutex writerLatch;
+
+	/**
+   * Wakes the background writer early, or for it to stop
+	 */
+  std::condition_variable writerWake;
+
+	/**
+   * Set to make the background writer exit
+	 */
+  bool writerStop;
+
+	/**
+   * Percentage of each shard's frames the background writer tries to keep clean and evictable, and how long it
+	 * sleeps between rounds
+	 */
+  std::uint32_t writerCleanPercent;
+  std::uint32_t writerIntervalMs;
+
+	/**
+   * Body of the background writer thread
+	 */
+  void backgroundWriter();
+
+	/**
+   * One round of the background writer. Picks dirty unpinned frames in every shard running short of clean ones,
+	 * copies them, sorts the copies by file and page number and writes each run of consecutive pages with one call.
+	 */
+  void writeDirtyFrames();
+
+	/**
+   * Write frames marked IO_WRITE to disk sorted by file and page number, each run of consecutive pages with one call
+	 *
+	 * @param frames 	Frames to write
+	 */
+  void writeFrames(std::vector<FrameId> & frames);
+
+	/**
+   * Does the reads started by readPageAsync() and prefetch()
+	 */
+  IOEngine *ioEngine;
+
+	/**
+   * An asynchronous read has finished. Marks the frame readable, or drops it if the read failed and nothing has
+	 * the page pinned.
+	 *
+	 * @param request 	The read, its tag is the frame number
+	 * @param error 	What the read threw, if anything
+	 */
+  void readDone(const IORequest& request, std::exception_ptr error);
+
+	/**
+   * Drop a frame whose asynchronous read failed, once it is no longer pinned. Called with its shard latch held.
+	 */
+  void dropFailedFrame(BufShard & shard, const FrameId frameNo);
+
+	/**
+   * Access pattern of every file read through the pool, guarded by readAheadLatch
+	 */
+  std::unordered_map<const File*, ReadAheadState> readAhead;
+  std::mutex readAheadLatch;
+
+	/**
+   * Whether to read ahead of sequential runs, and the largest window for the current size of the pool, guarded by
+	 * readAheadLatch
+	 */
+  std::atomic<bool> readAheadOn;
+  std::uint32_t readAheadMax;
+
+	/**
+	 * Note an access to a page and decide whether to read ahead of it. Sequential runs open a window of
+	 * READ_AHEAD_MIN pages past the page, and the next, twice as large, is read once the reader is halfway through
+	 * the last. Access anywhere else halves the window and waits for a new run. Windows stop at the last page the
+	 * file had on disk when the run started, so a run reaching the end does not read ahead the pages an append is
+	 * about to allocate.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  	Page being accessed
+	 * @param first  	First page to read ahead returned via this variable
+	 * @param count  	Number of pages to read ahead returned via this variable
+	 * @return			True if pages should be read ahead
+	 */
+  bool noteAccess(const File* file, const PageId pageNo, PageId & first, std::uint32_t & count);
+
+	/**
+	 * Forget the read-ahead state of a File object being closed, and wait for reads of its pages still in flight,
+	 * which use the File. A shared pool forgets the File instead. Registered with File::addCloseHandler().
+	 *
+	 * @param file   	File object
+	 * @param mgr   	The BufMgr
+	 */
+  static void fileClosed(const File* file, void* mgr);
+
+	/**
+   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+	 */
+  BufDesc *bufDescTable;
+
+	/**
+   * Maintains Buffer pool usage statistics 
+	 */
+  BufStats bufStats;
+
+	/**
+   * Compressed copies of clean pages evicted from the pool, off until given a size by setSecondTierSize()
+	 */
+  CompressedPageCache secondTier;
+
+	/**
+   * Fill a frame claimed for a page from the second tier if the page is there, ending the frame's IO_READ.
+	 * Called without the shard latch.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  	Page number in the file
+	 * @param frameNo  	Frame claimed for the page
+	 * @return			True if the frame now holds the page and needs no read
+	 */
+  bool readFromSecondTier(const File* file, const PageId pageNo, const FrameId frameNo);
+
+	/**
+   * Ids of the shards' counters, of each open File and of each file name, guarded by metricsLatch. A File keeps
+	 * its id until it is closed or its pages are flushed or discarded, so that a later File at the same address
+	 * does not inherit it; a File of the same name gets the same id again.
+	 */
+  std::unordered_map<const File*, std::uint32_t> metricsIds;
+  std::unordered_map<std::string, std::uint32_t> metricsNameIds;
+  std::vector<std::string> metricsNames;
+  std::mutex metricsLatch;
+
+	/**
+   * Returns the id of a file's counters, given it on first use. Called on misses, with a shard latch held or not;
+	 * metricsLatch is never held while waiting for a shard latch.
+	 */
+  std::uint32_t metricsIdOf(const File* file);
+
+	/**
+   * Forget the id of a File's counters, once it is closed or its pages are gone
+	 */
+  void forgetMetricsId(const File* file);
+
+	/**
+   * Huge page size the pool is sized and aligned to
+	 */
+  static const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+	/**
+   * Bytes mapped for bufPool, and whether they are explicit huge pages rather than ordinary pages advised for
+	 * transparent huge pages
+	 */
+  std::size_t poolBytes;
+  bool poolHugePages;
+
+	/**
+   * NUMA nodes the pool's memory is spread over
+	 */
+  const NumaTopology* numa;
+
+	/**
+   * Most pages a frame may hold
+	 */
+  static const std::uint32_t MAX_FRAME_PAGES = 64;
+
+	/**
+   * Pages each frame holds, 1 unless the pool was made for pages larger than Page::SIZE. A frame then holds a block
+	 * of that many consecutive pages, starting at a page number one more than a multiple of it, under a single
+	 * descriptor, hash table entry and pin.
+	 */
+  std::uint32_t framePages;
+
+	/**
+   * The shared memory pool every call goes to instead of the shards, if the pool was made with a segment name.
+	 * NULL otherwise.
+	 */
+  SharedBufPool* sharedPool;
+
+	/**
+   * Returns the memory of a frame, its first page
+	 */
+  Page* frameData(const FrameId frameNo) const
+  {
+		return &bufPool[(std::size_t) frameNo * framePages];
+  }
+
+	/**
+   * Returns the first page of the block holding a page
+	 */
+  PageId blockOf(const PageId pageNo) const
+  {
+		return framePages == 1 || pageNo == 0 ? pageNo : pageNo - (pageNo - 1) % framePages;
+  }
+
+	/**
+   * Returns the pages of a frame's block that are in the frame, bit i for the i-th page of the block
+	 */
+  std::uint64_t presentPages(const BufDesc & desc) const
+  {
+		return framePages == 1 ? 1 : desc.present;
+  }
+
+	/**
+   * Returns true if a page of a frame's block is in the frame
+	 */
+  bool hasPage(const BufDesc & desc, const PageId pageNo) const
+  {
+		return (presentPages(desc) >> (pageNo - desc.pageNo) & 1) != 0;
+  }
+
+	/**
+	 * Read a page into a frame claimed for it, with the rest of its block when frames hold several pages. The block
+	 * is read with a single read; pages of it that do not exist in the file are left out. Called without the shard
+	 * latch.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  	Page wanted
+	 * @param frameNo  	Frame claimed for the page's block
+	 * @return			The pages of the block now in the frame
+	 * @throws  InvalidPageException If the page wanted does not exist in the file
+	 */
+  std::uint64_t readBlock(File* file, const PageId pageNo, const FrameId frameNo);
+
+	/**
+	 * Read a page of a frame's block that the frame does not hold yet, such as one allocated after the block was
+	 * read. The frame must be pinned by the caller and have no I/O in progress; it is marked IO_READ meanwhile.
+	 *
+	 * @param shard   	Shard owning the frame, its latch held through lock
+	 * @param lock   	Lock holding the shard latch
+	 * @param frameNo  	Frame of the block
+	 * @param pageNo  	Page to read
+	 * @throws  InvalidPageException If the page does not exist in the file
+	 */
+  void fillPage(BufShard & shard, std::unique_lock<std::mutex> & lock, const FrameId frameNo, const PageId pageNo);
+
+	/**
+	 * Start asynchronous reads of the pages of a block into the frame claimed for it, one for each page. Called
+	 * without the shard latch.
+	 *
+	 * @param file   	File object
+	 * @param block  	First page of the block
+	 * @param frameNo  	Frame claimed for the block
+	 */
+  void submitReads(File* file, const PageId block, const FrameId frameNo);
+
+	/**
+	 * Write the pages held by a frame back to disk, each run of consecutive pages with one call. Called without the
+	 * shard latch, the frame marked IO_WRITE.
+	 *
+	 * @param frameNo  	Frame to write
+	 */
+  void writeFrame(const FrameId frameNo);
+
+	/**
+	 * Allocate a free frame from a shard, taking an empty one if there is any and otherwise evicting the page the
+	 * shard's replacement policy picks. Frames on the calling thread's NUMA node are preferred either way. With
+	 * nothing left to evict the shard borrows a frame from another. May release the shard latch while a dirty victim
+	 * is written back or a frame is borrowed, so the caller must recheck anything it looked up before the call.
+	 *
+	 * @param shard   	Shard to allocate from, its latch held through lock
+	 * @param lock   	Lock holding the shard latch
+	 * @param fileId   	Counters id of the file of the page the frame is for
+	 * @param key   	Hash key of the page the frame is for
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param cleanOnly	True to evict only pages that need no write back
+	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 */
+  void allocBuf(BufShard & shard, std::unique_lock<std::mutex> & lock, const std::uint32_t fileId,
+                const std::uint64_t key, FrameId & frame, const bool cleanOnly = false);
+
+	/**
+	 * Pick a page to evict from a shard, among those the background writer picked ahead of need first. Called with
+	 * the shard latch held.
+	 *
+	 * @param shard   	Shard to pick from
+	 * @param fileId   	Counters id of the file of the page the frame is for
+	 * @param key   	Hash key of the page the frame is for
+	 * @param node   	NUMA node the frame must be on, or BufShard::ANY_NODE
+	 * @param cleanOnly	True to pick only pages that need no write back
+	 * @param slot   	Slot of the victim returned via this variable
+	 * @return			False if no page can be evicted
+	 */
+  bool pickVictim(BufShard & shard, const std::uint32_t fileId, const std::uint64_t key, const std::uint32_t node,
+                  const bool cleanOnly, std::uint32_t & slot);
+
+	/**
+	 * Write back if dirty and drop the page in a frame, leaving the frame empty but off the free list. The latch is
+	 * released while the page is written and copied to the second tier, which IO_WRITE keeps anyone else from
+	 * pinning or reusing the frame through.
+	 *
+	 * @param shard   	Shard holding the page, its latch held through lock
+	 * @param lock   	Lock holding the shard latch
+	 * @param frameNo  	Frame of the page, unpinned and with no I/O in progress
+	 */
+  void evictFrame(BufShard & shard, std::unique_lock<std::mutex> & lock, const FrameId frameNo);
+
+	/**
+	 * Find a frame lent to a shard that is empty, or whose page can be evicted. Called with the shard latch held.
+	 *
+	 * @param shard   	Shard that borrowed the frames
+	 * @param cleanOnly	True to pick only pages that need no write back
+	 * @param frame   	Frame found returned via this variable
+	 * @return			False if there is none
+	 */
+  bool pickBorrowed(BufShard & shard, const bool cleanOnly, FrameId & frame);
+
+	/**
+	 * Borrow an empty frame from another shard, evicting a clean page there if need be. Only one shard latch is ever
+	 * waited for at a time, so the shard's latch is released while the others are tried.
+	 *
+	 * @param shard   	Shard short of frames, its latch held through lock
+	 * @param lock   	Lock holding the shard latch
+	 * @param fileId   	Counters id of the file of the page the frame is for
+	 * @param key   	Hash key of the page the frame is for
+	 * @param frame   	Frame reference, frame ID of the borrowed frame returned via this variable
+	 * @return			False if no shard has a frame to spare
+	 */
+  bool borrowFrame(BufShard & shard, std::unique_lock<std::mutex> & lock, const std::uint32_t fileId,
+                   const std::uint64_t key, FrameId & frame);
+
+	/**
+	 * Give an empty frame a shard borrowed back to the shard it belongs to. Called with the borrowing shard's latch
+	 * held, so the owner's latch is only tried, never waited for.
+	 *
+	 * @param shard   	Shard that borrowed the frame
+	 * @param frameNo  	Frame to give back
+	 * @return			False if the owner's latch was busy, or borrowFrame() has not listed the frame with the shard yet.
+	 * 					The frame then stays with the shard for now.
+	 */
+  bool returnFrame(BufShard & shard, const FrameId frameNo);
+
+	/**
+	 * Get back a frame a shard lent to another, for resize(). Evicts the page the borrower keeps in it if it can,
+	 * otherwise waits a while for it to be unpinned. The shard's latch is released meanwhile.
+	 *
+	 * @param shard   	Shard that lent the frame, its latch held through lock
+	 * @param lock   	Lock holding the shard latch
+	 * @param frameNo  	Frame lent
+	 */
+  void reclaimFrame(BufShard & shard, std::unique_lock<std::mutex> & lock, const FrameId frameNo);
+
+	/**
+	 * Allocate a frame for a page missing from its shard, and put the page in the hash table marked IO_READ and
+	 * pinned once, so that concurrent misses wait for the read about to be started. The shard latch may be dropped
+	 * meanwhile, as in allocBuf.
+	 *
+	 * @param shard   	Shard of the page, its latch held through lock
+	 * @param lock   	Lock holding the shard latch
+	 * @param file   	File object
+	 * @param pageNo  	Page number in the file, the first of its block
+	 * @param key   	Hash key of the page
+	 * @param frame   	Frame reference, frame ID of the claimed frame returned via this variable
+	 * @param cleanOnly	True to evict only pages that need no write back
+	 * @return			False, with no frame claimed, if another thread brought the page in while the latch was dropped
+	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 */
+  bool claimFrame(BufShard & shard, std::unique_lock<std::mutex> & lock, File* file, const PageId pageNo,
+                  const std::uint64_t key, FrameId & frame, const bool cleanOnly = false);
+
+	/**
+   * Returns the frame in a slot of a shard
+	 */
+  FrameId frameOf(const BufShard & shard, const std::uint32_t slot) const
+  {
+		return shard.index + slot * numShards;
+  }
+
+	/**
+   * Returns the slot of a frame within its shard
+	 */
+  std::uint32_t slotOf(const FrameId frameNo) const
+  {
+		return frameNo / numShards;
+  }
+
+	/**
+   * Returns true if a frame is one of a shard's own slots and stays with it. Frames resize() is taking away and
+	 * frames borrowed from other shards do not belong to the shard's policy.
+	 */
+  bool inPolicy(const BufShard & shard, const FrameId frameNo) const
+  {
+		return frameNo % numShards == shard.index && slotOf(frameNo) < shard.numFrames;
+  }
+
+	/**
+   * Put a frame that holds no page back on its shard's free list, unless resize() is taking it away. A borrowed
+	 * frame goes back to the shard that lent it.
+	 */
+  void freeFrame(BufShard & shard, const FrameId frameNo)
+  {
+		if (bufDescTable[frameNo].valid)
+			unlinkFrame(frameNo);
+		bufDescTable[frameNo].Clear();
+		if (bufDescTable[frameNo].lentTo != BufDesc::NOT_LENT)
+			returnFrame(shard, frameNo);
+		else if (slotOf(frameNo) < shard.numFrames)
+			shard.pushFree(slotOf(frameNo));
+		else
+			shard.ioDone.notify_all();
+  }
+
+	/**
+   * Tell a shard's policy about a page loaded, a page hit, or a page leaving its frame, if the frame is the
+	 * policy's
+	 */
+  void pageLoaded(BufShard & shard, const FrameId frameNo, const std::uint64_t key)
+  {
+		if (inPolicy(shard, frameNo))
+			shard.policy->pageLoaded(slotOf(frameNo), key);
+  }
+
+  void pageAccessed(BufShard & shard, const FrameId frameNo)
+  {
+		if (inPolicy(shard, frameNo))
+			shard.policy->pageAccessed(slotOf(frameNo));
+  }
+
+  void pageRemoved(BufShard & shard, const FrameId frameNo)
+  {
+		if (bufDescTable[frameNo].ready)
+			takeOffReadyQueue(shard, frameNo);
+		else if (inPolicy(shard, frameNo))
+			shard.policy->pageRemoved(slotOf(frameNo));
+  }
+
+	/**
+   * Tell a shard's policy that a page has been pinned by a hit. A page read ahead of need was not accessed yet, and
+	 * a page on the ready queue goes back to the policy as if it had just been loaded.
+	 */
+  void pageHit(BufShard & shard, const FrameId frameNo)
+  {
+		BufDesc& desc = bufDescTable[frameNo];
+		if (desc.ready)
+		{
+			takeOffReadyQueue(shard, frameNo);
+			desc.prefetched = false;
+			pageLoaded(shard, frameNo, BufHashTbl::hashKey(desc.file, desc.pageNo));
+		}
+		else if (desc.prefetched)
+			desc.prefetched = false;
+		else
+			pageAccessed(shard, frameNo);
+  }
+
+	/**
+   * Take a frame off its shard's ready queue. Called with the shard latch held.
+	 */
+  void takeOffReadyQueue(BufShard & shard, const FrameId frameNo);
+
+	/**
+   * Pick clean victims into every shard's ready queue, for the background writer
+	 */
+  void fillReadyQueues();
+
+	/**
+   * Returns the number of frames a shard owns in a pool of the given size
+	 */
+  std::uint32_t framesOfShard(const std::uint32_t index, const std::uint32_t bufs) const
+  {
+		return (bufs - index + numShards - 1) / numShards;
+  }
+
+	/**
+   * Give a shard more frames, the new ones empty. Called with the shard latch held.
+	 *
+	 * @param shard   	Shard to grow
+	 * @param numFrames	New number of frames of the shard
+	 */
+  void growShard(BufShard & shard, const std::uint32_t numFrames);
+
+	/**
+   * Take frames away from a shard, writing back and evicting their pages. Waits for pages pinned in those frames to
+	 * be unpinned.
+	 *
+	 * @param shard   	Shard to shrink, its latch held through lock
+	 * @param lock   	Lock holding the shard latch
+	 * @param numFrames	New number of frames of the shard
+	 */
+  void shrinkShard(BufShard & shard, std::unique_lock<std::mutex> & lock, const std::uint32_t numFrames);
+
+	/**
+   * Returns the shard a page of a file belongs to
+	 */
+  BufShard & shardOf(const File* file, const PageId pageNo)
+  {
+		return shards[(BufHashTbl::hashKey(file, pageNo) >> 32) % numShards];
+  }
+
+	/**
+   * Returns the shard using a frame, the one it is lent to if it is
+	 */
+  BufShard & shardOfFrame(const FrameId frameNo)
+  {
+		std::uint32_t lentTo = bufDescTable[frameNo].lentTo;
+		return shards[lentTo != BufDesc::NOT_LENT ? lentTo : frameNo % numShards];
+  }
+
+	/**
+   * Lock the latch of the shard using a frame the caller has no pin or I/O on. A borrowed frame may go back to
+	 * its owner until the latch is held, so the shard is looked up again once it is.
+	 *
+	 * @param frameNo  	Frame
+	 * @param lock   	Lock returned holding the shard latch
+	 * @return			The shard using the frame
+	 */
+  BufShard & lockShardOfFrame(const FrameId frameNo, std::unique_lock<std::mutex> & lock)
+  {
+		BufShard* shard = &shardOfFrame(frameNo);
+		lock = std::unique_lock<std::mutex>(shard->latch);
+		while (shard != &shardOfFrame(frameNo))
+		{
+			lock.unlock();
+			shard = &shardOfFrame(frameNo);
+			lock = std::unique_lock<std::mutex>(shard->latch);
+		}
+		return *shard;
+  }
+
+	/**
+   * Drop one pin of the page in a frame, with the frame's shard latch held.
+	 *
+	 * @param shard   	Shard owning the frame
+	 * @param frameNo  	Frame of the page
+	 * @param dirty		True if the page needs to be marked dirty
+   * @throws  PageNotPinnedException If the page is not already pinned
+	 */
+  void unPinFrame(BufShard & shard, const FrameId frameNo, const bool dirty);
+
+  friend class PageHandle;
+
+
+ public:
+	/**
+   * Actual buffer pool from which frames are allocated. It is mapped rather than allocated, aligned to a huge page,
+	 * and frames are not initialized: each is filled by a read or a new page before it is first handed out. Frame f
+	 * starts at page f * getFramePages().
+	 */
+  Page* bufPool;
+
+	/**
+   * Constructor of BufMgr class
+	 *
+	 * @param bufs		Number of frames in the buffer pool
+	 * @param shards	Number of shards to split the pool into, or 0 to pick one per hardware thread while keeping at
+	 *					least MIN_SHARD_FRAMES frames in each
+	 * @param policy	Replacement policy used within every shard
+	 * @param maxBufs	Most frames the pool may be resized to, or 0 for bufs. Only address space is taken for frames
+	 *					beyond bufs.
+	 * @param pagesPerFrame	Pages each frame holds, for files whose pages are larger than Page::SIZE, rounded up to
+	 *					a power of two no more than MAX_FRAME_PAGES. Reading any page of such a file reads the block of
+	 *					consecutive pages around it into one frame.
+	 */
+  BufMgr(std::uint32_t bufs, std::uint32_t shards = 0, ReplacementKind policy = REPL_CLOCK, std::uint32_t maxBufs = 0,
+         std::uint32_t pagesPerFrame = 1);
+
+	/**
+   * Constructor of a BufMgr whose buffer pool lives in a POSIX shared memory segment, shared with every process on
+	 * the host that makes one with the same name. Pages read by one process are found in the pool by the others, and
+	 * changes made in one are seen by the others without going to disk. Such a pool has one latch and uses the clock
+	 * policy; it is not sharded, resized, read ahead of or warmed up, and has no second tier or background writer.
+	 * The segment outlives the processes, SharedBufPool::remove() removes it.
+	 *
+	 * @param sharedName	Name of the segment, starting with '/'
+	 * @param bufs		Number of frames, if the segment is created here. One that exists keeps its own size.
+	 * @throws std::system_error If the segment cannot be created or mapped
+	 */
+  BufMgr(const std::string& sharedName, std::uint32_t bufs);
+	
+	/**
+   * Destructor of BufMgr class
+	 */
+  ~BufMgr();
+
+	/**
+	 * Reads the given page from the file into a frame and returns the pointer to page.
+	 * If the requested page is already present in the buffer pool pointer to that frame is returned
+	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page);
+
+	/**
+	 * Pins the given page and returns its frame without waiting for it to be read. If the page is not in the buffer
+	 * pool its read is started in the background; call waitPage() before using the page.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer. The frame the page is being read into is returned via this reference.
+	 * @throws BufferExceededException If no frame can be allocated for the page
+	 */
+  void readPageAsync(File* file, const PageId PageNo, Page*& page);
+
+	/**
+	 * Waits for the read of a page pinned by readPageAsync() to finish. If the read failed, drops the pin taken by
+	 * readPageAsync() and throws what the read threw.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file
+   * @throws  HashNotFoundException If the page is not in the buffer pool
+   * @throws  InvalidPageException If the page does not exist in the file
+	 */
+  void waitPage(File* file, const PageId PageNo);
+
+	/**
+	 * Starts reading pages into the buffer pool in the background, without pinning them, so that later readPage()
+	 * calls find them there. Pages already in the pool are skipped, only frames that are free or hold clean pages
+	 * are used, and nothing more is read once there are none. Pages that turn out not to exist are quietly dropped.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  First page number to read
+	 * @param count  	Number of consecutive pages to read
+	 */
+  void prefetch(File* file, const PageId PageNo, const std::uint32_t count = 1);
+
+	/**
+	 * Unpin a page from memory since it is no longer required for it to remain in memory.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+   * @throws  PageNotPinnedException If the page is not already pinned
+   * @throws  HashNotFoundException If the page is not in the buffer pool
+	 */
+  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+
+	/**
+	 * Reads the given page like readPage(Page*&), returning a handle that unpins it when destroyed.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @return			Handle pinning the page
+	 */
+  PageHandle readPage(File* file, const PageId PageNo);
+
+	/**
+	 * Allocates a new, empty page in the file like allocPage(Page*&), returning a handle that unpins it when destroyed.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @return			Handle pinning the page
+	 */
+  PageHandle allocPage(File* file, PageId &PageNo);
+
+	/**
+	 * Allocates a new, empty page in the file and returns the Page object.
+	 * The newly allocated page is also assigned a frame in the buffer pool.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 */
+  void allocPage(File* file, PageId &PageNo, Page*& page); 
+
+	/**
+	 * Writes out all dirty pages of the file to disk, in page number order with runs of consecutive pages written together,
+	 * and drops the file's pages from the buffer pool.
+	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
+	 * Otherwise Error returned.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
+   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 */
+  void flushFile(const File* file);
+
+	/**
+	 * Drops all pages of the file from the buffer pool without writing them, for temporary files whose contents
+	 * are no longer needed. Like flushFile, only the file's own frames are visited.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
+   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 */
+  void discardFile(const File* file);
+
+	/**
+	 * Delete page from file and also from buffer pool if present.
+	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 */
+  void disposePage(File* file, const PageId PageNo);
+
+	/**
+   * Print member variable values. 
+	 */
+  void  printSelf();
+
+	/**
+	 * Start a background writer thread that keeps some frames of every shard clean, so that eviction rarely has to
+	 * write a page itself, and picks a few clean victims in each shard ahead of need, so that allocating a frame
+	 * rarely has to search for one. Does nothing if the writer is already running.
+	 *
+	 * @param cleanPercent	Percentage of each shard's frames to keep clean and evictable
+	 * @param intervalMs	Milliseconds between rounds when nothing wakes the writer
+	 */
+  void startBackgroundWriter(const std::uint32_t cleanPercent = 10, const std::uint32_t intervalMs = 10);
+
+	/**
+	 * Turn reading ahead of sequential runs on or off. It is on by default, though never used while the pool is too
+	 * small for a useful window.
+	 *
+	 * @param enable	True to read ahead
+	 */
+  void setReadAhead(const bool enable)
+  {
+		readAheadOn = enable;
+  }
+
+	/**
+	 * Save the list of pages in the pool, by file name and page number, the ones the replacement policy would keep
+	 * longest first. startWarmUp() reads them back in after a restart. The list is written to a temporary file that
+	 * replaces the old one once complete.
+	 *
+	 * @param path		File to save the list in
+	 * @return			False if the file could not be written, or the pool is shared
+	 */
+  bool saveHotPages(const std::string& path);
+
+	/**
+	 * Have the destructor save the hot page list, while the pool is still full.
+	 *
+	 * @param path		File to save the list in, empty not to save it
+	 */
+  void saveHotPagesOnExit(const std::string& path)
+  {
+		hotPagePath = path;
+  }
+
+	/**
+	 * Start reading the pages of a list saved by saveHotPages() back in, in the background while the pool is in use.
+	 * Only the hottest pages that fit in the pool are read, in order of file and page number so the disk sees long
+	 * runs, with many reads in flight at once. They only go into empty frames, so pages queries brought in meanwhile
+	 * stay. Pages of files not given are skipped.
+	 *
+	 * The files must stay open until the warm-up is over or stopWarmUp() is called.
+	 *
+	 * @param path		File the list was saved in
+	 * @param files		Open files the pages may belong to, matched by name
+	 * @return			False if the list could not be read
+	 */
+  bool startWarmUp(const std::string& path, const std::vector<File*>& files);
+
+	/**
+	 * Wait for the warm-up to read all its pages in. Does nothing if no warm-up is running.
+	 */
+  void waitForWarmUp();
+
+	/**
+	 * Stop the warm-up without reading the rest of its pages, and wait for it. Does nothing if no warm-up is running.
+	 */
+  void stopWarmUp();
+
+	/**
+	 * Grow or shrink the buffer pool while it is in use. New frames start empty. Frames taken away are the highest
+	 * numbered; their dirty pages are written back, their pages evicted and their memory returned to the system.
+	 * Pages pinned in those frames are waited for, so the caller must not hold any pins itself.
+	 *
+	 * @param bufs		New number of frames, kept between the number of shards and maxBufs
+	 * @return			The number of frames the pool now has
+	 */
+  std::uint32_t resize(const std::uint32_t bufs);
+
+	/**
+	 * Size the compressed second tier that clean pages go to when they are evicted, and that misses look in before
+	 * reading from disk. A compressed page takes a fraction of a frame, so the same memory holds several times as many
+	 * pages as frames would. Only pools of single-page frames use it.
+	 *
+	 * @param bytes		Most memory the second tier may use, 0 to turn it off and drop what it holds
+	 */
+  void setSecondTierSize(const std::size_t bytes)
+  {
+		secondTier.setCapacity(bytes);
+  }
+
+	/**
+   * Returns the number of NUMA nodes the pool is partitioned over
+	 */
+  std::uint32_t getNumNodes() const
+  {
+		return numa->getNumNodes();
+  }
+
+	/**
+   * Returns the compressed second tier, to see how much it holds
+	 */
+  const CompressedPageCache & getSecondTier() const
+  {
+		return secondTier;
+  }
+
+	/**
+   * Returns the number of frames in the buffer pool, and the most it may be resized to
+	 */
+  std::uint32_t getNumBufs() const
+  {
+		return numBufs;
+  }
+
+  std::uint32_t getMaxBufs() const
+  {
+		return maxBufs;
+  }
+
+	/**
+	 * Stop the background writer thread and wait for it to finish its round. Does nothing if it is not running.
+	 */
+  void stopBackgroundWriter();
+
+	/**
+   * Returns the number of pages each frame holds, and the bytes of memory each frame takes
+	 */
+  std::uint32_t getFramePages() const
+  {
+		return framePages;
+  }
+
+  std::size_t getFrameSize() const
+  {
+		return (std::size_t) framePages * Page::SIZE;
+  }
+
+	/**
+   * Returns true if the buffer pool is in shared memory, shared with other processes
+	 */
+  bool isShared() const
+  {
+		return sharedPool != NULL;
+  }
+
+	/**
+   * Returns the number of shards the buffer pool is split into
+	 */
+  std::uint32_t getNumShards() const
+  {
+		return numShards;
+  }
+
+	/**
+   * Returns the name of the replacement policy
+	 */
+  const char* getPolicyName() const
+  {
+		return sharedPool != NULL ? "clock" : shards[0].policy->name();
+  }
+
+	/**
+   * Returns true if the buffer pool is backed by explicit huge pages
+	 */
+  bool usesHugePages() const
+  {
+		return poolHugePages;
+  }
+
+	/**
+   * Returns the name of the engine doing asynchronous reads
+	 */
+  const char* getIOEngineName() const
+  {
+		return ioEngine != NULL ? ioEngine->name() : "none";
+  }
+
+	/**
+   * Get buffer pool usage statistics
+	 */
+  BufStats & getBufStats()
+  {
+		return bufStats;
+  }
+
+	/**
+   * Clear buffer pool usage statistics, the event counters and the latency histograms
+	 */
+  void clearBufStats();
+
+	/**
+	 * Gather the statistics, event counters and latency histograms of the pool. Counters are summed over the shards
+	 * one at a time, so events happening meanwhile may be included for some shards and not others.
+	 *
+	 * @param snapshot	Statistics returned in this
+	 */
+  void getStatsSnapshot(BufStatsSnapshot & snapshot);
 };
 
 }
@@ -13,6 +13,11 @@
 #include <string>
 #include <cstdio>
 #include <cassert>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
@@ -25,6 +30,14 @@ namespace badgerdb {
 
 File::StreamMap File::open_streams_;
 File::CountMap File::open_counts_;
+File::DescriptorMap File::open_descriptors_;
+File::LatchMap File::open_latches_;
+std::mutex File::close_handlers_latch_;
+
+File::CloseHandlerList& File::closeHandlers() {
+  static CloseHandlerList handlers;
+  return handlers;
+}
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -36,6 +49,23 @@ void File::remove(const std::string& filename) {
   std::remove(filename.c_str());
 }
 
+void File::addCloseHandler(CloseHandler handler, void* context) {
+  std::lock_guard<std::mutex> lock(close_handlers_latch_);
+  closeHandlers().push_back(std::make_pair(handler, context));
+}
+
+void File::removeCloseHandler(CloseHandler handler, void* context) {
+  std::lock_guard<std::mutex> lock(close_handlers_latch_);
+  CloseHandlerList& handlers = closeHandlers();
+  for (CloseHandlerList::iterator it = handlers.begin();
+       it != handlers.end(); ++it) {
+    if (it->first == handler && it->second == context) {
+      handlers.erase(it);
+      return;
+    }
+  }
+}
+
 bool File::isOpen(const std::string& filename) {
   if (!exists(filename)) {
     return false;
@@ -64,21 +94,44 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
+/**
+ * Returns a generation for a new file, random where the platform has a source
+ * of randomness and the clock otherwise.
+ */
+static std::uint64_t newGeneration() {
+  std::random_device random;
+  std::uint64_t bits = static_cast<std::uint64_t>(random()) << 32 | random();
+  return bits ^ static_cast<std::uint64_t>(
+      std::chrono::system_clock::now().time_since_epoch().count());
+}
+
 File::File(const std::string& name, const bool create_new) : filename_(name) {
   openIfNeeded(create_new);
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         newGeneration() /* generation */};
     writeHeader(header);
   }
 }
 
+std::uint64_t File::generation() const {
+  FileHeader header;
+  if (pread(fd_, &header, sizeof(FileHeader), 0) !=
+      static_cast<ssize_t>(sizeof(FileHeader))) {
+    return 0;
+  }
+  return header.generation;
+}
+
 void File::openIfNeeded(const bool create_new) {
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
     ++open_counts_[filename_];
     stream_ = open_streams_[filename_];
+    fd_ = open_descriptors_[filename_];
+    stream_latch_ = open_latches_[filename_];
   } else {
     std::ios_base::openmode mode =
         std::fstream::in | std::fstream::out | std::fstream::binary;
@@ -99,10 +152,29 @@ void File::openIfNeeded(const bool create_new) {
     stream_.reset(new std::fstream(filename_, mode));
     open_streams_[filename_] = stream_;
     open_counts_[filename_] = 1;
+
+    // a second, read-only handle for positional reads that bypass the stream
+    fd_ = ::open(filename_.c_str(), O_RDONLY);
+    open_descriptors_[filename_] = fd_;
+
+    stream_latch_.reset(new std::mutex());
+    open_latches_[filename_] = stream_latch_;
   }
 }
 
 void File::close() {
+  if (!stream_) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(close_handlers_latch_);
+    CloseHandlerList& handlers = closeHandlers();
+    for (std::size_t i = 0; i < handlers.size(); ++i) {
+      handlers[i].first(this, handlers[i].second);
+    }
+  }
+
 	if(open_counts_[filename_] > 0)
   	--open_counts_[filename_];
 
@@ -112,7 +184,13 @@ void File::close() {
   if (open_counts_[filename_] == 0) {
     open_streams_.erase(filename_);
     open_counts_.erase(filename_);
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+    open_descriptors_.erase(filename_);
+    open_latches_.erase(filename_);
   }
+  fd_ = -1;
 }
 
 FileHeader File::readHeader() const {
@@ -128,6 +206,13 @@ void File::writeHeader(const FileHeader& header) {
   stream_->flush();
 }
 
+void File::writePages(const PageId first_page_number,
+                      const Page* const* pages, const std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    writePage(first_page_number + i, *pages[i]);
+  }
+}
+
 
 
 
@@ -146,6 +231,8 @@ PageFile::PageFile(const std::string& name, const bool create_new)
 }
 
 PageFile::~PageFile() {
+  // close here, while reads still in flight can call checkPage() on this
+  close();
 }
 
 PageFile::PageFile(const PageFile& other)
@@ -163,11 +250,22 @@ PageFile& PageFile::operator=(const PageFile& rhs) {
 }
 
 Page PageFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
   Page new_page;
+  allocatePage(new_page_number, new_page);
+  return new_page;
+}
+
+PageId PageFile::nextPageNumber() const {
+  // Freed pages are handed out again before the file grows
+  FileHeader header = readHeader();
+  return header.num_free_pages > 0 ? header.first_free_page : header.num_pages;
+}
+
+void PageFile::allocatePage(PageId &new_page_number, Page& new_page) {
+  FileHeader header = readHeader();
   Page existing_page;
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
+    readPage(header.first_free_page, new_page, true /* allow_free */);
     new_page.set_page_number(header.first_free_page);
 		new_page_number = new_page.page_number();
     header.first_free_page = new_page.next_page_number();
@@ -202,6 +300,7 @@ Page PageFile::allocatePage(PageId &new_page_number) {
   }
 	else
 	{
+    new_page.initialize();
     new_page.set_page_number(header.num_pages);
 		new_page_number = new_page.page_number();
 
@@ -231,30 +330,48 @@ Page PageFile::allocatePage(PageId &new_page_number) {
     writePage(existing_page.page_number(), existing_page.header_, existing_page);
   }
   writeHeader(header);
-
-  return new_page;
 }
 
 Page PageFile::readPage(const PageId page_number) const {
+  Page page;
+  readPage(page_number, page);
+  return page;
+}
+
+void PageFile::readPage(const PageId page_number, Page& frame) const {
   FileHeader header = readHeader();
 
 	if (page_number >= header.num_pages)
 	{
 		throw InvalidPageException(page_number, filename_);
 	}
-	return readPage(page_number, false /* allow_free */);
+	readPage(page_number, frame, false /* allow_free */);
 }
 
 Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
+  readPage(page_number, page, allow_free);
+  return page;
+}
+
+void PageFile::readPage(const PageId page_number, Page& page,
+                        const bool allow_free) const {
   stream_->seekg(pagePosition(page_number), std::ios::beg);
   stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
   stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
+}
 
-  return page;
+void PageFile::checkPage(const PageId page_number, const Page& frame,
+                         const long bytes_read) const {
+  // a short read means the page lies past the end of the file
+  if (page_number == Page::INVALID_NUMBER ||
+      bytes_read < static_cast<long>(Page::SIZE) || !frame.isUsed() ||
+      frame.page_number() != page_number) {
+    throw InvalidPageException(page_number, filename_);
+  }
 }
 
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
@@ -273,6 +390,30 @@ void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
 	writePage(new_page_number, header, new_page);
 }
 
+void PageFile::writePages(const PageId first_page_number,
+                          const Page* const* pages, const std::size_t count) {
+  // Read all the headers on disk first so the writes go out as one sequential run.
+  std::vector<PageHeader> headers(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    headers[i] = readPageHeader(first_page_number + i);
+    if (headers[i].current_page_number == Page::INVALID_NUMBER) {
+      // Page has been deleted since it was read.
+      throw InvalidPageException(first_page_number + i, filename_);
+    }
+    const PageId next_page_number = headers[i].next_page_number;
+    headers[i] = pages[i]->header_;
+    headers[i].next_page_number = next_page_number;
+  }
+
+  stream_->seekp(pagePosition(first_page_number), std::ios::beg);
+  for (std::size_t i = 0; i < count; ++i) {
+    stream_->write(reinterpret_cast<const char*>(&headers[i]), sizeof(PageHeader));
+    stream_->write(reinterpret_cast<const char*>(&pages[i]->data_[0]),
+                   Page::DATA_SIZE);
+  }
+  stream_->flush();
+}
+
 void PageFile::deletePage(const PageId page_number) {
   FileHeader header = readHeader();
 
@@ -345,6 +486,7 @@ BlobFile::BlobFile(const std::string& name, const bool create_new)
 }
 
 BlobFile::~BlobFile() {
+  close();
 }
 
 BlobFile::BlobFile(const BlobFile& other)
@@ -362,8 +504,18 @@ BlobFile& BlobFile::operator=(const BlobFile& rhs) {
 }
 
 Page BlobFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
 	Page new_page;
+	allocatePage(new_page_number, new_page);
+	return new_page;
+}
+
+PageId BlobFile::nextPageNumber() const {
+	return readHeader().num_pages;
+}
+
+void BlobFile::allocatePage(PageId &new_page_number, Page& new_page) {
+  FileHeader header = readHeader();
+	new_page.initialize();
 
 	new_page_number = header.num_pages;
 
@@ -375,23 +527,42 @@ Page BlobFile::allocatePage(PageId &new_page_number) {
 
 	writePage(new_page_number, new_page);
 	writeHeader(header);
-
-	return new_page;
 }
 
 Page BlobFile::readPage(const PageId page_number) const {
 	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	readPage(page_number, page);
 	return page;
 }
 
+void BlobFile::readPage(const PageId page_number, Page& frame) const {
+	stream_->seekg(pagePosition(page_number), std::ios::beg);
+	stream_->read(reinterpret_cast<char*>(&frame), Page::SIZE);
+}
+
+void BlobFile::checkPage(const PageId page_number, const Page& /* frame */,
+                         const long bytes_read) const {
+	if (bytes_read < static_cast<long>(Page::SIZE))
+	{
+		throw InvalidPageException(page_number, filename_);
+	}
+}
+
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
 	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
 	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
 	stream_->flush();
 }
 
+void BlobFile::writePages(const PageId first_page_number,
+                          const Page* const* pages, const std::size_t count) {
+	stream_->seekp(pagePosition(first_page_number), std::ios::beg);
+	for (std::size_t i = 0; i < count; ++i) {
+		stream_->write(reinterpret_cast<const char*>(pages[i]), Page::SIZE);
+	}
+	stream_->flush();
+}
+
 //delePage should not be called for a blob_file, not supported
 void BlobFile::deletePage(const PageId page_number) {
 	throw InvalidPageException(page_number, filename_);
@@ -11,6 +11,9 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 #include "page.h"
 
@@ -42,6 +45,12 @@ struct FileHeader {
    */
   PageId first_free_page;
 
+  /**
+   * Number picked at random when the file is created. A file created after
+   * another was removed may be given its inode, but not this.
+   */
+  std::uint64_t generation;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -124,6 +133,23 @@ class File {
    */
   virtual Page allocatePage(PageId &new_page_number) = 0;
 
+  /**
+   * Allocates a new page in the file, building it in a caller-provided frame
+   * rather than returning a copy.
+   *
+   * @param new_page_number Number of the new page returned via this variable.
+   * @param frame           Page to build the new page in.
+   */
+  virtual void allocatePage(PageId &new_page_number, Page& frame) = 0;
+
+  /**
+   * Returns the number the next allocatePage() call will give its page, so
+   * that a frame can be picked for it before it is built.
+   *
+   * @return  Number of the next page to be allocated.
+   */
+  virtual PageId nextPageNumber() const = 0;
+
   /**
    * Reads an existing page from the file.
    *
@@ -134,6 +160,17 @@ class File {
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
+  /**
+   * Reads an existing page from the file straight into a caller-provided
+   * frame, without constructing or copying a temporary page.
+   *
+   * @param page_number   Number of page to read.
+   * @param frame         Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  virtual void readPage(const PageId page_number, Page& frame) const = 0;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -143,6 +180,31 @@ class File {
    */
   virtual void writePage(const PageId page_number, const Page& new_page) = 0;
 
+  /**
+   * Writes a run of consecutive pages, the i-th of pages going to page
+   * first_page_number + i. Files override this to position the stream once and
+   * flush once for the whole run; the default writes the pages one by one.
+   *
+   * @param first_page_number Number of the first page to replace.
+   * @param pages             Pages to write, in page number order.
+   * @param count             Number of pages in the run.
+   */
+  virtual void writePages(const PageId first_page_number,
+                          const Page* const* pages, const std::size_t count);
+
+  /**
+   * Checks a page read straight from descriptor() into a frame, as readPage()
+   * checks the pages it reads.
+   *
+   * @param page_number   Number of page read.
+   * @param frame         Page read into.
+   * @param bytes_read    Number of bytes the read returned.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  virtual void checkPage(const PageId page_number, const Page& frame,
+                         const long bytes_read) const = 0;
+
   /**
    * Deletes a page from the file.
    *
@@ -157,6 +219,69 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns a descriptor of the underlying file, open for reading only. It is
+   * shared by every File object of the same file, and positional reads on it
+   * may run alongside each other and alongside the stream, as long as nothing
+   * writes the same page meanwhile.
+   *
+   * @return Read-only file descriptor.
+   */
+  int descriptor() const { return fd_; }
+
+  /**
+   * Returns the number the file was given at random when it was created, read
+   * from its header through descriptor() rather than the stream.
+   *
+   * @return Generation of the file, 0 if the header cannot be read.
+   */
+  std::uint64_t generation() const;
+
+  /**
+   * Returns the latch serializing calls that go through the stream of the
+   * underlying file. The stream is shared by every File object of the same
+   * file, and so is the latch, so I/O on different files runs in parallel.
+   * Callers holding a buffer pool latch may take it, not the other way round.
+   *
+   * @return Latch of the file's stream.
+   */
+  std::mutex& streamLatch() const { return *stream_latch_; }
+
+  /**
+   * Returns the offset of the page with the given number from the beginning
+   * of the file, for positional reads on descriptor().
+   *
+   * @param page_number   Number of page.
+   * @return  Offset of page in file.
+   */
+  static long long pageOffset(const PageId page_number) {
+    return static_cast<long long>(pagePosition(page_number));
+  }
+
+  /**
+   * Function called with every File object as it is closed, along with the
+   * context it was registered with.
+   */
+  typedef void (*CloseHandler)(const File* file, void* context);
+
+  /**
+   * Registers a function to call whenever a File object is closed, so that
+   * state kept by File object does not outlive it and get picked up by a new
+   * object at the same address.
+   *
+   * @param handler   Function to call.
+   * @param context   Passed to the function.
+   */
+  static void addCloseHandler(CloseHandler handler, void* context);
+
+  /**
+   * Unregisters a function registered with addCloseHandler().
+   *
+   * @param handler   Function registered.
+   * @param context   Context it was registered with.
+   */
+  static void removeCloseHandler(CloseHandler handler, void* context);
+
  	/**
    * Returns pageid of first page in the file.
    *
@@ -192,7 +317,7 @@ class File {
   /**
    * Closes the underlying file stream in <stream_>.
    * This method only closes the file if no other File objects exist that access
-   * the same file.
+   * the same file, and does nothing if this object is closed already.
    */
   void close();
 
@@ -212,6 +337,8 @@ class File {
 
   typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
   typedef std::map<std::string, int> CountMap;
+  typedef std::map<std::string, int> DescriptorMap;
+  typedef std::map<std::string, std::shared_ptr<std::mutex> > LatchMap;
 
   /**
    * Streams for opened files.
@@ -223,6 +350,26 @@ class File {
    */
   static CountMap open_counts_;
 
+  /**
+   * Read-only descriptors for opened files.
+   */
+  static DescriptorMap open_descriptors_;
+
+  /**
+   * Stream latches for opened files.
+   */
+  static LatchMap open_latches_;
+
+  typedef std::vector<std::pair<CloseHandler, void*> > CloseHandlerList;
+
+  /**
+   * Functions to call when a File object is closed, and the latch guarding
+   * them. The list is made on first use, as buffer managers constructed
+   * before main() register with it.
+   */
+  static CloseHandlerList& closeHandlers();
+  static std::mutex close_handlers_latch_;
+
   /**
    * Name of the file this object represents.
    */
@@ -233,6 +380,16 @@ class File {
    */
   std::shared_ptr<std::fstream> stream_;
 
+  /**
+   * Read-only descriptor for underlying filesystem object.
+   */
+  int fd_;
+
+  /**
+   * Latch serializing use of <stream_>.
+   */
+  std::shared_ptr<std::mutex> stream_latch_;
+
   friend class FileIterator;
 };
 
@@ -300,6 +457,21 @@ class PageFile : public File {
    */
   Page allocatePage(PageId &new_page_number);
 
+  /**
+   * Allocates a new page in the file, building it in a caller-provided frame.
+   *
+   * @param new_page_number Number of the new page returned via this variable.
+   * @param frame           Page to build the new page in.
+   */
+  void allocatePage(PageId &new_page_number, Page& frame);
+
+  /**
+   * Returns the number the next allocatePage() call will give its page.
+   *
+   * @return  Number of the next page to be allocated.
+   */
+  PageId nextPageNumber() const;
+
   /**
    * Reads an existing page from the file.
    *
@@ -310,6 +482,16 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file straight into a caller-provided frame.
+   *
+   * @param page_number   Number of page to read.
+   * @param frame         Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPage(const PageId page_number, Page& frame) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -319,6 +501,30 @@ class PageFile : public File {
    */
   void writePage(const PageId page_number, const Page& new_page);
 
+  /**
+   * Writes a run of consecutive pages with a single seek and flush, keeping
+   * the next page pointers currently on disk as writePage() does.
+   *
+   * @param first_page_number Number of the first page to replace.
+   * @param pages             Pages to write, in page number order.
+   * @param count             Number of pages in the run.
+   * @throws  InvalidPageException  If any page of the run has been deleted.
+   */
+  void writePages(const PageId first_page_number,
+                  const Page* const* pages, const std::size_t count);
+
+  /**
+   * Checks a page read straight from descriptor() into a frame.
+   *
+   * @param page_number   Number of page read.
+   * @param frame         Page read into.
+   * @param bytes_read    Number of bytes the read returned.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void checkPage(const PageId page_number, const Page& frame,
+                 const long bytes_read) const;
+
   /**
    * Deletes a page from the file.
    *
@@ -358,6 +564,18 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number, const bool allow_free) const;
 
+  /**
+   * Reads a page from the file into the given page, as readPage() above.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.
+   * @param allow_free    Whether to allow reading a free (unused) page.
+   * @throws  InvalidPageException  If the page is free (unused) and
+   *                                allow_free is false.
+   */
+  void readPage(const PageId page_number, Page& page,
+                const bool allow_free) const;
+
   /**
    * Writes a page into the file at the given page number with the given header.
    * This does not ensure that the number in the header equals the position on
@@ -448,6 +666,21 @@ class BlobFile : public File {
    */
   Page allocatePage(PageId &new_page_number);
 
+  /**
+   * Allocates a new page in the file, building it in a caller-provided frame.
+   *
+   * @param new_page_number Number of the new page returned via this variable.
+   * @param frame           Page to build the new page in.
+   */
+  void allocatePage(PageId &new_page_number, Page& frame);
+
+  /**
+   * Returns the number the next allocatePage() call will give its page.
+   *
+   * @return  Number of the next page to be allocated.
+   */
+  PageId nextPageNumber() const;
+
   /**
    * Reads an existing page from the file.
    *
@@ -458,6 +691,16 @@ class BlobFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file straight into a caller-provided frame.
+   *
+   * @param page_number   Number of page to read.
+   * @param frame         Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPage(const PageId page_number, Page& frame) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -467,6 +710,27 @@ class BlobFile : public File {
    */
   void writePage(const PageId page_number, const Page& new_page);
 
+  /**
+   * Writes a run of consecutive pages with a single seek and flush.
+   *
+   * @param first_page_number Number of the first page to replace.
+   * @param pages             Pages to write, in page number order.
+   * @param count             Number of pages in the run.
+   */
+  void writePages(const PageId first_page_number,
+                  const Page* const* pages, const std::size_t count);
+
+  /**
+   * Checks a page read straight from descriptor() into a frame.
+   *
+   * @param page_number   Number of page read.
+   * @param frame         Page read into.
+   * @param bytes_read    Number of bytes the read returned.
+   * @throws  InvalidPageException  If the page doesn't exist in the file.
+   */
+  void checkPage(const PageId page_number, const Page& frame,
+                 const long bytes_read) const;
+
   /**
    * Deletes a page from the file.
    *
@@ -0,0 +1,342 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include "ioEngine.h"
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#if defined(__NR_io_uring_setup) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#endif
+
+// plain reads at an offset came with the same kernel as IORING_FEAT_RW_CUR_POS
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#define BADGERDB_IO_URING 1
+#endif
+
+namespace badgerdb {
+
+/**
+ * Read a whole page at an offset, retrying interrupted and partial reads. Returns the number of bytes read, short
+ * only at the end of the file, or -1.
+ */
+static long readAt(const int fd, Page* frame, const long long offset)
+{
+  char* buffer = reinterpret_cast<char*>(frame);
+  long done = 0;
+  while (done < (long) Page::SIZE)
+  {
+    ssize_t n = pread(fd, buffer + done, Page::SIZE - done, offset + done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return -1;
+    if (n == 0)
+      break;
+    done += n;
+  }
+  return done;
+}
+
+/**
+ * Check a page once its read has finished, returning what the check threw, if anything.
+ */
+static std::exception_ptr checkRead(const IORequest& request, const long bytesRead)
+{
+  try
+  {
+    request.file->checkPage(request.pageNo, *request.frame, bytesRead);
+  }
+  catch(...)
+  {
+    return std::current_exception();
+  }
+  return std::exception_ptr();
+}
+
+IOEngine* IOEngine::create(IOCompletion& completion, const std::uint32_t queueDepth, const std::uint32_t workers)
+{
+  std::uint32_t depth = queueDepth > 0 ? queueDepth : 1;
+
+  URingIOEngine* ring = new URingIOEngine(completion, depth);
+  if (ring->isReady())
+    return ring;
+  delete ring;
+
+  // no io_uring in this kernel, or not allowed to use it
+  return new ThreadPoolIOEngine(completion, depth, workers > 0 ? workers : 1);
+}
+
+//----------------------------------------
+// ThreadPoolIOEngine
+//----------------------------------------
+
+ThreadPoolIOEngine::ThreadPoolIOEngine(IOCompletion& completion, const std::uint32_t queueDepth,
+	const std::uint32_t workers)
+	: completion(completion), queueDepth(queueDepth), inFlight(0), stop(false)
+{
+  for (std::uint32_t i = 0; i < workers; i++)
+    threads.push_back(std::thread(&ThreadPoolIOEngine::worker, this));
+}
+
+ThreadPoolIOEngine::~ThreadPoolIOEngine()
+{
+  {
+    std::lock_guard<std::mutex> lock(latch);
+    stop = true;
+  }
+  work.notify_all();
+
+  // workers finish the queue before they exit
+  for (std::size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+}
+
+void ThreadPoolIOEngine::submit(const IORequest& request)
+{
+  std::unique_lock<std::mutex> lock(latch);
+  while (inFlight >= queueDepth)
+    space.wait(lock);
+
+  inFlight++;
+  pending.push_back(request);
+  work.notify_one();
+}
+
+void ThreadPoolIOEngine::worker()
+{
+  std::unique_lock<std::mutex> lock(latch);
+  while (true)
+  {
+    while (!stop && pending.empty())
+      work.wait(lock);
+    if (pending.empty())
+      return;
+
+    IORequest request = pending.front();
+    pending.pop_front();
+    lock.unlock();
+
+    long bytesRead = readAt(request.file->descriptor(), request.frame, File::pageOffset(request.pageNo));
+    completion.readDone(request, checkRead(request, bytesRead));
+
+    lock.lock();
+    inFlight--;
+    space.notify_one();
+  }
+}
+
+//----------------------------------------
+// URingIOEngine
+//----------------------------------------
+
+#ifdef BADGERDB_IO_URING
+
+/**
+ * User data of the no-op that tells the reaper to exit
+ */
+static const std::uint64_t RING_STOP = 0xffffffffffffffffULL;
+
+URingIOEngine::URingIOEngine(IOCompletion& completion, const std::uint32_t queueDepth)
+	: completion(completion), ringFd(-1), sqRing(NULL), cqRing(NULL), sqEntries(NULL),
+	  sqRingSize(0), cqRingSize(0), sqEntriesSize(0)
+{
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = (int) syscall(__NR_io_uring_setup, queueDepth, &params);
+  if (fd < 0)
+    return;
+  if (!(params.features & IORING_FEAT_RW_CUR_POS))
+  {
+    close(fd);
+    return;
+  }
+
+  // map the submission queue, completion queue and submission entries
+  sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (singleMap)
+    sqRingSize = cqRingSize = sqRingSize > cqRingSize ? sqRingSize : cqRingSize;
+  sqEntriesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  cqRing = singleMap ? sqRing :
+    mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  sqEntries = mmap(NULL, sqEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqEntries == MAP_FAILED)
+  {
+    if (sqEntries != MAP_FAILED)
+      munmap(sqEntries, sqEntriesSize);
+    if (cqRing != MAP_FAILED && cqRing != sqRing)
+      munmap(cqRing, cqRingSize);
+    if (sqRing != MAP_FAILED)
+      munmap(sqRing, sqRingSize);
+    sqRing = cqRing = sqEntries = NULL;
+    close(fd);
+    return;
+  }
+
+  char* sq = static_cast<char*>(sqRing);
+  sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  char* cq = static_cast<char*>(cqRing);
+  cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  cqEntries = cq + params.cq_off.cqes;
+
+  // the kernel may round the queue up, only queueDepth reads are let in at once
+  requests.resize(queueDepth);
+  for (std::uint32_t slot = queueDepth; slot > 0; slot--)
+    freeSlots.push_back(slot - 1);
+
+  ringFd = fd;
+  reaper = std::thread(&URingIOEngine::reap, this);
+}
+
+URingIOEngine::~URingIOEngine()
+{
+  if (ringFd < 0)
+    return;
+
+  {
+    std::unique_lock<std::mutex> lock(latch);
+    while (freeSlots.size() < requests.size())
+      space.wait(lock);
+    push(IORING_OP_NOP, NULL, RING_STOP);
+  }
+  reaper.join();
+
+  munmap(sqEntries, sqEntriesSize);
+  if (cqRing != sqRing)
+    munmap(cqRing, cqRingSize);
+  munmap(sqRing, sqRingSize);
+  close(ringFd);
+}
+
+void URingIOEngine::submit(const IORequest& request)
+{
+  std::unique_lock<std::mutex> lock(latch);
+  while (freeSlots.empty())
+    space.wait(lock);
+
+  std::uint32_t slot = freeSlots.back();
+  freeSlots.pop_back();
+  requests[slot] = request;
+  push(IORING_OP_READ, &requests[slot], slot);
+}
+
+void URingIOEngine::push(const std::uint8_t opcode, const IORequest* request, const std::uint64_t userData)
+{
+  unsigned tail = *sqTail;
+  unsigned index = tail & *sqMask;
+  struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(sqEntries) + index;
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  if (request != NULL)
+  {
+    sqe->fd = request->file->descriptor();
+    sqe->off = (std::uint64_t) File::pageOffset(request->pageNo);
+    sqe->addr = (std::uint64_t) (std::uintptr_t) request->frame;
+    sqe->len = Page::SIZE;
+  }
+  sqe->user_data = userData;
+  sqArray[index] = index;
+  __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+  // hand every entry to the kernel right away, so at most one is ever waiting in the queue
+  while (syscall(__NR_io_uring_enter, ringFd, 1, 0, 0, NULL, 0) < 0 &&
+         (errno == EINTR || errno == EAGAIN || errno == EBUSY))
+    std::this_thread::yield();
+}
+
+void URingIOEngine::reap()
+{
+  const struct io_uring_cqe* cqes = static_cast<const struct io_uring_cqe*>(cqEntries);
+  std::vector<std::pair<std::uint64_t, int> > done;
+  bool stopping = false;
+
+  while (!stopping)
+  {
+    syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+
+    // copy the completions out and give their entries back to the kernel
+    done.clear();
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++)
+    {
+      const struct io_uring_cqe& cqe = cqes[head & *cqMask];
+      done.push_back(std::make_pair((std::uint64_t) cqe.user_data, (int) cqe.res));
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+    for (std::size_t n = 0; n < done.size(); n++)
+    {
+      if (done[n].first == RING_STOP)
+      {
+        stopping = true;
+        continue;
+      }
+
+      std::uint32_t slot = (std::uint32_t) done[n].first;
+      IORequest request;
+      {
+        std::lock_guard<std::mutex> lock(latch);
+        request = requests[slot];
+      }
+
+      // older kernels may return buffered reads short, finish those by hand
+      long bytesRead = done[n].second;
+      if (bytesRead >= 0 && bytesRead < (long) Page::SIZE)
+        bytesRead = readAt(request.file->descriptor(), request.frame, File::pageOffset(request.pageNo));
+      completion.readDone(request, checkRead(request, bytesRead));
+
+      std::lock_guard<std::mutex> lock(latch);
+      freeSlots.push_back(slot);
+      space.notify_all();
+    }
+  }
+}
+
+#else
+
+URingIOEngine::URingIOEngine(IOCompletion& completion, const std::uint32_t queueDepth)
+	: completion(completion), ringFd(-1), sqRing(NULL), cqRing(NULL), sqEntries(NULL),
+	  sqRingSize(0), cqRingSize(0), sqEntriesSize(0)
+{
+}
+
+URingIOEngine::~URingIOEngine()
+{
+}
+
+void URingIOEngine::submit(const IORequest& request)
+{
+}
+
+void URingIOEngine::push(const std::uint8_t opcode, const IORequest* request, const std::uint64_t userData)
+{
+}
+
+void URingIOEngine::reap()
+{
+}
+
+#endif
+
+}
@@ -0,0 +1,224 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+#include "file.h"
+
+namespace badgerdb {
+
+/**
+* @brief A page read submitted to an IOEngine.
+*/
+struct IORequest
+{
+	/**
+	 * File to read the page from
+	 */
+	const File* file;
+
+	/**
+	 * Page to read
+	 */
+	PageId pageNo;
+
+	/**
+	 * Frame to read the page into, which must stay untouched until the read completes
+	 */
+	Page* frame;
+
+	/**
+	 * Handed back with the completion, BufMgr passes the frame number
+	 */
+	std::uint32_t tag;
+};
+
+/**
+* @brief Told when a read submitted to an IOEngine has finished.
+*/
+class IOCompletion
+{
+ public:
+	virtual ~IOCompletion() {}
+
+	/**
+	 * A read has finished and its page has been checked. Called on one of the engine's threads, never with any
+	 * lock of the engine held.
+	 *
+	 * @param request	The request as submitted
+	 * @param error		Null if the page was read, otherwise what reading or checking it threw
+	 */
+	virtual void readDone(const IORequest& request, std::exception_ptr error) = 0;
+};
+
+/**
+* @brief Asynchronous page reads with a submission queue and completions delivered to an IOCompletion.
+*
+* Reads go straight from File::descriptor() into the caller's frame with positional reads, so they need none of
+* the serialization the File streams do and many can be in flight at once. Only reads are asynchronous; pages are
+* still written through the File streams.
+*/
+class IOEngine
+{
+ public:
+	virtual ~IOEngine() {}
+
+	/**
+	 * Create an engine, using io_uring where the kernel supports it and a thread pool otherwise. Destroying the
+	 * engine waits for every submitted read to complete.
+	 *
+	 * @param completion	Told about every finished read
+	 * @param queueDepth	Most reads in flight at once
+	 * @param workers		Threads of the thread pool, if that is what is used
+	 * @return				The engine, owned by the caller
+	 */
+	static IOEngine* create(IOCompletion& completion, const std::uint32_t queueDepth, const std::uint32_t workers);
+
+	/**
+	 * Returns the name of the engine.
+	 */
+	virtual const char* name() const = 0;
+
+	/**
+	 * Queue a read. Only blocks while queueDepth reads are already in flight, so it must not be called with a lock
+	 * the completion takes.
+	 *
+	 * @param request	Read to queue
+	 */
+	virtual void submit(const IORequest& request) = 0;
+};
+
+/**
+* @brief Worker threads taking reads off a queue and doing them with pread.
+*/
+class ThreadPoolIOEngine : public IOEngine
+{
+ public:
+	ThreadPoolIOEngine(IOCompletion& completion, const std::uint32_t queueDepth, const std::uint32_t workers);
+	~ThreadPoolIOEngine();
+	const char* name() const { return "thread pool"; }
+	void submit(const IORequest& request);
+
+ private:
+	IOCompletion& completion;
+	std::uint32_t queueDepth;
+
+	/**
+	 * Guards everything below
+	 */
+	std::mutex latch;
+
+	/**
+	 * Wakes workers when reads are queued or the engine stops, and submitters when a read completes
+	 */
+	std::condition_variable work;
+	std::condition_variable space;
+
+	/**
+	 * Reads not yet picked up by a worker
+	 */
+	std::deque<IORequest> pending;
+
+	/**
+	 * Reads queued or being done
+	 */
+	std::uint32_t inFlight;
+
+	bool stop;
+	std::vector<std::thread> threads;
+
+	/**
+	 * Body of each worker thread
+	 */
+	void worker();
+};
+
+/**
+* @brief Reads submitted to an io_uring ring, with one thread reaping the completion queue.
+*/
+class URingIOEngine : public IOEngine
+{
+ public:
+	URingIOEngine(IOCompletion& completion, const std::uint32_t queueDepth);
+	~URingIOEngine();
+	const char* name() const { return "io_uring"; }
+	void submit(const IORequest& request);
+
+	/**
+	 * Returns true if the ring was set up. If it was not, the engine must not be used.
+	 */
+	bool isReady() const
+	{
+		return ringFd >= 0;
+	}
+
+ private:
+	IOCompletion& completion;
+
+	/**
+	 * The ring, and its queues mapped from the kernel
+	 */
+	int ringFd;
+	void* sqRing;
+	void* cqRing;
+	void* sqEntries;
+	std::size_t sqRingSize;
+	std::size_t cqRingSize;
+	std::size_t sqEntriesSize;
+
+	/**
+	 * Fields of the mapped queues
+	 */
+	unsigned* sqTail;
+	unsigned* sqMask;
+	unsigned* sqArray;
+	unsigned* cqHead;
+	unsigned* cqTail;
+	unsigned* cqMask;
+	void* cqEntries;
+
+	/**
+	 * Guards the submission queue and everything below
+	 */
+	std::mutex latch;
+
+	/**
+	 * Wakes submitters and the destructor when a read completes
+	 */
+	std::condition_variable space;
+
+	/**
+	 * Request in each submission slot, and the slots not in flight
+	 */
+	std::vector<IORequest> requests;
+	std::vector<std::uint32_t> freeSlots;
+
+	/**
+	 * Thread reaping completions
+	 */
+	std::thread reaper;
+
+	/**
+	 * Put an entry on the submission queue and hand it to the kernel. Called with latch held.
+	 */
+	void push(const std::uint8_t opcode, const IORequest* request, const std::uint64_t userData);
+
+	/**
+	 * Body of the reaper thread
+	 */
+	void reap();
+};
+
+}
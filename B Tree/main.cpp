@@ -6,6 +6,10 @@
  */
 
 #include <vector>
+#include <chrono>
+#include <climits>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "btree.h"
 #include "page.h"
 #include "filescan.h"
@@ -19,6 +23,7 @@
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -72,6 +77,7 @@ void createRelationRandom();
 void createRelationRandom(int size);
 void intTests();
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+long long intAggregate(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, AggKind kind);
 void indexTests();
 void test1();
 void test2();
@@ -83,6 +89,18 @@ void test7_out_of_bound();
 void test8_sized_relation_forward();
 void test9_sized_relation_backward();
 void test10_sized_relation_random();
+void test11_inner_node_layout();
+void test12_replacement_policies();
+void test13_named_pools();
+void test14_append_after_read_ahead();
+void test15_leaf_split_fill();
+void test16_bloom_filter();
+void test17_borrowed_frames();
+void test18_page_codec();
+void test19_shared_pool();
+void countSharedPages(const std::string& segment, const std::string& name, const std::vector<PageId>& pageNos,
+                      const std::vector<RecordId>& rids, const int first, const int rounds);
+int readSharedCount(const std::string& segment, const std::string& name, const PageId pageNo, const RecordId& rid);
 void errorTests();
 void deleteRelation();
 
@@ -157,6 +175,15 @@ int main(int argc, char **argv)
     test8_sized_relation_forward();
     test9_sized_relation_backward();
     test10_sized_relation_random();
+    test11_inner_node_layout();
+    test12_replacement_policies();
+    test13_named_pools();
+    test14_append_after_read_ahead();
+    test15_leaf_split_fill();
+    test16_bloom_filter();
+    test17_borrowed_frames();
+    test18_page_codec();
+    test19_shared_pool();
     errorTests();
 
   return 1;
@@ -316,6 +343,552 @@ void test10_sized_relation_random(){
     indexTests();
     deleteRelation();
 }
+/**
+ * Self designed test11 comparing point lookups on the sorted array and the cache blocked non leaf layouts
+ */
+void test11_inner_node_layout(){
+    std::cout << "---------------------------" << std::endl;
+    std::cout << "Benchmark Inner Node Layout" << std::endl;
+    const int size = 62500;
+    const int lookups = 200000;
+    const NodeLayout layouts[] = {SORTED_ARRAY, CACHE_BLOCKED};
+    const char *layoutNames[] = {"sorted array", "cache blocked"};
+    createRelationForward(size);
+
+    for (int l = 0; l < 2; l++) {
+        {
+            BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i), INTEGER, false, layouts[l]);
+
+            // Same keys for both layouts
+            srandom(1);
+            int found = 0;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int n = 0; n < lookups; n++) {
+                int key = (int) (random() % size);
+                try {
+                    index.startScan(&key, GTE, &key, LTE);
+                    index.endScan();
+                    found++;
+                }
+                catch(NoSuchKeyFoundException e) {
+                }
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << layoutNames[l] << ": " << lookups << " lookups in " << elapsed.count() << " s" << std::endl;
+            checkPassFail(found, lookups)
+        }
+        File::remove(intIndexName);
+    }
+    deleteRelation();
+}
+
+/**
+ * Self designed test12 comparing buffer hit ratios of the replacement policies on index lookups mixed with full scans
+ */
+void test12_replacement_policies(){
+    std::cout << "------------------------------" << std::endl;
+    std::cout << "Benchmark Replacement Policies" << std::endl;
+    const int size = 20000;
+    const int rounds = 20;
+    const int lookups = 500;
+    const std::uint32_t poolSize = 64;
+    const ReplacementKind kinds[] = {REPL_CLOCK, REPL_LRU2, REPL_2Q, REPL_ARC};
+    createRelationForward(size);
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i), INTEGER);
+    }
+
+    for (int k = 0; k < 4; k++) {
+        // A pool smaller than the relation, so every scan has to cycle through it
+        BufMgr *pool = new BufMgr(poolSize, 1, kinds[k]);
+        int found = 0;
+        {
+            BTreeIndex index(relationName, intIndexName, pool, offsetof(tuple, i), INTEGER);
+
+            // Same lookups for every policy
+            srandom(1);
+            for (int r = 0; r < rounds; r++) {
+                for (int n = 0; n < lookups; n++) {
+                    int key = (int) (random() % size);
+                    try {
+                        index.startScan(&key, GTE, &key, LTE);
+                        index.scanNext(rid);
+                        index.endScan();
+                        found++;
+                    }
+                    catch(NoSuchKeyFoundException e) {
+                    }
+                }
+
+                FileScan fscan(relationName, pool);
+                try {
+                    RecordId scanRid;
+                    while (1)
+                        fscan.scanNext(scanRid);
+                }
+                catch(EndOfFileException e) {
+                }
+            }
+        }
+
+        BufStats &stats = pool->getBufStats();
+        std::cout << pool->getPolicyName() << ": " << stats.accesses << " accesses, " << stats.diskreads
+                  << " reads, hit ratio " << 1.0 - (double) stats.diskreads / stats.accesses << std::endl;
+        delete pool;
+        checkPassFail(found, rounds * lookups)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+/**
+ * Self designed test13 keeping the index in its own pool, where full scans of the relation cannot evict it
+ */
+void test13_named_pools(){
+    std::cout << "------------------------------" << std::endl;
+    std::cout << "Index And Heap In Named Pools" << std::endl;
+    const int size = 20000;
+    const int rounds = 5;
+    const int lookups = 500;
+    createRelationForward(size);
+
+    int found = 0;
+    int laterIndexReads = 0;
+    {
+        BufPoolSet pools;
+        pools.createPool("heap", 16);
+        BufMgr *indexPool = pools.createPool("index", 64, 1, REPL_LRU2);
+        pools.assignFile(BTreeIndex::indexFileName(relationName, offsetof(tuple, i)), "index");
+
+        BTreeIndex index(relationName, intIndexName, &pools, offsetof(tuple, i), INTEGER);
+        srandom(1);
+        for (int r = 0; r < rounds; r++) {
+            // The whole index fits in its pool, so only the first round should read it
+            if (r == 1)
+                indexPool->clearBufStats();
+            for (int n = 0; n < lookups; n++) {
+                int key = (int) (random() % size);
+                try {
+                    index.startScan(&key, GTE, &key, LTE);
+                    index.scanNext(rid);
+                    index.endScan();
+                    found++;
+                }
+                catch(NoSuchKeyFoundException e) {
+                }
+            }
+
+            FileScan fscan(relationName, pools.poolFor(relationName));
+            try {
+                RecordId scanRid;
+                while (1)
+                    fscan.scanNext(scanRid);
+            }
+            catch(EndOfFileException e) {
+            }
+        }
+        laterIndexReads = indexPool->getBufStats().diskreads;
+        std::cout << "heap pool: " << pools.getPool("heap")->getBufStats().diskreads << " reads, index pool: "
+                  << laterIndexReads << " reads after the first round" << std::endl;
+    }
+    checkPassFail(found, rounds * lookups)
+    checkPassFail(laterIndexReads, 0)
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+/**
+ * Self designed test14 appending pages right after reading up to the end of the file, so that the pool may be
+ * reading ahead, or have read ahead, the page about to be allocated
+ */
+void test14_append_after_read_ahead(){
+    std::cout << "------------------------------" << std::endl;
+    std::cout << "Append After Read Ahead" << std::endl;
+    const std::string name = "relAppend";
+    const int rounds = 200;
+    try {
+        File::remove(name);
+    }
+    catch(FileNotFoundException e) {
+    }
+
+    int appended = 0;
+    {
+        PageFile file = PageFile::create(name);
+        BufMgr *pool = new BufMgr(32);
+        PageId pageNo;
+        Page *page;
+        pool->allocPage(&file, pageNo, page);
+        pool->unPinPage(&file, pageNo, true);
+
+        for (int r = 0; r < rounds; r++) {
+            // A sequential run up to the last page, then a read ahead of the page after it
+            for (PageId p = pageNo > 5 ? pageNo - 5 : 1; p <= pageNo; p++) {
+                pool->readPage(&file, p, page);
+                pool->unPinPage(&file, p, false);
+            }
+            pool->prefetch(&file, pageNo + 1, 1);
+
+            pool->allocPage(&file, pageNo, page);
+            sprintf(record1.s, "%05d appended record", r);
+            record1.i = r;
+            record1.d = (double)r;
+            std::string data(reinterpret_cast<char*>(&record1), sizeof(record1));
+            RecordId appendedRid = page->insertRecord(data);
+            pool->unPinPage(&file, pageNo, true);
+
+            // The page must have gone to its own frame, so flushing writes it
+            pool->flushFile(&file);
+            if (file.readPage(pageNo).getRecord(appendedRid) == data)
+                appended++;
+        }
+        delete pool;
+    }
+    checkPassFail(appended, rounds)
+    File::remove(name);
+}
+
+/**
+ * Self designed test15 checking the leaf counts and fill factors left by the splits. An ascending load splits the
+ * rightmost leaf APPENDSPLITRATIO to the left, descending and random loads still split the leaves in half
+ */
+void test15_leaf_split_fill(){
+    std::cout << "----------------------" << std::endl;
+    std::cout << "Leaf Split Fill Factor" << std::endl;
+    IndexStats stats;
+
+    // Every leaf but the last keeps the left part of an append split
+    const int appendKeep = (int) (INTARRAYLEAFSIZE * APPENDSPLITRATIO);
+    createRelationForward();
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i), INTEGER);
+        index.getStats(stats);
+        std::cout << "Ascending: " << stats.numLeafPages << " leaves, fill factor " << stats.leafFillFactor << std::endl;
+        checkPassFail(stats.numLeafPages, (relationSize + appendKeep - 1) / appendKeep)
+        bool appendFill = stats.leafFillFactor > APPENDSPLITRATIO - 0.1;
+        checkPassFail(appendFill, true)
+        checkPassFail(intScan(&index, 25, GT, 40, LT), 14)
+        checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+
+    // Every leaf but the first keeps the right half of a split
+    const int halfKeep = INTARRAYLEAFSIZE / 2;
+    createRelationBackward();
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i), INTEGER);
+        index.getStats(stats);
+        std::cout << "Descending: " << stats.numLeafPages << " leaves, fill factor " << stats.leafFillFactor << std::endl;
+        checkPassFail(stats.numLeafPages, (relationSize - halfKeep - 1) / halfKeep + 1)
+        bool halfFill = stats.leafFillFactor < 0.6;
+        checkPassFail(halfFill, true)
+        checkPassFail(intScan(&index, 25, GT, 40, LT), 14)
+        checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+
+    // Random inserts split all over the tree, every leaf still holds at least the half it kept
+    createRelationRandom();
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i), INTEGER);
+        index.getStats(stats);
+        std::cout << "Random: " << stats.numLeafPages << " leaves, fill factor " << stats.leafFillFactor << std::endl;
+        bool halfFull = stats.numLeafPages <= relationSize / halfKeep;
+        checkPassFail(halfFull, true)
+        checkPassFail(intScan(&index, 25, GT, 40, LT), 14)
+        checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000)
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+}
+
+/**
+ * Self designed test16 looking up every key of an index with a Bloom filter, after enough inserts to rebuild the
+ * filter and again after the index and its filter are reopened from disk
+ */
+void test16_bloom_filter(){
+    std::cout << "------------------" << std::endl;
+    std::cout << "Bloom Filter Index" << std::endl;
+    // Four times the keys of the load overflow the filter sized for it, so the inserts rebuild it
+    const int total = relationSize * 5;
+    createRelationRandom();
+
+    for (int round = 0; round < 2; round++) {
+        int found = 0;
+        {
+            BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i), INTEGER, true);
+            if (round == 0) {
+                for (int key = relationSize; key < total; key++) {
+                    RecordId keyRid;
+                    keyRid.page_number = 1;
+                    keyRid.slot_number = (SlotId) (key % 100 + 1);
+                    index.insertEntry(&key, keyRid);
+                }
+            }
+
+            for (int key = 0; key < total; key++) {
+                try {
+                    index.startScan(&key, GTE, &key, LTE);
+                    index.scanNext(rid);
+                    index.endScan();
+                    found++;
+                }
+                catch(NoSuchKeyFoundException e) {
+                }
+            }
+        }
+        std::cout << (round == 0 ? "After inserts: " : "After reopen: ") << found << " keys found" << std::endl;
+        checkPassFail(found, total)
+    }
+
+    File::remove(intIndexName);
+    File::remove(intIndexName + ".bloom");
+    deleteRelation();
+}
+
+/**
+ * Self designed test17 pinning as many pages as a sharded pool has frames. The pages fall in the shards unevenly,
+ * so the shards that fill up first borrow frames from the others, and only one page more than the pool holds fails
+ */
+void test17_borrowed_frames(){
+    std::cout << "----------------------" << std::endl;
+    std::cout << "Borrowed Shard Frames" << std::endl;
+    const std::string name = "relBorrow";
+    const int frames = 32;
+    try {
+        File::remove(name);
+    }
+    catch(FileNotFoundException e) {
+    }
+
+    int pinned = 0;
+    int kept = 0;
+    bool exceeded = false;
+    {
+        PageFile file = PageFile::create(name);
+        BufMgr *pool = new BufMgr(frames, 4);
+        std::vector<PageId> pageNos;
+        std::vector<RecordId> rids;
+        Page *page;
+        for (int i = 0; i < frames; i++) {
+            PageId pageNo;
+            pool->allocPage(&file, pageNo, page);
+            record1.i = i;
+            std::string data(reinterpret_cast<char*>(&record1), sizeof(record1));
+            rids.push_back(page->insertRecord(data));
+            pageNos.push_back(pageNo);
+            pinned++;
+        }
+        try {
+            PageId pageNo;
+            pool->allocPage(&file, pageNo, page);
+        }
+        catch(BufferExceededException e) {
+            exceeded = true;
+        }
+        for (int i = 0; i < frames; i++)
+            pool->unPinPage(&file, pageNos[i], true);
+
+        // The pages in borrowed frames are written back like the rest
+        pool->flushFile(&file);
+        for (int i = 0; i < frames; i++) {
+            std::string data = file.readPage(pageNos[i]).getRecord(rids[i]);
+            if (reinterpret_cast<const RECORD*>(data.data())->i == i)
+                kept++;
+        }
+        delete pool;
+    }
+    checkPassFail(pinned, frames)
+    checkPassFail(exceeded, true)
+    checkPassFail(kept, frames)
+    File::remove(name);
+}
+
+/**
+ * Self designed test18 compressing pages the way the second tier does and checking they come back byte for byte:
+ * random bytes, which do not compress, a zero-filled page and every page of a real index
+ */
+void test18_page_codec(){
+    std::cout << "---------------------" << std::endl;
+    std::cout << "Page Codec Round Trip" << std::endl;
+    std::vector<std::string> pages;
+    std::string randomPage(Page::SIZE, '\0');
+    srandom(1);
+    for (std::size_t n = 0; n < randomPage.size(); n++)
+        randomPage[n] = (char) random();
+    pages.push_back(randomPage);
+    pages.push_back(std::string(Page::SIZE, '\0'));
+
+    createRelationRandom();
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i), INTEGER);
+    }
+    {
+        BlobFile indexFile(intIndexName, false);
+        for (PageId pageNo = 1; pageNo < indexFile.nextPageNumber(); pageNo++) {
+            Page page = indexFile.readPage(pageNo);
+            pages.push_back(std::string(reinterpret_cast<const char*>(&page), Page::SIZE));
+        }
+    }
+    File::remove(intIndexName);
+    deleteRelation();
+
+    // Room for pages that grow, random bytes do
+    std::vector<char> compressed(2 * Page::SIZE);
+    std::vector<char> restored(Page::SIZE);
+    int roundTrips = 0;
+    for (std::size_t n = 0; n < pages.size(); n++) {
+        std::size_t length = PageCodec::compress(pages[n].data(), Page::SIZE, &compressed[0], compressed.size());
+        if (length > 0 && PageCodec::decompress(&compressed[0], length, &restored[0], Page::SIZE) &&
+            std::string(&restored[0], Page::SIZE) == pages[n])
+            roundTrips++;
+    }
+    std::cout << pages.size() - 2 << " index pages" << std::endl;
+    int total = (int) pages.size();
+    checkPassFail(roundTrips, total)
+
+    // The second tier keeps only pages that get smaller, a zero-filled page by far
+    bool randomKept = PageCodec::compress(pages[0].data(), Page::SIZE, &compressed[0], Page::SIZE - 1) > 0;
+    bool zeroSmall = PageCodec::compress(pages[1].data(), Page::SIZE, &compressed[0], Page::SIZE - 1) < Page::SIZE / 64;
+    checkPassFail(randomKept, false)
+    checkPassFail(zeroSmall, true)
+}
+
+/**
+ * Self designed test19 counting up pages from two processes at once through one shared pool, each process its own
+ * half of the pages. Then the file is removed and created again, likely on the same inode while the old file's pages
+ * are still in the segment, and another process must read the new file's page rather than the old one
+ */
+void test19_shared_pool(){
+    std::cout << "------------------" << std::endl;
+    std::cout << "Shared Buffer Pool" << std::endl;
+    const std::string segment = "/badgerdb_test19";
+    const std::string name = "relShared";
+    const int numPages = 16;
+    const int rounds = 200;
+    SharedBufPool::remove(segment);
+    try {
+        File::remove(name);
+    }
+    catch(FileNotFoundException e) {
+    }
+
+    std::vector<PageId> pageNos;
+    std::vector<RecordId> rids;
+    {
+        PageFile file = PageFile::create(name);
+        for (int i = 0; i < numPages; i++) {
+            PageId pageNo;
+            Page page = file.allocatePage(pageNo);
+            record1.i = 0;
+            rids.push_back(page.insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1))));
+            file.writePage(pageNo, page);
+            pageNos.push_back(pageNo);
+        }
+    }
+
+    // The child takes the odd pages, this process the even ones
+    std::cout.flush();
+    pid_t child = fork();
+    if (child == 0) {
+        try {
+            countSharedPages(segment, name, pageNos, rids, 1, rounds);
+        }
+        catch(...) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+    countSharedPages(segment, name, pageNos, rids, 0, rounds);
+    int status = -1;
+    waitpid(child, &status, 0);
+    checkPassFail(status, 0)
+
+    // Through the pool and on disk, every page has all its counts
+    int counted = 0;
+    int written = 0;
+    {
+        PageFile file = PageFile::open(name);
+        for (int i = 0; i < numPages; i++) {
+            if (readSharedCount(segment, name, pageNos[i], rids[i]) == rounds)
+                counted++;
+            std::string data = file.readPage(pageNos[i]).getRecord(rids[i]);
+            if (reinterpret_cast<const RECORD*>(data.data())->i == rounds)
+                written++;
+        }
+    }
+    checkPassFail(counted, numPages)
+    checkPassFail(written, numPages)
+
+    // The new file's first page has the same number and record id as the old one's, with another count
+    File::remove(name);
+    {
+        PageFile file = PageFile::create(name);
+        PageId pageNo;
+        Page page = file.allocatePage(pageNo);
+        record1.i = -1;
+        page.insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+        file.writePage(pageNo, page);
+    }
+    std::cout.flush();
+    child = fork();
+    if (child == 0) {
+        try {
+            _exit(readSharedCount(segment, name, pageNos[0], rids[0]) == -1 ? 0 : 1);
+        }
+        catch(...) {
+            _exit(1);
+        }
+    }
+    status = -1;
+    waitpid(child, &status, 0);
+    checkPassFail(status, 0)
+
+    SharedBufPool::remove(segment);
+    File::remove(name);
+}
+
+/**
+ * Add one to the count on every other page, starting with the first given, a number of times over through a shared
+ * pool, and write the pages back
+ */
+void countSharedPages(const std::string& segment, const std::string& name, const std::vector<PageId>& pageNos,
+                      const std::vector<RecordId>& rids, const int first, const int rounds)
+{
+    BufMgr pool(segment, 64);
+    PageFile file = PageFile::open(name);
+    for (int round = 0; round < rounds; round++) {
+        for (std::size_t i = first; i < pageNos.size(); i += 2) {
+            Page *page;
+            pool.readPage(&file, pageNos[i], page);
+            std::string data = page->getRecord(rids[i]);
+            RECORD counted = *reinterpret_cast<const RECORD*>(data.data());
+            counted.i++;
+            page->updateRecord(rids[i], std::string(reinterpret_cast<char*>(&counted), sizeof(counted)));
+            pool.unPinPage(&file, pageNos[i], true);
+        }
+    }
+    pool.flushFile(&file);
+}
+
+/**
+ * Returns the count on a page read through a shared pool
+ */
+int readSharedCount(const std::string& segment, const std::string& name, const PageId pageNo, const RecordId& rid)
+{
+    BufMgr pool(segment, 64);
+    PageFile file = PageFile::open(name);
+    Page *page;
+    pool.readPage(&file, pageNo, page);
+    std::string data = page->getRecord(rid);
+    int count = reinterpret_cast<const RECORD*>(data.data())->i;
+    pool.unPinPage(&file, pageNo, false);
+    pool.flushFile(&file);
+    return count;
+}
+
 // -----------------------------------------------------------------------------
 // createRelationForward
 // -----------------------------------------------------------------------------
@@ -527,6 +1100,74 @@ void intTests()
 	checkPassFail(intScan(&index,0,GT,1,LT), 0)
 	checkPassFail(intScan(&index,300,GT,400,LT), 99)
 	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+
+	// same ranges answered from the index alone
+	checkPassFail(intAggregate(&index,25,GT,40,LT,AGG_COUNT), 14)
+	checkPassFail(intAggregate(&index,20,GTE,35,LTE,AGG_SUM), 440)
+	checkPassFail(intAggregate(&index,-3,GT,3,LT,AGG_MIN), 0)
+	checkPassFail(intAggregate(&index,996,GT,1001,LT,AGG_MAX), 1000)
+	checkPassFail(intAggregate(&index,0,GT,1,LT,AGG_COUNT), 0)
+	checkPassFail(intAggregate(&index,3000,GTE,4000,LT,AGG_SUM), 3499500)
+
+	// MIN of a range open to the right stops at its first key instead of walking every leaf after it
+	int accessesBefore = bufMgr->getBufStats().accesses;
+	checkPassFail(intAggregate(&index,10,GTE,INT_MAX,LTE,AGG_MIN), 10)
+	int minAccesses = bufMgr->getBufStats().accesses - accessesBefore;
+	std::cout << "Buffer pool accesses for MIN: " << minAccesses << std::endl;
+	bool stoppedEarly = minAccesses <= 3;
+	checkPassFail(stoppedEarly, true)
+
+	// MAX reads one page per level, also when highVal falls on a leaf boundary or the range is empty
+	IndexStats stats;
+	index.getStats(stats);
+	int maxAccesses = 0;
+	int maxMismatches = 0;
+	for (int key = 1; key < 1000; key++) {
+		int lowVal = 0;
+		int highVal = key;
+		accessesBefore = bufMgr->getBufStats().accesses;
+		if (index.aggregateRange(&lowVal, GTE, &highVal, LT, AGG_MAX) != key - 1)
+			maxMismatches++;
+		int accesses = bufMgr->getBufStats().accesses - accessesBefore;
+		maxAccesses = accesses > maxAccesses ? accesses : maxAccesses;
+
+		lowVal = key - 1;
+		accessesBefore = bufMgr->getBufStats().accesses;
+		try {
+			index.aggregateRange(&lowVal, GT, &highVal, LT, AGG_MAX);
+			maxMismatches++;
+		}
+		catch(NoSuchKeyFoundException e) {
+		}
+		accesses = bufMgr->getBufStats().accesses - accessesBefore;
+		maxAccesses = accesses > maxAccesses ? accesses : maxAccesses;
+	}
+	std::cout << "Most buffer pool accesses for MAX: " << maxAccesses << std::endl;
+	checkPassFail(maxMismatches, 0)
+	checkPassFail(maxAccesses, stats.height)
+}
+
+long long intAggregate(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, AggKind kind)
+{
+  const char* names[] = { "MIN", "MAX", "COUNT", "SUM" };
+  std::cout << names[kind] << " over ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+
+  long long result;
+	try
+	{
+		result = index->aggregateRange(&lowVal, lowOp, &highVal, highOp, kind);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+    std::cout << std::endl << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+  std::cout << ": " << result << std::endl << std::endl;
+	return result;
 }
 
 int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
@@ -0,0 +1,97 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "numa.h"
+
+namespace badgerdb {
+
+/**
+ * MPOL_PREFERRED of <linux/mempolicy.h>
+ */
+static const int MEMORY_POLICY_PREFERRED = 1;
+
+/**
+ * Parse a sysfs list such as "0-3,8-11" into the numbers it holds. Returns an empty list if the file cannot be read.
+ */
+static std::vector<int> readList(const std::string& path)
+{
+  std::vector<int> numbers;
+  std::ifstream in(path.c_str());
+  std::string line;
+  if (!std::getline(in, line))
+    return numbers;
+
+  std::istringstream ranges(line);
+  std::string range;
+  while (std::getline(ranges, range, ','))
+  {
+    int first, last;
+    char dash;
+    std::istringstream parts(range);
+    if (!(parts >> first))
+      continue;
+    if (!(parts >> dash >> last))
+      last = first;
+    for (int n = first; n <= last; n++)
+      numbers.push_back(n);
+  }
+  return numbers;
+}
+
+NumaTopology::NumaTopology()
+{
+  nodeIds = readList("/sys/devices/system/node/online");
+  if (nodeIds.empty())
+    nodeIds.push_back(0);
+
+  for (std::uint32_t node = 0; node < nodeIds.size(); node++)
+  {
+    std::ostringstream path;
+    path << "/sys/devices/system/node/node" << nodeIds[node] << "/cpulist";
+    std::vector<int> cpus = readList(path.str());
+    for (std::size_t n = 0; n < cpus.size(); n++)
+    {
+      if ((std::size_t) cpus[n] >= cpuNodes.size())
+        cpuNodes.resize(cpus[n] + 1, 0);
+      cpuNodes[cpus[n]] = node;
+    }
+  }
+}
+
+const NumaTopology& NumaTopology::system()
+{
+  static const NumaTopology topology;
+  return topology;
+}
+
+std::uint32_t NumaTopology::currentNode() const
+{
+  if (nodeIds.size() == 1)
+    return 0;
+  int cpu = sched_getcpu();
+  return cpu >= 0 && (std::size_t) cpu < cpuNodes.size() ? cpuNodes[cpu] : 0;
+}
+
+bool NumaTopology::bind(void* addr, const std::size_t bytes, const std::uint32_t node) const
+{
+#ifdef SYS_mbind
+  const std::size_t bitsPerWord = 8 * sizeof(unsigned long);
+  std::vector<unsigned long> mask(nodeIds[node] / bitsPerWord + 1, 0);
+  mask[nodeIds[node] / bitsPerWord] |= 1UL << (nodeIds[node] % bitsPerWord);
+  return syscall(SYS_mbind, addr, bytes, MEMORY_POLICY_PREFERRED, &mask[0], mask.size() * bitsPerWord + 1, 0) == 0;
+#else
+  return false;
+#endif
+}
+
+}
@@ -0,0 +1,68 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+* @brief The NUMA nodes of the machine as read from sysfs, and placing memory on them.
+*
+* Nodes are numbered from 0 here even if the system skips numbers. A machine without NUMA, or one whose sysfs
+* cannot be read, looks like a single node holding every CPU.
+*/
+class NumaTopology
+{
+ public:
+	/**
+	 * Returns the topology of the machine, read on first use.
+	 */
+	static const NumaTopology& system();
+
+	/**
+	 * Returns the number of nodes, at least 1
+	 */
+	std::uint32_t getNumNodes() const
+	{
+		return (std::uint32_t) nodeIds.size();
+	}
+
+	/**
+	 * Returns the node of the CPU the calling thread is running on, 0 if it cannot be told.
+	 */
+	std::uint32_t currentNode() const;
+
+	/**
+	 * Have memory placed on a node when it is first touched. The node is preferred rather than required, so that
+	 * a node running out of memory falls back to another instead of failing.
+	 *
+	 * @param addr		Start of the memory, aligned to a page
+	 * @param bytes		Length of the memory
+	 * @param node		Node to place it on
+	 * @return			False if the memory could not be bound, it is then placed as the system likes
+	 */
+	bool bind(void* addr, const std::size_t bytes, const std::uint32_t node) const;
+
+ private:
+	NumaTopology();
+
+	/**
+	 * System number of each node
+	 */
+	std::vector<int> nodeIds;
+
+	/**
+	 * Node of each CPU, by CPU number
+	 */
+	std::vector<std::uint32_t> cpuNodes;
+};
+
+}
@@ -0,0 +1,282 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstring>
+#include "pageCache.h"
+
+namespace badgerdb {
+
+//----------------------------------------
+// PageCodec
+//----------------------------------------
+
+const std::size_t PageCodec::MIN_MATCH;
+
+/**
+ * Bits of the hash of four bytes used to find earlier occurrences
+ */
+static const int HASH_BITS = 12;
+
+/**
+ * Matches may not start this close to the end, so the last sequence always has a few literals
+ */
+static const std::size_t END_LITERALS = 5;
+
+static std::uint32_t read32(const char* p)
+{
+  std::uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+/**
+ * Write the extra bytes of a length that did not fit its nibble. Returns false if dst is full.
+ */
+static bool writeLength(std::size_t length, char* dst, std::size_t& op, const std::size_t dstCap)
+{
+  for (; length >= 255; length -= 255)
+  {
+    if (op >= dstCap)
+      return false;
+    dst[op++] = (char) 255;
+  }
+  if (op >= dstCap)
+    return false;
+  dst[op++] = (char) length;
+  return true;
+}
+
+/**
+ * Write one sequence: literals from src + anchor, then a match unless matchLen is 0. Returns false if dst is full.
+ */
+static bool writeSequence(const char* src, const std::size_t anchor, const std::size_t literals,
+                          const std::size_t offset, const std::size_t matchLen,
+                          char* dst, std::size_t& op, const std::size_t dstCap)
+{
+  std::size_t matchCode = matchLen > 0 ? matchLen - PageCodec::MIN_MATCH : 0;
+  if (op >= dstCap)
+    return false;
+  dst[op++] = (char) (((literals < 15 ? literals : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+  if (literals >= 15 && !writeLength(literals - 15, dst, op, dstCap))
+    return false;
+
+  if (op + literals > dstCap)
+    return false;
+  memcpy(dst + op, src + anchor, literals);
+  op += literals;
+  if (matchLen == 0)
+    return true;
+
+  if (op + 2 > dstCap)
+    return false;
+  dst[op++] = (char) (offset & 0xff);
+  dst[op++] = (char) (offset >> 8);
+  return matchCode < 15 || writeLength(matchCode - 15, dst, op, dstCap);
+}
+
+std::size_t PageCodec::compress(const char* src, const std::size_t srcLen, char* dst, const std::size_t dstCap)
+{
+  // position of the last four bytes seen with each hash, plus one so that zero means none
+  std::uint16_t table[1 << HASH_BITS];
+  memset(table, 0, sizeof(table));
+
+  std::size_t ip = 0;
+  std::size_t anchor = 0;
+  std::size_t op = 0;
+  while (ip + MIN_MATCH + END_LITERALS <= srcLen)
+  {
+    std::uint32_t sequence = read32(src + ip);
+    std::uint32_t h = (sequence * 2654435761u) >> (32 - HASH_BITS);
+    std::size_t candidate = table[h];
+    table[h] = (std::uint16_t) (ip + 1);
+    if (candidate == 0 || read32(src + candidate - 1) != sequence)
+    {
+      ip++;
+      continue;
+    }
+
+    // extend the match as far as it goes, overlapping runs included
+    std::size_t ref = candidate - 1;
+    std::size_t length = MIN_MATCH;
+    while (ip + length < srcLen - END_LITERALS && src[ref + length] == src[ip + length])
+      length++;
+
+    if (!writeSequence(src, anchor, ip - anchor, ip - ref, length, dst, op, dstCap))
+      return 0;
+    ip += length;
+    anchor = ip;
+  }
+
+  if (!writeSequence(src, anchor, srcLen - anchor, 0, 0, dst, op, dstCap))
+    return 0;
+  return op;
+}
+
+/**
+ * Read the extra bytes of a length whose nibble was 15. Returns false if src runs out.
+ */
+static bool readLength(const char* src, std::size_t& ip, const std::size_t srcLen, std::size_t& length)
+{
+  unsigned char b;
+  do
+  {
+    if (ip >= srcLen)
+      return false;
+    b = (unsigned char) src[ip++];
+    length += b;
+  } while (b == 255);
+  return true;
+}
+
+bool PageCodec::decompress(const char* src, const std::size_t srcLen, char* dst, const std::size_t dstLen)
+{
+  std::size_t ip = 0;
+  std::size_t op = 0;
+  while (ip < srcLen)
+  {
+    unsigned char token = (unsigned char) src[ip++];
+    std::size_t literals = token >> 4;
+    if (literals == 15 && !readLength(src, ip, srcLen, literals))
+      return false;
+    if (ip + literals > srcLen || op + literals > dstLen)
+      return false;
+    memcpy(dst + op, src + ip, literals);
+    ip += literals;
+    op += literals;
+
+    // the last sequence ends with its literals
+    if (ip == srcLen)
+      break;
+
+    if (ip + 2 > srcLen)
+      return false;
+    std::size_t offset = (unsigned char) src[ip] | ((std::size_t) (unsigned char) src[ip + 1] << 8);
+    ip += 2;
+    std::size_t length = token & 15;
+    if (length == 15 && !readLength(src, ip, srcLen, length))
+      return false;
+    length += MIN_MATCH;
+    if (offset == 0 || offset > op || op + length > dstLen)
+      return false;
+
+    // byte by byte, a match may overlap what it is copying
+    for (std::size_t n = 0; n < length; n++, op++)
+      dst[op] = dst[op - offset];
+  }
+  return op == dstLen;
+}
+
+//----------------------------------------
+// CompressedPageCache
+//----------------------------------------
+
+const std::size_t CompressedPageCache::ENTRY_OVERHEAD;
+
+CompressedPageCache::CompressedPageCache(const std::size_t capacity)
+	: capacity(capacity), bytesUsed(0)
+{
+}
+
+void CompressedPageCache::setCapacity(const std::size_t newCapacity)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  capacity = newCapacity;
+  trim();
+}
+
+bool CompressedPageCache::put(const File* file, const PageId pageNo, const Page& page)
+{
+  if (capacity == 0)
+    return false;
+
+  // compress before taking the latch, keeping only pages that get smaller
+  char buffer[Page::SIZE];
+  std::size_t length = PageCodec::compress(reinterpret_cast<const char*>(&page), Page::SIZE, buffer, Page::SIZE - 1);
+
+  std::lock_guard<std::mutex> lock(latch);
+  Key key(file, pageNo);
+  std::map<Key, Entry>::iterator it = entries.find(key);
+  if (it != entries.end())
+    remove(it);
+  if (length == 0 || length + ENTRY_OVERHEAD > capacity)
+    return false;
+
+  lru.push_front(key);
+  Entry& entry = entries[key];
+  entry.data.assign(buffer, length);
+  entry.position = lru.begin();
+  bytesUsed += length + ENTRY_OVERHEAD;
+  trim();
+  return true;
+}
+
+bool CompressedPageCache::take(const File* file, const PageId pageNo, Page& page)
+{
+  if (capacity == 0)
+    return false;
+
+  std::string data;
+  {
+    std::lock_guard<std::mutex> lock(latch);
+    std::map<Key, Entry>::iterator it = entries.find(Key(file, pageNo));
+    if (it == entries.end())
+      return false;
+    data.swap(it->second.data);
+    bytesUsed -= data.size();
+    remove(it);
+  }
+
+  // a copy that does not decompress is treated as never kept, the page is read from disk instead
+  char buffer[Page::SIZE];
+  if (!PageCodec::decompress(data.data(), data.size(), buffer, Page::SIZE))
+    return false;
+  memcpy(reinterpret_cast<char*>(&page), buffer, Page::SIZE);
+  return true;
+}
+
+void CompressedPageCache::erase(const File* file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  std::map<Key, Entry>::iterator it = entries.find(Key(file, pageNo));
+  if (it != entries.end())
+    remove(it);
+}
+
+void CompressedPageCache::dropFile(const File* file)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  std::map<Key, Entry>::iterator it = entries.lower_bound(Key(file, 0));
+  while (it != entries.end() && it->first.first == file)
+    remove(it++);
+}
+
+std::uint32_t CompressedPageCache::getNumPages() const
+{
+  std::lock_guard<std::mutex> lock(latch);
+  return (std::uint32_t) entries.size();
+}
+
+std::size_t CompressedPageCache::getBytesUsed() const
+{
+  std::lock_guard<std::mutex> lock(latch);
+  return bytesUsed;
+}
+
+void CompressedPageCache::remove(std::map<Key, Entry>::iterator it)
+{
+  bytesUsed -= it->second.data.size() + ENTRY_OVERHEAD;
+  lru.erase(it->second.position);
+  entries.erase(it);
+}
+
+void CompressedPageCache::trim()
+{
+  while (bytesUsed > capacity && !lru.empty())
+    remove(entries.find(lru.back()));
+}
+
+}
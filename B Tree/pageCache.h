@@ -0,0 +1,175 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <string>
+#include <list>
+#include <map>
+#include <mutex>
+#include "file.h"
+
+namespace badgerdb {
+
+/**
+* @brief Fast LZ77 compression of single pages.
+*
+* The format is a run of sequences, each a token byte holding the number of literals in its high nibble and the
+* match length less MIN_MATCH in its low one, a nibble of 15 being continued by bytes added on until one is not 255.
+* The literals follow, then a two byte little endian offset back to the match. The last sequence has literals only.
+*/
+class PageCodec
+{
+ public:
+	/**
+	 * Shortest match worth encoding
+	 */
+	static const std::size_t MIN_MATCH = 4;
+
+	/**
+	 * Compress a buffer.
+	 *
+	 * @param src		Bytes to compress
+	 * @param srcLen	Number of bytes to compress, at most 64 KB
+	 * @param dst		Buffer for the compressed bytes
+	 * @param dstCap	Size of dst
+	 * @return			Number of compressed bytes, or 0 if they would not fit in dstCap
+	 */
+	static std::size_t compress(const char* src, const std::size_t srcLen, char* dst, const std::size_t dstCap);
+
+	/**
+	 * Decompress a buffer produced by compress().
+	 *
+	 * @param src		Compressed bytes
+	 * @param srcLen	Number of compressed bytes
+	 * @param dst		Buffer for the original bytes
+	 * @param dstLen	Number of original bytes expected
+	 * @return			False if the input is corrupt or does not decompress to exactly dstLen bytes
+	 */
+	static bool decompress(const char* src, const std::size_t srcLen, char* dst, const std::size_t dstLen);
+};
+
+/**
+* @brief Second tier behind the buffer pool, holding compressed copies of clean pages the pool has evicted.
+*
+* BufMgr offers every page it evicts, once it is clean, and takes pages back out on a miss before going to disk.
+* A page is in the pool or here, never both, so there is nothing to keep consistent while a page is in use. Pages
+* that do not compress are not kept, and the least recently offered pages go first once the capacity is reached.
+*
+* Calls are serialized by a latch of the cache's own, which may be taken with a shard latch held.
+*/
+class CompressedPageCache
+{
+ public:
+	/**
+	 * Bookkeeping bytes charged to each page on top of its compressed size
+	 */
+	static const std::size_t ENTRY_OVERHEAD = 64;
+
+	/**
+	 * Constructor of CompressedPageCache class
+	 *
+	 * @param capacity	Most bytes to hold, 0 to keep nothing
+	 */
+	CompressedPageCache(const std::size_t capacity);
+
+	/**
+	 * Change the most bytes to hold, dropping the oldest pages if there are too many. 0 drops every page and
+	 * turns the cache off.
+	 */
+	void setCapacity(const std::size_t capacity);
+
+	std::size_t getCapacity() const
+	{
+		return capacity;
+	}
+
+	/**
+	 * Compress and keep a page, replacing any older copy.
+	 *
+	 * @param file		File of the page
+	 * @param pageNo	Page number in the file
+	 * @param page		Contents of the page
+	 * @return			False if the page was not kept, because it does not compress or the cache is off
+	 */
+	bool put(const File* file, const PageId pageNo, const Page& page);
+
+	/**
+	 * Take a page out of the cache, decompressing it.
+	 *
+	 * @param file		File of the page
+	 * @param pageNo	Page number in the file
+	 * @param page		Page the contents are decompressed into
+	 * @return			False, with page untouched, if the page is not in the cache
+	 */
+	bool take(const File* file, const PageId pageNo, Page& page);
+
+	/**
+	 * Forget a page, for one that is deleted from its file.
+	 */
+	void erase(const File* file, const PageId pageNo);
+
+	/**
+	 * Forget every page of a file, for one that is being flushed from the pool and may be closed.
+	 */
+	void dropFile(const File* file);
+
+	/**
+	 * Returns the number of pages held, and the bytes they are charged
+	 */
+	std::uint32_t getNumPages() const;
+	std::size_t getBytesUsed() const;
+
+ private:
+	typedef std::pair<const File*, PageId> Key;
+
+	struct Entry
+	{
+		/**
+		 * Compressed contents of the page
+		 */
+		std::string data;
+
+		/**
+		 * Position of the page in lru
+		 */
+		std::list<Key>::iterator position;
+	};
+
+	/**
+	 * Guards everything below but capacity, which is also read without it to skip the latch while the cache is off
+	 */
+	mutable std::mutex latch;
+
+	std::atomic<std::size_t> capacity;
+	std::size_t bytesUsed;
+
+	/**
+	 * Pages by file and page number, so a file's pages are next to each other
+	 */
+	std::map<Key, Entry> entries;
+
+	/**
+	 * Keys of the pages, most recently offered first
+	 */
+	std::list<Key> lru;
+
+	/**
+	 * Forget a page. Called with latch held.
+	 */
+	void remove(std::map<Key, Entry>::iterator it);
+
+	/**
+	 * Drop the oldest pages until bytesUsed is within capacity. Called with latch held.
+	 */
+	void trim();
+};
+
+}
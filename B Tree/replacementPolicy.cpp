@@ -0,0 +1,445 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "replacementPolicy.h"
+
+namespace badgerdb {
+
+ReplacementPolicy* ReplacementPolicy::create(const ReplacementKind kind, const std::uint32_t numSlots)
+{
+  switch (kind)
+  {
+    case REPL_LRU2:
+      return new LRU2Policy(numSlots);
+    case REPL_2Q:
+      return new TwoQPolicy(numSlots);
+    case REPL_ARC:
+      return new ARCPolicy(numSlots);
+    case REPL_CLOCK:
+    default:
+      return new ClockPolicy(numSlots);
+  }
+}
+
+//----------------------------------------
+// SlotLists
+//----------------------------------------
+
+const std::uint32_t SlotLists::NONE;
+
+SlotLists::SlotLists(const std::uint32_t numSlots, const int numLists)
+	: prev(numSlots, NONE), next(numSlots, NONE), owner(numSlots, -1),
+	  head(numLists, NONE), tail(numLists, NONE), length(numLists, 0)
+{
+}
+
+void SlotLists::resize(const std::uint32_t numSlots)
+{
+  prev.resize(numSlots, NONE);
+  next.resize(numSlots, NONE);
+  owner.resize(numSlots, -1);
+}
+
+void SlotLists::pushFront(const int list, const std::uint32_t slot)
+{
+  prev[slot] = NONE;
+  next[slot] = head[list];
+  if (head[list] != NONE)
+    prev[head[list]] = slot;
+  else
+    tail[list] = slot;
+  head[list] = slot;
+  owner[slot] = list;
+  length[list]++;
+}
+
+void SlotLists::remove(const std::uint32_t slot)
+{
+  int list = owner[slot];
+  if (list < 0)
+    return;
+
+  if (prev[slot] != NONE)
+    next[prev[slot]] = next[slot];
+  else
+    head[list] = next[slot];
+  if (next[slot] != NONE)
+    prev[next[slot]] = prev[slot];
+  else
+    tail[list] = prev[slot];
+
+  prev[slot] = next[slot] = NONE;
+  owner[slot] = -1;
+  length[list]--;
+}
+
+void SlotLists::appendList(const int list, std::vector<std::uint32_t>& slots) const
+{
+  for (std::uint32_t s = head[list]; s != NONE; s = next[s])
+    slots.push_back(s);
+}
+
+//----------------------------------------
+// GhostList
+//----------------------------------------
+
+void GhostList::pushFront(const std::uint64_t key)
+{
+  remove(key);
+  keys.push_front(key);
+  index[key] = keys.begin();
+}
+
+void GhostList::remove(const std::uint64_t key)
+{
+  std::unordered_map<std::uint64_t, std::list<std::uint64_t>::iterator>::iterator it = index.find(key);
+  if (it == index.end())
+    return;
+  keys.erase(it->second);
+  index.erase(it);
+}
+
+void GhostList::popBack()
+{
+  if (keys.empty())
+    return;
+  index.erase(keys.back());
+  keys.pop_back();
+}
+
+//----------------------------------------
+// ClockPolicy
+//----------------------------------------
+
+const std::uint32_t ClockPolicy::SWEEP_LIMIT;
+
+ClockPolicy::ClockPolicy(const std::uint32_t numSlots)
+	: numSlots(numSlots), clockHand(numSlots - 1), resident(numSlots, false), refbit(numSlots, false)
+{
+}
+
+void ClockPolicy::pageLoaded(const std::uint32_t slot, const std::uint64_t /* key */)
+{
+  resident[slot] = true;
+  refbit[slot] = true;
+}
+
+void ClockPolicy::pageAccessed(const std::uint32_t slot)
+{
+  refbit[slot] = true;
+}
+
+void ClockPolicy::pageRemoved(const std::uint32_t slot)
+{
+  resident[slot] = false;
+}
+
+bool ClockPolicy::pickVictim(const EvictionCheck& check, const std::uint64_t /* key */, std::uint32_t& slot)
+{
+  // the first evictable slot given a second chance this sweep, numSlots while there is none
+  std::uint32_t secondChance = numSlots;
+  for (std::uint32_t numScanned = 0; numScanned < 2 * numSlots; numScanned++)	//Need to scn twice
+  {
+    // in a large pool of referenced pages, do not go all the way round clearing bits
+    if (numScanned >= SWEEP_LIMIT && secondChance < numSlots)
+    {
+      resident[secondChance] = false;
+      slot = secondChance;
+      return true;
+    }
+
+    // advance the clock
+    clockHand = (clockHand + 1) % numSlots;
+    if (!resident[clockHand] || !check.canEvict(clockHand))
+      continue;
+
+    if (refbit[clockHand])
+    {
+      // has been referenced, clear the bit
+      refbit[clockHand] = false;
+      if (secondChance == numSlots)
+        secondChance = clockHand;
+      continue;
+    }
+
+    // hasn't been referenced and is not pinned, use it
+    resident[clockHand] = false;
+    slot = clockHand;
+    return true;
+  }
+  return false;
+}
+
+void ClockPolicy::setNumSlots(const std::uint32_t numSlots)
+{
+  this->numSlots = numSlots;
+  resident.resize(numSlots, false);
+  refbit.resize(numSlots, false);
+  if (clockHand >= numSlots)
+    clockHand = numSlots - 1;
+}
+
+void ClockPolicy::residentSlots(std::vector<std::uint32_t>& slots) const
+{
+  // the clock keeps no order, only whether a page was referenced since the hand passed it
+  for (int referenced = 1; referenced >= 0; referenced--)
+  {
+    for (std::uint32_t s = 0; s < numSlots; s++)
+    {
+      if (resident[s] && refbit[s] == (referenced == 1))
+        slots.push_back(s);
+    }
+  }
+}
+
+//----------------------------------------
+// LRU2Policy
+//----------------------------------------
+
+LRU2Policy::LRU2Policy(const std::uint32_t numSlots)
+	: clock(0), last(numSlots, 0), secondLast(numSlots, 0), resident(numSlots, false)
+{
+}
+
+void LRU2Policy::pageLoaded(const std::uint32_t slot, const std::uint64_t /* key */)
+{
+  last[slot] = ++clock;
+  secondLast[slot] = 0;
+  resident[slot] = true;
+  order.insert(std::make_pair(std::make_pair(secondLast[slot], last[slot]), slot));
+}
+
+void LRU2Policy::pageAccessed(const std::uint32_t slot)
+{
+  // back to back accesses to the same page are one correlated reference, not a second one
+  if (last[slot] == clock)
+    return;
+
+  order.erase(std::make_pair(std::make_pair(secondLast[slot], last[slot]), slot));
+  secondLast[slot] = last[slot];
+  last[slot] = ++clock;
+  order.insert(std::make_pair(std::make_pair(secondLast[slot], last[slot]), slot));
+}
+
+void LRU2Policy::pageRemoved(const std::uint32_t slot)
+{
+  if (!resident[slot])
+    return;
+  order.erase(std::make_pair(std::make_pair(secondLast[slot], last[slot]), slot));
+  resident[slot] = false;
+}
+
+bool LRU2Policy::pickVictim(const EvictionCheck& check, const std::uint64_t /* key */, std::uint32_t& slot)
+{
+  for (HistorySet::iterator it = order.begin(); it != order.end(); ++it)
+  {
+    if (check.canEvict(it->second))
+    {
+      slot = it->second;
+      resident[slot] = false;
+      order.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+void LRU2Policy::setNumSlots(const std::uint32_t numSlots)
+{
+  last.resize(numSlots, 0);
+  secondLast.resize(numSlots, 0);
+  resident.resize(numSlots, false);
+}
+
+void LRU2Policy::residentSlots(std::vector<std::uint32_t>& slots) const
+{
+  for (HistorySet::const_reverse_iterator it = order.rbegin(); it != order.rend(); ++it)
+    slots.push_back(it->second);
+}
+
+//----------------------------------------
+// TwoQPolicy
+//----------------------------------------
+
+TwoQPolicy::TwoQPolicy(const std::uint32_t numSlots)
+	: maxIn(numSlots / 4 > 0 ? numSlots / 4 : 1), maxOut(numSlots / 2 > 0 ? numSlots / 2 : 1),
+	  lists(numSlots, 2), keys(numSlots, 0)
+{
+}
+
+void TwoQPolicy::pageLoaded(const std::uint32_t slot, const std::uint64_t key)
+{
+  keys[slot] = key;
+
+  // only pages seen again after leaving probation make it to the main queue
+  if (a1out.contains(key))
+  {
+    a1out.remove(key);
+    lists.pushFront(AM, slot);
+  }
+  else
+  {
+    lists.pushFront(A1IN, slot);
+  }
+}
+
+void TwoQPolicy::pageAccessed(const std::uint32_t slot)
+{
+  // probation is FIFO, hits there do not reorder
+  if (lists.listOf(slot) == AM)
+  {
+    lists.remove(slot);
+    lists.pushFront(AM, slot);
+  }
+}
+
+void TwoQPolicy::pageRemoved(const std::uint32_t slot)
+{
+  lists.remove(slot);
+}
+
+bool TwoQPolicy::pickVictim(const EvictionCheck& check, const std::uint64_t /* key */, std::uint32_t& slot)
+{
+  int first = (lists.size(A1IN) > maxIn || lists.size(AM) == 0) ? A1IN : AM;
+  for (int n = 0; n < 2; n++)
+  {
+    int list = n == 0 ? first : 1 - first;
+    for (std::uint32_t s = lists.back(list); s != SlotLists::NONE; s = lists.previous(s))
+    {
+      if (!check.canEvict(s))
+        continue;
+
+      lists.remove(s);
+      if (list == A1IN)
+      {
+        a1out.pushFront(keys[s]);
+        if (a1out.size() > maxOut)
+          a1out.popBack();
+      }
+      slot = s;
+      return true;
+    }
+  }
+  return false;
+}
+
+void TwoQPolicy::setNumSlots(const std::uint32_t numSlots)
+{
+  maxIn = numSlots / 4 > 0 ? numSlots / 4 : 1;
+  maxOut = numSlots / 2 > 0 ? numSlots / 2 : 1;
+  lists.resize(numSlots);
+  keys.resize(numSlots, 0);
+  while (a1out.size() > maxOut)
+    a1out.popBack();
+}
+
+void TwoQPolicy::residentSlots(std::vector<std::uint32_t>& slots) const
+{
+  lists.appendList(AM, slots);
+  lists.appendList(A1IN, slots);
+}
+
+//----------------------------------------
+// ARCPolicy
+//----------------------------------------
+
+ARCPolicy::ARCPolicy(const std::uint32_t numSlots)
+	: capacity(numSlots), target(0), lists(numSlots, 2), keys(numSlots, 0)
+{
+}
+
+void ARCPolicy::pageLoaded(const std::uint32_t slot, const std::uint64_t key)
+{
+  keys[slot] = key;
+
+  if (b1.contains(key))
+  {
+    // recently evicted for lack of recency space, grow T1's target
+    std::uint32_t delta = b2.size() > b1.size() ? b2.size() / b1.size() : 1;
+    target = target + delta < capacity ? target + delta : capacity;
+    b1.remove(key);
+    lists.pushFront(T2, slot);
+  }
+  else if (b2.contains(key))
+  {
+    // recently evicted for lack of frequency space, shrink T1's target
+    std::uint32_t delta = b1.size() > b2.size() ? b1.size() / b2.size() : 1;
+    target = target > delta ? target - delta : 0;
+    b2.remove(key);
+    lists.pushFront(T2, slot);
+  }
+  else
+  {
+    lists.pushFront(T1, slot);
+  }
+
+  // keep the recency side within the cache size and everything within twice that
+  while (lists.size(T1) + b1.size() > capacity && b1.size() > 0)
+    b1.popBack();
+  while (lists.size(T1) + lists.size(T2) + b1.size() + b2.size() > 2 * capacity && b2.size() > 0)
+    b2.popBack();
+}
+
+void ARCPolicy::pageAccessed(const std::uint32_t slot)
+{
+  lists.remove(slot);
+  lists.pushFront(T2, slot);
+}
+
+void ARCPolicy::pageRemoved(const std::uint32_t slot)
+{
+  lists.remove(slot);
+}
+
+bool ARCPolicy::evictFrom(const int list, const EvictionCheck& check, std::uint32_t& slot)
+{
+  for (std::uint32_t s = lists.back(list); s != SlotLists::NONE; s = lists.previous(s))
+  {
+    if (!check.canEvict(s))
+      continue;
+
+    lists.remove(s);
+    if (list == T1)
+      b1.pushFront(keys[s]);
+    else
+      b2.pushFront(keys[s]);
+    slot = s;
+    return true;
+  }
+  return false;
+}
+
+bool ARCPolicy::pickVictim(const EvictionCheck& check, const std::uint64_t key, std::uint32_t& slot)
+{
+  std::uint32_t t1 = lists.size(T1);
+  if (t1 > 0 && (t1 > target || (b2.contains(key) && t1 == target)))
+    return evictFrom(T1, check, slot) || evictFrom(T2, check, slot);
+  return evictFrom(T2, check, slot) || evictFrom(T1, check, slot);
+}
+
+void ARCPolicy::setNumSlots(const std::uint32_t numSlots)
+{
+  capacity = numSlots;
+  if (target > capacity)
+    target = capacity;
+  lists.resize(numSlots);
+  keys.resize(numSlots, 0);
+
+  // the ghost lists shrink with the cache
+  while (lists.size(T1) + b1.size() > capacity && b1.size() > 0)
+    b1.popBack();
+  while (lists.size(T1) + lists.size(T2) + b1.size() + b2.size() > 2 * capacity && b2.size() > 0)
+    b2.popBack();
+}
+
+void ARCPolicy::residentSlots(std::vector<std::uint32_t>& slots) const
+{
+  lists.appendList(T2, slots);
+  lists.appendList(T1, slots);
+}
+
+}
@@ -0,0 +1,426 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <list>
+#include <set>
+#include <unordered_map>
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+* @brief Replacement policies a BufMgr can be created with.
+*/
+enum ReplacementKind
+{
+	REPL_CLOCK,	/* Clock sweep with one reference bit per frame */
+	REPL_LRU2,	/* LRU-K with K = 2, evicts the frame whose second most recent access is oldest */
+	REPL_2Q,	/* Full 2Q: FIFO probation queue, LRU main queue and a ghost queue of recent evictions */
+	REPL_ARC	/* Adaptive Replacement Cache */
+};
+
+/**
+* @brief Tells a replacement policy which of its slots may be evicted right now.
+*/
+class EvictionCheck
+{
+ public:
+	virtual ~EvictionCheck() {}
+
+	/**
+	 * Returns true if the page in the slot is unpinned and has no I/O in progress.
+	 *
+	 * @param slot	Slot of the policy
+	 */
+	virtual bool canEvict(const std::uint32_t slot) const = 0;
+};
+
+/**
+* @brief Interface for buffer replacement policies.
+*
+* A policy manages a fixed number of slots, each holding at most one page. It is told when a page is loaded into a
+* slot, when a resident page is accessed again and when a slot is emptied by anything other than the policy itself,
+* and it picks the slot to reuse when a page must be evicted. Pages are identified by a 64-bit key so that policies
+* with ghost lists can remember pages that are no longer resident.
+*
+* @warning This class is not threadsafe. BufMgr keeps one policy per shard, guarded by the shard latch.
+*/
+class ReplacementPolicy
+{
+ public:
+	virtual ~ReplacementPolicy() {}
+
+	/**
+	 * Create a policy.
+	 *
+	 * @param kind		Policy to create
+	 * @param numSlots	Number of slots the policy manages
+	 * @return			The policy, owned by the caller
+	 */
+	static ReplacementPolicy* create(const ReplacementKind kind, const std::uint32_t numSlots);
+
+	/**
+	 * Returns the name of the policy.
+	 */
+	virtual const char* name() const = 0;
+
+	/**
+	 * A page has been loaded into an empty slot.
+	 *
+	 * @param slot	Slot the page is in
+	 * @param key	Key of the page
+	 */
+	virtual void pageLoaded(const std::uint32_t slot, const std::uint64_t key) = 0;
+
+	/**
+	 * The resident page in a slot has been accessed again.
+	 *
+	 * @param slot	Slot the page is in
+	 */
+	virtual void pageAccessed(const std::uint32_t slot) = 0;
+
+	/**
+	 * The page in a slot has been dropped without being picked as a victim, for example because its file was
+	 * flushed or the page disposed.
+	 *
+	 * @param slot	Slot the page was in
+	 */
+	virtual void pageRemoved(const std::uint32_t slot) = 0;
+
+	/**
+	 * Pick a resident page to evict and forget it. The slot is empty when this returns.
+	 *
+	 * @param check	Tells which slots may be evicted
+	 * @param key	Key of the page about to be loaded
+	 * @param slot	Slot of the victim returned via this variable
+	 * @return		False if every resident page is pinned or busy
+	 */
+	virtual bool pickVictim(const EvictionCheck& check, const std::uint64_t key, std::uint32_t& slot) = 0;
+
+	/**
+	 * Change the number of slots. New slots start empty; slots taken away must have been emptied first.
+	 *
+	 * @param numSlots	New number of slots
+	 */
+	virtual void setNumSlots(const std::uint32_t numSlots) = 0;
+
+	/**
+	 * List the slots holding pages, the ones the policy would keep longest first.
+	 *
+	 * @param slots	Vector the slots are appended to
+	 */
+	virtual void residentSlots(std::vector<std::uint32_t>& slots) const = 0;
+};
+
+/**
+* @brief Doubly linked lists threaded through slot numbers, with O(1) insert and remove. Each slot is on at most
+* one list of a SlotLists object.
+*/
+class SlotLists
+{
+ public:
+	/**
+	 * Marks a slot that is on no list
+	 */
+	static const std::uint32_t NONE = 0xffffffff;
+
+	/**
+	 * Constructor of SlotLists class
+	 *
+	 * @param numSlots	Number of slots
+	 * @param numLists	Number of lists
+	 */
+	SlotLists(const std::uint32_t numSlots, const int numLists);
+
+	/**
+	 * Change the number of slots. Slots taken away must be on no list.
+	 */
+	void resize(const std::uint32_t numSlots);
+
+	/**
+	 * Put a slot at the front (most recent end) of a list.
+	 */
+	void pushFront(const int list, const std::uint32_t slot);
+
+	/**
+	 * Take a slot off whichever list it is on.
+	 */
+	void remove(const std::uint32_t slot);
+
+	/**
+	 * Returns the list a slot is on, or -1.
+	 */
+	int listOf(const std::uint32_t slot) const
+	{
+		return owner[slot];
+	}
+
+	/**
+	 * Returns the last (least recent) slot of a list, or NONE.
+	 */
+	std::uint32_t back(const int list) const
+	{
+		return tail[list];
+	}
+
+	/**
+	 * Returns the slot before another one on its list, towards the front, or NONE.
+	 */
+	std::uint32_t previous(const std::uint32_t slot) const
+	{
+		return prev[slot];
+	}
+
+	/**
+	 * Append the slots of a list to a vector, front (most recent) first.
+	 */
+	void appendList(const int list, std::vector<std::uint32_t>& slots) const;
+
+	/**
+	 * Returns the number of slots on a list.
+	 */
+	std::uint32_t size(const int list) const
+	{
+		return length[list];
+	}
+
+ private:
+	/**
+	 * Neighbours of each slot on its list, NONE at the ends
+	 */
+	std::vector<std::uint32_t> prev;
+	std::vector<std::uint32_t> next;
+
+	/**
+	 * List each slot is on, -1 for none
+	 */
+	std::vector<int> owner;
+
+	/**
+	 * First slot, last slot and length of each list
+	 */
+	std::vector<std::uint32_t> head;
+	std::vector<std::uint32_t> tail;
+	std::vector<std::uint32_t> length;
+};
+
+/**
+* @brief Bounded FIFO of keys of pages that are no longer resident, with O(1) membership tests.
+*/
+class GhostList
+{
+ public:
+	/**
+	 * Returns true if the key is on the list.
+	 */
+	bool contains(const std::uint64_t key) const
+	{
+		return index.find(key) != index.end();
+	}
+
+	/**
+	 * Put a key at the front of the list.
+	 */
+	void pushFront(const std::uint64_t key);
+
+	/**
+	 * Take a key off the list, if it is there.
+	 */
+	void remove(const std::uint64_t key);
+
+	/**
+	 * Drop the oldest key.
+	 */
+	void popBack();
+
+	/**
+	 * Returns the number of keys on the list.
+	 */
+	std::uint32_t size() const
+	{
+		return (std::uint32_t) keys.size();
+	}
+
+ private:
+	/**
+	 * Keys, newest first
+	 */
+	std::list<std::uint64_t> keys;
+
+	/**
+	 * Position of each key in keys
+	 */
+	std::unordered_map<std::uint64_t, std::list<std::uint64_t>::iterator> index;
+};
+
+/**
+* @brief Clock sweep, the policy BufMgr has always used.
+*/
+class ClockPolicy : public ReplacementPolicy
+{
+ public:
+	/**
+	 * Slots the hand passes before settling for the first evictable page whose reference bit it cleared, rather
+	 * than going round again for one that was not referenced
+	 */
+	static const std::uint32_t SWEEP_LIMIT = 256;
+
+	ClockPolicy(const std::uint32_t numSlots);
+	const char* name() const { return "clock"; }
+	void pageLoaded(const std::uint32_t slot, const std::uint64_t key);
+	void pageAccessed(const std::uint32_t slot);
+	void pageRemoved(const std::uint32_t slot);
+	bool pickVictim(const EvictionCheck& check, const std::uint64_t key, std::uint32_t& slot);
+	void setNumSlots(const std::uint32_t numSlots);
+	void residentSlots(std::vector<std::uint32_t>& slots) const;
+
+ private:
+	std::uint32_t numSlots;
+
+	/**
+	 * Current position of clockhand
+	 */
+	std::uint32_t clockHand;
+
+	/**
+	 * Whether each slot holds a page, and whether that page has been referenced since the hand last passed
+	 */
+	std::vector<bool> resident;
+	std::vector<bool> refbit;
+};
+
+/**
+* @brief LRU-2. Evicts the page whose second most recent access is the oldest; pages seen only once go first, in
+* order of their only access, so a single scan cannot push out pages that are used repeatedly.
+*/
+class LRU2Policy : public ReplacementPolicy
+{
+ public:
+	LRU2Policy(const std::uint32_t numSlots);
+	const char* name() const { return "LRU-2"; }
+	void pageLoaded(const std::uint32_t slot, const std::uint64_t key);
+	void pageAccessed(const std::uint32_t slot);
+	void pageRemoved(const std::uint32_t slot);
+	bool pickVictim(const EvictionCheck& check, const std::uint64_t key, std::uint32_t& slot);
+	void setNumSlots(const std::uint32_t numSlots);
+	void residentSlots(std::vector<std::uint32_t>& slots) const;
+
+ private:
+	/**
+	 * (second most recent access, most recent access, slot), the first entry is the next victim
+	 */
+	typedef std::set<std::pair<std::pair<std::uint64_t, std::uint64_t>, std::uint32_t> > HistorySet;
+
+	/**
+	 * Logical time, advanced on every access
+	 */
+	std::uint64_t clock;
+
+	/**
+	 * Times of the most recent and second most recent access to each slot's page, 0 for never
+	 */
+	std::vector<std::uint64_t> last;
+	std::vector<std::uint64_t> secondLast;
+
+	std::vector<bool> resident;
+	HistorySet order;
+};
+
+/**
+* @brief 2Q. New pages enter a FIFO probation queue; only pages referenced again after being evicted from it, as
+* remembered by a ghost queue, are admitted to the LRU main queue.
+*/
+class TwoQPolicy : public ReplacementPolicy
+{
+ public:
+	TwoQPolicy(const std::uint32_t numSlots);
+	const char* name() const { return "2Q"; }
+	void pageLoaded(const std::uint32_t slot, const std::uint64_t key);
+	void pageAccessed(const std::uint32_t slot);
+	void pageRemoved(const std::uint32_t slot);
+	bool pickVictim(const EvictionCheck& check, const std::uint64_t key, std::uint32_t& slot);
+	void setNumSlots(const std::uint32_t numSlots);
+	void residentSlots(std::vector<std::uint32_t>& slots) const;
+
+ private:
+	enum { A1IN = 0, AM = 1 };
+
+	/**
+	 * Target length of the probation queue and the length of the ghost queue, a quarter and half of the slots
+	 */
+	std::uint32_t maxIn;
+	std::uint32_t maxOut;
+
+	/**
+	 * Probation queue A1in and main queue Am
+	 */
+	SlotLists lists;
+
+	/**
+	 * Key of the page in each slot
+	 */
+	std::vector<std::uint64_t> keys;
+
+	/**
+	 * Keys of pages recently evicted from probation
+	 */
+	GhostList a1out;
+};
+
+/**
+* @brief Adaptive Replacement Cache. Balances a recency list and a frequency list, moving the target size of each
+* with hits in the ghost lists of pages recently evicted from them.
+*/
+class ARCPolicy : public ReplacementPolicy
+{
+ public:
+	ARCPolicy(const std::uint32_t numSlots);
+	const char* name() const { return "ARC"; }
+	void pageLoaded(const std::uint32_t slot, const std::uint64_t key);
+	void pageAccessed(const std::uint32_t slot);
+	void pageRemoved(const std::uint32_t slot);
+	bool pickVictim(const EvictionCheck& check, const std::uint64_t key, std::uint32_t& slot);
+	void setNumSlots(const std::uint32_t numSlots);
+	void residentSlots(std::vector<std::uint32_t>& slots) const;
+
+ private:
+	enum { T1 = 0, T2 = 1 };
+
+	std::uint32_t capacity;
+
+	/**
+	 * Target number of slots for T1, adapted on ghost hits
+	 */
+	std::uint32_t target;
+
+	/**
+	 * T1, pages seen once recently, and T2, pages seen at least twice
+	 */
+	SlotLists lists;
+
+	/**
+	 * Key of the page in each slot
+	 */
+	std::vector<std::uint64_t> keys;
+
+	/**
+	 * Keys of pages recently evicted from T1 and T2
+	 */
+	GhostList b1;
+	GhostList b2;
+
+	/**
+	 * Evict the least recent evictable page of a list into its ghost list.
+	 */
+	bool evictFrom(const int list, const EvictionCheck& check, std::uint32_t& slot);
+};
+
+}
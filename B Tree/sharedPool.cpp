@@ -0,0 +1,742 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sharedPool.h"
+#include "buffer.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/page_not_pinned_exception.h"
+#include "exceptions/page_pinned_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+
+namespace badgerdb {
+
+/**
+ * Marks a segment that has been set up, followed by the version of its layout
+ */
+static const std::uint32_t SEGMENT_MAGIC = 0x42534850;
+static const std::uint32_t SEGMENT_VERSION = 2;
+
+/**
+ * Files the segment can know at once, and the end of a hash chain or file lookup
+ */
+static const std::uint32_t MAX_FILES = 1024;
+static const std::uint32_t NO_FRAME = 0xffffffff;
+static const std::uint32_t NO_FILE = 0xffffffff;
+
+/**
+ * How long to wait for another process to finish setting up a segment it created
+ */
+static const int ATTACH_TIMEOUT_MS = 5000;
+
+/**
+ * Start of the segment. The magic number is written last by the process creating it.
+ */
+struct SharedHeader
+{
+  std::atomic<std::uint32_t> magic;
+  std::uint32_t version;
+  std::uint32_t numFrames;
+  std::uint32_t numBuckets;
+  std::uint32_t clockHand;
+  pthread_mutex_t latch;
+  pthread_mutex_t fileLatch;
+  pthread_cond_t ioDone;
+};
+
+/**
+ * A file known to the segment, the number of frames holding its pages, and the number of frames being found for its
+ * pages with the latch dropped. The entry may be given to another file only once both are 0. A file is known by its
+ * inode and the generation in its header, as a file created after another was removed may be given the same inode
+ * while the removed file's pages are still in the segment.
+ */
+struct SharedFileEntry
+{
+  std::uint64_t device;
+  std::uint64_t inode;
+  std::uint64_t generation;
+  std::uint32_t frames;
+  std::uint32_t pending;
+  std::uint32_t used;
+};
+
+/**
+ * Descriptor of a frame, BufDesc with the file by number and the hash chain by frame number
+ */
+struct SharedFrameDesc
+{
+  std::uint32_t fileId;
+  PageId pageNo;
+  std::uint32_t next;
+  std::int32_t pinCnt;
+  std::uint8_t valid;
+  std::uint8_t dirty;
+  std::uint8_t refbit;
+  std::uint8_t ioState;
+};
+
+static std::size_t alignUp(const std::size_t n, const std::size_t alignment)
+{
+  return (n + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Offsets of the parts of a segment with the given number of frames, and its size
+ */
+struct SegmentLayout
+{
+  std::size_t fileTable;
+  std::size_t descs;
+  std::size_t buckets;
+  std::size_t pages;
+  std::size_t bytes;
+
+  SegmentLayout(const std::uint32_t numFrames, const std::uint32_t numBuckets)
+  {
+    fileTable = alignUp(sizeof(SharedHeader), 64);
+    descs = alignUp(fileTable + MAX_FILES * sizeof(SharedFileEntry), 64);
+    buckets = alignUp(descs + (std::size_t) numFrames * sizeof(SharedFrameDesc), 64);
+    pages = alignUp(buckets + (std::size_t) numBuckets * sizeof(std::uint32_t), Page::SIZE);
+    bytes = pages + (std::size_t) numFrames * Page::SIZE;
+  }
+};
+
+//----------------------------------------
+// ProcessLatch
+//----------------------------------------
+
+void ProcessLatch::lock()
+{
+  // the last owner died holding it, whatever it was doing is left as it was
+  if (pthread_mutex_lock(mutex) == EOWNERDEAD)
+    pthread_mutex_consistent(mutex);
+}
+
+void ProcessLatch::unlock()
+{
+  pthread_mutex_unlock(mutex);
+}
+
+void ProcessLatch::wait(pthread_cond_t* cond)
+{
+  if (pthread_cond_wait(cond, mutex) == EOWNERDEAD)
+    pthread_mutex_consistent(mutex);
+}
+
+//----------------------------------------
+// SharedBufPool
+//----------------------------------------
+
+SharedBufPool::SharedBufPool(const std::string& name, const std::uint32_t bufs, BufStats& stats)
+	: name(name), base(NULL), bytes(0), bufStats(stats)
+{
+  attach(bufs > 0 ? bufs : 1);
+}
+
+SharedBufPool::~SharedBufPool()
+{
+  munmap(base, bytes);
+}
+
+bool SharedBufPool::remove(const std::string& name)
+{
+  return shm_unlink(name.c_str()) == 0;
+}
+
+static void initLatch(pthread_mutex_t* mutex)
+{
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+  pthread_mutex_init(mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
+void SharedBufPool::attach(const std::uint32_t bufs)
+{
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  bool created = fd >= 0;
+  if (!created && errno == EEXIST)
+    fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0)
+    throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+
+  std::uint32_t numBuckets = (std::uint32_t) (bufs * 1.2) + 1;
+  std::chrono::steady_clock::time_point deadline =
+    std::chrono::steady_clock::now() + std::chrono::milliseconds(ATTACH_TIMEOUT_MS);
+  if (created)
+  {
+    bytes = SegmentLayout(bufs, numBuckets).bytes;
+    if (ftruncate(fd, bytes) != 0)
+    {
+      int error = errno;
+      close(fd);
+      shm_unlink(name.c_str());
+      throw std::system_error(error, std::generic_category(), "ftruncate " + name);
+    }
+  }
+  else
+  {
+    // the creator sizes the segment right after creating it
+    struct stat st;
+    while (fstat(fd, &st) == 0 && st.st_size == 0 && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    bytes = st.st_size;
+    if (bytes < sizeof(SharedHeader))
+    {
+      close(fd);
+      throw std::system_error(ETIMEDOUT, std::generic_category(), "shm_open " + name);
+    }
+  }
+
+  base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    throw std::system_error(errno, std::generic_category(), "mmap " + name);
+  header = static_cast<SharedHeader*>(base);
+
+  if (created)
+  {
+    // the segment reads as zeros, so only what is not zero is set
+    header->version = SEGMENT_VERSION;
+    header->numFrames = bufs;
+    header->numBuckets = numBuckets;
+    header->clockHand = 0;
+    initLatch(&header->latch);
+    initLatch(&header->fileLatch);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&header->ioDone, &attr);
+    pthread_condattr_destroy(&attr);
+  }
+  else
+  {
+    while (header->magic.load(std::memory_order_acquire) != SEGMENT_MAGIC && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (header->magic.load(std::memory_order_acquire) != SEGMENT_MAGIC || header->version != SEGMENT_VERSION ||
+        SegmentLayout(header->numFrames, header->numBuckets).bytes != bytes)
+    {
+      munmap(base, bytes);
+      throw std::system_error(EINVAL, std::generic_category(), "not a buffer pool segment " + name);
+    }
+  }
+
+  SegmentLayout layout(header->numFrames, header->numBuckets);
+  char* start = static_cast<char*>(base);
+  fileTable = reinterpret_cast<SharedFileEntry*>(start + layout.fileTable);
+  descs = reinterpret_cast<SharedFrameDesc*>(start + layout.descs);
+  buckets = reinterpret_cast<std::uint32_t*>(start + layout.buckets);
+  pages = reinterpret_cast<Page*>(start + layout.pages);
+  latch = ProcessLatch(&header->latch);
+  fileLatch = ProcessLatch(&header->fileLatch);
+
+  if (created)
+  {
+    for (std::uint32_t b = 0; b < header->numBuckets; b++)
+      buckets[b] = NO_FRAME;
+    for (std::uint32_t f = 0; f < header->numFrames; f++)
+      descs[f].next = NO_FRAME;
+    header->magic.store(SEGMENT_MAGIC, std::memory_order_release);
+  }
+}
+
+std::uint32_t SharedBufPool::getNumBufs() const
+{
+  return header->numFrames;
+}
+
+bool SharedBufPool::identify(const File* file, FileRef& ref) const
+{
+  struct stat st;
+  if (fstat(file->descriptor(), &st) != 0)
+    return false;
+  ref.device = st.st_dev;
+  ref.inode = st.st_ino;
+  ref.generation = file->generation();
+  return true;
+}
+
+bool SharedBufPool::isEntry(const FileRef& ref) const
+{
+  const SharedFileEntry& entry = fileTable[ref.id];
+  return entry.used && entry.device == ref.device && entry.inode == ref.inode && entry.generation == ref.generation;
+}
+
+std::uint32_t SharedBufPool::findFile(const File* file) const
+{
+  std::unordered_map<const File*, FileRef>::const_iterator it = fileRefs.find(file);
+  if (it != fileRefs.end() && isEntry(it->second))
+    return it->second.id;
+
+  FileRef ref;
+  if (!identify(file, ref))
+    return NO_FILE;
+  for (ref.id = 0; ref.id < MAX_FILES; ref.id++)
+  {
+    if (isEntry(ref))
+      return ref.id;
+  }
+  return NO_FILE;
+}
+
+std::uint32_t SharedBufPool::fileIdOf(File* file)
+{
+  std::uint32_t id = findFile(file);
+  if (id == NO_FILE)
+  {
+    // take a free entry, or one no page in the pool refers to any more
+    for (id = 0; id < MAX_FILES; id++)
+    {
+      if (!fileTable[id].used || (fileTable[id].frames == 0 && fileTable[id].pending == 0))
+        break;
+    }
+    if (id == MAX_FILES)
+      throw BufferExceededException();
+
+    FileRef ref;
+    if (!identify(file, ref))
+      throw std::system_error(errno, std::generic_category(), "fstat " + file->filename());
+    fileTable[id].device = ref.device;
+    fileTable[id].inode = ref.inode;
+    fileTable[id].generation = ref.generation;
+    fileTable[id].frames = 0;
+    fileTable[id].pending = 0;
+    fileTable[id].used = 1;
+  }
+
+  FileRef ref = { id, fileTable[id].device, fileTable[id].inode, fileTable[id].generation };
+  fileRefs[file] = ref;
+  files[id] = file;
+  return id;
+}
+
+File* SharedBufPool::openFile(const std::uint32_t fileId) const
+{
+  // the entry may have been given to another file since this process used it
+  std::unordered_map<std::uint32_t, File*>::const_iterator it = files.find(fileId);
+  if (it == files.end())
+    return NULL;
+  return isEntry(fileRefs.find(it->second)->second) ? it->second : NULL;
+}
+
+void SharedBufPool::fileClosed(const File* file)
+{
+  std::lock_guard<ProcessLatch> lock(latch);
+  forgetFile(file);
+}
+
+void SharedBufPool::forgetFile(const File* file)
+{
+  std::unordered_map<const File*, FileRef>::iterator it = fileRefs.find(file);
+  if (it == fileRefs.end())
+    return;
+  std::unordered_map<std::uint32_t, File*>::iterator byId = files.find(it->second.id);
+  if (byId != files.end() && byId->second == file)
+    files.erase(byId);
+  fileRefs.erase(it);
+}
+
+/**
+ * Hash of a page, mixing the file number into the high bits
+ */
+static std::uint64_t pageHash(const std::uint32_t fileId, const PageId pageNo)
+{
+  return ((std::uint64_t) fileId * 0x9e3779b97f4a7c15ULL) ^ pageNo;
+}
+
+std::uint32_t SharedBufPool::lookup(const std::uint32_t fileId, const PageId pageNo) const
+{
+  std::uint32_t f = buckets[pageHash(fileId, pageNo) % header->numBuckets];
+  while (f != NO_FRAME && (descs[f].fileId != fileId || descs[f].pageNo != pageNo))
+    f = descs[f].next;
+  return f;
+}
+
+void SharedBufPool::insert(const std::uint32_t frameNo)
+{
+  SharedFrameDesc& desc = descs[frameNo];
+  std::uint32_t& head = buckets[pageHash(desc.fileId, desc.pageNo) % header->numBuckets];
+  desc.next = head;
+  head = frameNo;
+  fileTable[desc.fileId].frames++;
+}
+
+void SharedBufPool::unlink(const std::uint32_t frameNo)
+{
+  SharedFrameDesc& desc = descs[frameNo];
+  std::uint32_t* link = &buckets[pageHash(desc.fileId, desc.pageNo) % header->numBuckets];
+  while (*link != frameNo)
+    link = &descs[*link].next;
+  *link = desc.next;
+  desc.next = NO_FRAME;
+  fileTable[desc.fileId].frames--;
+}
+
+void SharedBufPool::freeFrame(const std::uint32_t frameNo)
+{
+  if (descs[frameNo].valid)
+    unlink(frameNo);
+  descs[frameNo].valid = 0;
+  descs[frameNo].dirty = 0;
+  descs[frameNo].refbit = 0;
+  descs[frameNo].pinCnt = 0;
+  descs[frameNo].ioState = IO_NONE;
+}
+
+std::uint32_t SharedBufPool::allocFrameFor(const std::uint32_t fileId, std::unique_lock<ProcessLatch>& lock)
+{
+  // the latch may be dropped to write back a victim, and with no frames yet the file's entry would look free
+  fileTable[fileId].pending++;
+  std::uint32_t frameNo;
+  try
+  {
+    frameNo = allocFrame(lock);
+  }
+  catch(...)
+  {
+    fileTable[fileId].pending--;
+    throw;
+  }
+  fileTable[fileId].pending--;
+  return frameNo;
+}
+
+std::uint32_t SharedBufPool::allocFrame(std::unique_lock<ProcessLatch>& lock)
+{
+  // two turns of the clock clear every reference bit on the way
+  std::uint32_t numFrames = header->numFrames;
+  for (std::uint32_t steps = 0; steps < 2 * numFrames; steps++)
+  {
+    std::uint32_t frameNo = header->clockHand;
+    header->clockHand = (frameNo + 1) % numFrames;
+    SharedFrameDesc& desc = descs[frameNo];
+    if (!desc.valid)
+      return frameNo;
+    if (desc.pinCnt > 0 || desc.ioState != IO_NONE)
+      continue;
+    if (desc.refbit)
+    {
+      desc.refbit = 0;
+      continue;
+    }
+
+    if (desc.dirty)
+    {
+      // only a process with the file open can write the page back
+      File* file = openFile(desc.fileId);
+      if (file == NULL)
+        continue;
+
+      desc.ioState = IO_WRITE;
+      lock.unlock();
+      try
+      {
+        std::lock_guard<std::mutex> ioLock(file->streamLatch());
+        file->writePage(desc.pageNo, pages[frameNo]);
+      }
+      catch(...)
+      {
+        lock.lock();
+        desc.ioState = IO_NONE;
+        pthread_cond_broadcast(&header->ioDone);
+        throw;
+      }
+      lock.lock();
+      bufStats.diskwrites++;
+      desc.dirty = 0;
+      desc.ioState = IO_NONE;
+      pthread_cond_broadcast(&header->ioDone);
+
+      // pinned again while it was written, or changed and unpinned
+      if (desc.pinCnt > 0 || desc.dirty)
+        continue;
+    }
+
+    freeFrame(frameNo);
+    return frameNo;
+  }
+  throw BufferExceededException();
+}
+
+void SharedBufPool::readPage(File* file, const PageId pageNo, Page*& page)
+{
+  std::unique_lock<ProcessLatch> lock(latch);
+  bufStats.accesses++;
+  std::uint32_t fileId = fileIdOf(file);
+
+  while (true)
+  {
+    std::uint32_t frameNo = lookup(fileId, pageNo);
+    if (frameNo != NO_FRAME)
+    {
+      // another process or thread is reading or writing back the page, wait for it and look again
+      if (descs[frameNo].ioState == IO_READ || descs[frameNo].ioState == IO_WRITE)
+      {
+        latch.wait(&header->ioDone);
+        continue;
+      }
+
+      descs[frameNo].pinCnt++;
+      descs[frameNo].refbit = 1;
+      page = &pages[frameNo];
+      return;
+    }
+
+    // the latch may be dropped to write back a victim, someone else may bring the page in meanwhile. The frame
+    // is left empty for the next allocation if so
+    frameNo = allocFrameFor(fileId, lock);
+    if (lookup(fileId, pageNo) != NO_FRAME)
+      continue;
+
+    SharedFrameDesc& desc = descs[frameNo];
+    desc.fileId = fileId;
+    desc.pageNo = pageNo;
+    desc.pinCnt = 1;
+    desc.valid = 1;
+    desc.dirty = 0;
+    desc.refbit = 1;
+    desc.ioState = IO_READ;
+    insert(frameNo);
+    lock.unlock();
+
+    try
+    {
+      std::lock_guard<std::mutex> ioLock(file->streamLatch());
+      file->readPage(pageNo, pages[frameNo]);
+    }
+    catch(...)
+    {
+      // nothing else can have pinned it, readers wait for the read
+      lock.lock();
+      freeFrame(frameNo);
+      pthread_cond_broadcast(&header->ioDone);
+      throw;
+    }
+
+    lock.lock();
+    bufStats.diskreads++;
+    desc.ioState = IO_NONE;
+    pthread_cond_broadcast(&header->ioDone);
+    page = &pages[frameNo];
+    return;
+  }
+}
+
+void SharedBufPool::allocPage(File* file, PageId& pageNo, Page*& page)
+{
+  // processes allocating in the same file would otherwise read the same free page from its header. Holding the
+  // file latch throughout keeps the next page number fixed while a frame is claimed for it
+  std::lock_guard<ProcessLatch> fileLock(fileLatch);
+  PageId expected;
+  {
+    std::lock_guard<std::mutex> ioLock(file->streamLatch());
+    expected = file->nextPageNumber();
+  }
+
+  std::unique_lock<ProcessLatch> lock(latch);
+  bufStats.accesses++;
+  std::uint32_t fileId = fileIdOf(file);
+  std::uint32_t frameNo;
+  while (true)
+  {
+    // a page of the same number deleted earlier may have been read back in since, its frame is reused
+    frameNo = lookup(fileId, expected);
+    if (frameNo != NO_FRAME)
+    {
+      if (descs[frameNo].ioState != IO_NONE)
+      {
+        latch.wait(&header->ioDone);
+        continue;
+      }
+      descs[frameNo].pinCnt++;
+      break;
+    }
+
+    // nothing is allocated in the file yet, so running out of frames leaves nothing to undo
+    frameNo = allocFrameFor(fileId, lock);
+    if (lookup(fileId, expected) != NO_FRAME)
+      continue;
+
+    SharedFrameDesc& desc = descs[frameNo];
+    desc.fileId = fileId;
+    desc.pageNo = expected;
+    desc.pinCnt = 1;
+    desc.valid = 1;
+    insert(frameNo);
+    break;
+  }
+
+  // readers of the page wait while it is built without the latch
+  SharedFrameDesc& desc = descs[frameNo];
+  desc.dirty = 0;
+  desc.refbit = 1;
+  desc.ioState = IO_READ;
+  lock.unlock();
+
+  try
+  {
+    std::lock_guard<std::mutex> ioLock(file->streamLatch());
+    file->allocatePage(pageNo, pages[frameNo]);
+  }
+  catch(...)
+  {
+    lock.lock();
+    desc.ioState = IO_NONE;
+    desc.pinCnt--;
+    if (desc.pinCnt == 0)
+      freeFrame(frameNo);
+    pthread_cond_broadcast(&header->ioDone);
+    throw;
+  }
+
+  lock.lock();
+  desc.ioState = IO_NONE;
+  pthread_cond_broadcast(&header->ioDone);
+  page = &pages[frameNo];
+}
+
+void SharedBufPool::dropPin(const std::uint32_t frameNo, const bool dirty)
+{
+  SharedFrameDesc& desc = descs[frameNo];
+  if (desc.pinCnt <= 0)
+  {
+    File* file = openFile(desc.fileId);
+    throw PageNotPinnedException(file != NULL ? file->filename() : std::string(), desc.pageNo, frameNo);
+  }
+  if (dirty)
+    desc.dirty = 1;
+  desc.pinCnt--;
+}
+
+void SharedBufPool::unPinPage(File* file, const PageId pageNo, const bool dirty)
+{
+  std::lock_guard<ProcessLatch> lock(latch);
+  std::uint32_t fileId = findFile(file);
+  std::uint32_t frameNo = fileId != NO_FILE ? lookup(fileId, pageNo) : NO_FRAME;
+  if (frameNo == NO_FRAME)
+    throw HashNotFoundException(file->filename(), pageNo);
+  dropPin(frameNo, dirty);
+}
+
+void SharedBufPool::unPinFrame(const std::uint32_t frameNo, const bool dirty)
+{
+  std::lock_guard<ProcessLatch> lock(latch);
+  dropPin(frameNo, dirty);
+}
+
+bool SharedBufPool::contains(File* file, const PageId pageNo)
+{
+  std::lock_guard<ProcessLatch> lock(latch);
+  std::uint32_t fileId = findFile(file);
+  return fileId != NO_FILE && lookup(fileId, pageNo) != NO_FRAME;
+}
+
+void SharedBufPool::disposePage(File* file, const PageId pageNo)
+{
+  {
+    std::unique_lock<ProcessLatch> lock(latch);
+    std::uint32_t fileId = findFile(file);
+    std::uint32_t frameNo;
+    while (fileId != NO_FILE && (frameNo = lookup(fileId, pageNo)) != NO_FRAME)
+    {
+      if (descs[frameNo].ioState != IO_NONE)
+      {
+        latch.wait(&header->ioDone);
+        continue;
+      }
+      freeFrame(frameNo);
+      break;
+    }
+  }
+
+  std::lock_guard<ProcessLatch> fileLock(fileLatch);
+  std::lock_guard<std::mutex> ioLock(file->streamLatch());
+  file->deletePage(pageNo);
+}
+
+void SharedBufPool::flushFile(const File* file)
+{
+  std::unique_lock<ProcessLatch> lock(latch);
+  std::uint32_t fileId = findFile(file);
+  File* writable = fileId != NO_FILE ? openFile(fileId) : NULL;
+  for (std::uint32_t frameNo = 0; writable != NULL && frameNo < header->numFrames; frameNo++)
+  {
+    SharedFrameDesc& desc = descs[frameNo];
+    while (desc.valid && desc.fileId == fileId && desc.ioState != IO_NONE)
+      latch.wait(&header->ioDone);
+    if (!desc.valid || desc.fileId != fileId || !desc.dirty || desc.pinCnt > 0)
+      continue;
+
+    desc.ioState = IO_WRITE;
+    lock.unlock();
+    try
+    {
+      std::lock_guard<std::mutex> ioLock(writable->streamLatch());
+      writable->writePage(desc.pageNo, pages[frameNo]);
+    }
+    catch(...)
+    {
+      lock.lock();
+      desc.ioState = IO_NONE;
+      pthread_cond_broadcast(&header->ioDone);
+      throw;
+    }
+    lock.lock();
+    bufStats.diskwrites++;
+    desc.dirty = 0;
+    desc.ioState = IO_NONE;
+    pthread_cond_broadcast(&header->ioDone);
+  }
+  forgetFile(file);
+}
+
+void SharedBufPool::discardFile(const File* file)
+{
+  std::unique_lock<ProcessLatch> lock(latch);
+  std::uint32_t fileId = findFile(file);
+
+  // wait out I/O on the file's frames first, starting over after every wait as the latch is dropped meanwhile
+  std::uint32_t frameNo = 0;
+  while (fileId != NO_FILE && frameNo < header->numFrames)
+  {
+    if (descs[frameNo].valid && descs[frameNo].fileId == fileId && descs[frameNo].ioState != IO_NONE)
+    {
+      latch.wait(&header->ioDone);
+      fileId = findFile(file);
+      frameNo = 0;
+      continue;
+    }
+    frameNo++;
+  }
+
+  // the latch is held from here on, so nothing can be pinned between the check and the freeing
+  for (frameNo = 0; fileId != NO_FILE && frameNo < header->numFrames; frameNo++)
+  {
+    SharedFrameDesc& desc = descs[frameNo];
+    if (desc.valid && desc.fileId == fileId && desc.pinCnt > 0)
+      throw PagePinnedException(file->filename(), desc.pageNo, frameNo);
+  }
+  for (frameNo = 0; fileId != NO_FILE && frameNo < header->numFrames; frameNo++)
+  {
+    if (descs[frameNo].valid && descs[frameNo].fileId == fileId)
+      freeFrame(frameNo);
+  }
+  forgetFile(file);
+}
+
+}
@@ -0,0 +1,271 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+#include <pthread.h>
+#include "file.h"
+#include "page.h"
+
+namespace badgerdb {
+
+struct BufStats;
+struct SharedHeader;
+struct SharedFileEntry;
+struct SharedFrameDesc;
+
+/**
+* @brief A process-shared mutex in a shared memory segment, usable with std::unique_lock. If a process dies holding
+* it, the next process to lock it takes it over.
+*/
+class ProcessLatch
+{
+ public:
+	ProcessLatch() : mutex(NULL) {}
+
+	explicit ProcessLatch(pthread_mutex_t* mutex) : mutex(mutex) {}
+
+	void lock();
+
+	void unlock();
+
+	/**
+	 * Wait on a process-shared condition variable, the latch held
+	 */
+	void wait(pthread_cond_t* cond);
+
+ private:
+	pthread_mutex_t* mutex;
+};
+
+/**
+* @brief A buffer pool in a POSIX shared memory segment, so that every process on the host attaching the same name
+* shares one copy of each page, and updates made through one process are seen by the others.
+*
+* The segment holds a header, the frame descriptors, the page table and the frames. Nothing in it is a pointer:
+* files are known by device, inode number and the generation in their header through a table in the segment, and
+* descriptors and hash chains refer to each other by index. One latch, a robust process-shared mutex, guards everything in the segment, and a
+* process-shared condition variable is signalled whenever I/O on a frame finishes. As in BufMgr, disk reads and
+* writes run without the latch, the frame marked in its descriptor meanwhile.
+*
+* A dirty page can only be written back by a process that has its file open, so eviction passes over dirty pages of
+* files the calling process has not used. A process that dies with pages pinned, or with I/O on a frame in progress,
+* leaves those frames unusable until the segment is removed.
+*/
+class SharedBufPool
+{
+ public:
+	/**
+	 * Attach to the pool of the given name, creating it if no process has yet.
+	 *
+	 * @param name		Name of the shared memory segment, starting with '/'
+	 * @param bufs		Number of frames, if the pool is created here. A pool that exists keeps its own size.
+	 * @param stats		Counters to count this process's accesses, reads and writes in
+	 * @throws std::system_error If the segment cannot be created or mapped
+	 */
+	SharedBufPool(const std::string& name, const std::uint32_t bufs, BufStats& stats);
+
+	/**
+	 * Detach from the pool. The segment and the pages in it stay for the other processes; dirty pages of files only
+	 * this process had open should be flushed first.
+	 */
+	~SharedBufPool();
+
+	/**
+	 * Remove the segment of the given name. Processes still attached keep their mapping.
+	 *
+	 * @return			False if there was no such segment
+	 */
+	static bool remove(const std::string& name);
+
+	/**
+	 * Returns the frames, frame f at frames()[f]
+	 */
+	Page* frames() const
+	{
+		return pages;
+	}
+
+	/**
+	 * Returns the number of frames in the pool
+	 */
+	std::uint32_t getNumBufs() const;
+
+	/**
+	 * As in BufMgr. Pages are pinned for every process together.
+	 */
+	void readPage(File* file, const PageId pageNo, Page*& page);
+	void allocPage(File* file, PageId& pageNo, Page*& page);
+	void unPinPage(File* file, const PageId pageNo, const bool dirty);
+	void disposePage(File* file, const PageId pageNo);
+
+	/**
+	 * Returns true if a page is in the pool
+	 */
+	bool contains(File* file, const PageId pageNo);
+
+	/**
+	 * Drop one pin of the page in a frame
+	 *
+	 * @throws  PageNotPinnedException If the page is not pinned
+	 */
+	void unPinFrame(const std::uint32_t frameNo, const bool dirty);
+
+	/**
+	 * Write back the file's dirty pages and forget the File in this process. Unlike BufMgr::flushFile(), pages pinned
+	 * by any process are left in the pool, dirty, for the process holding them to unpin, and the other pages stay in
+	 * the pool for the other processes.
+	 */
+	void flushFile(const File* file);
+
+	/**
+	 * Drop the file's pages from the pool without writing them, for every process.
+	 *
+	 * @throws  PagePinnedException If any process has a page of the file pinned
+	 */
+	void discardFile(const File* file);
+
+	/**
+	 * Forget a File that is being closed, so that a File made later at the same address is not taken for it. Its
+	 * pages stay in the pool, dirty ones for a process that has the file open to write back.
+	 */
+	void fileClosed(const File* file);
+
+ private:
+	/**
+	 * Forbid copying, the mapping belongs to one object
+	 */
+	SharedBufPool(const SharedBufPool&);
+	SharedBufPool& operator=(const SharedBufPool&);
+
+	/**
+	 * Map the segment, creating and initializing it if it does not exist yet
+	 */
+	void attach(const std::uint32_t bufs);
+
+	/**
+	 * Returns the number of the file in the segment's file table, entering it if it is not there. Remembers the File
+	 * so that this process can write its pages back. Called with the latch held.
+	 */
+	std::uint32_t fileIdOf(File* file);
+
+	/**
+	 * Returns the number of the file, or NO_FILE if it is not in the file table. Called with the latch held.
+	 */
+	std::uint32_t findFile(const File* file) const;
+
+	/**
+	 * Returns the frame holding a page, or NO_FRAME. Called with the latch held.
+	 */
+	std::uint32_t lookup(const std::uint32_t fileId, const PageId pageNo) const;
+
+	/**
+	 * Add a frame to, or take it off, the hash chain of its page. Called with the latch held.
+	 */
+	void insert(const std::uint32_t frameNo);
+	void unlink(const std::uint32_t frameNo);
+
+	/**
+	 * Drop one pin of the page in a frame. Called with the latch held.
+	 */
+	void dropPin(const std::uint32_t frameNo, const bool dirty);
+
+	/**
+	 * Forget a File in this process. Called with the latch held.
+	 */
+	void forgetFile(const File* file);
+
+	/**
+	 * Take a frame off the page table and mark it empty. Called with the latch held.
+	 */
+	void freeFrame(const std::uint32_t frameNo);
+
+	/**
+	 * Find an empty frame, or evict a page with the clock algorithm, writing it back first if it is dirty. The latch
+	 * is dropped for the write, so the caller must look its page up again afterwards.
+	 *
+	 * @param lock		Lock holding the latch
+	 * @return			The frame, empty
+	 * @throws BufferExceededException If every frame is pinned, busy or dirty with a file this process cannot write
+	 */
+	std::uint32_t allocFrame(std::unique_lock<ProcessLatch>& lock);
+
+	/**
+	 * allocFrame() for a page of the given file, keeping the file's entry in the file table from being given to
+	 * another file while the latch is dropped. The caller must have the frame in the page table, or look its page up
+	 * again, before dropping the latch itself.
+	 */
+	std::uint32_t allocFrameFor(const std::uint32_t fileId, std::unique_lock<ProcessLatch>& lock);
+
+	/**
+	 * Returns this process's File for a file number, or NULL if it has not used the file
+	 */
+	File* openFile(const std::uint32_t fileId) const;
+
+	/**
+	 * Name of the segment
+	 */
+	std::string name;
+
+	/**
+	 * The mapping and its parts
+	 */
+	void* base;
+	std::size_t bytes;
+	SharedHeader* header;
+	SharedFileEntry* fileTable;
+	SharedFrameDesc* descs;
+	std::uint32_t* buckets;
+	Page* pages;
+
+	/**
+	 * Latch of the segment, and the latch serializing page allocation and deletion in files across processes
+	 */
+	ProcessLatch latch;
+	ProcessLatch fileLatch;
+
+	/**
+	 * Counters of this process
+	 */
+	BufStats& bufStats;
+
+	/**
+	 * A file this process has used, its number in the file table and the identity it had there
+	 */
+	struct FileRef
+	{
+		std::uint32_t id;
+		std::uint64_t device;
+		std::uint64_t inode;
+		std::uint64_t generation;
+	};
+
+	/**
+	 * Fill in the identity of a file, leaving its number alone
+	 *
+	 * @return			False if the file cannot be looked at, errno says why
+	 */
+	bool identify(const File* file, FileRef& ref) const;
+
+	/**
+	 * Returns true if the file table entry of a file's number still holds that file. Called with the latch held.
+	 */
+	bool isEntry(const FileRef& ref) const;
+
+	/**
+	 * Files this process has used, by File and by number in the file table, guarded by the segment latch
+	 */
+	std::unordered_map<const File*, FileRef> fileRefs;
+	std::unordered_map<std::uint32_t, File*> files;
+};
+
+}